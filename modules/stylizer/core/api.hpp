@@ -7,10 +7,18 @@
 
 #include "util/maybe_owned.hpp"
 #include "util/reactive.hpp"
+#include "util/thread_pool.hpp"
 
 #include <chrono>
+#include <condition_variable>
+#include <coroutine>
 #include <cstddef>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <ratio>
+#include <thread>
 
 namespace stylizer {
 	using namespace api::operators;
@@ -34,7 +42,7 @@ namespace stylizer {
 	struct context : public api::current_backend::device {
 		using super = api::current_backend::device;
 
-		context() {}
+		context() { install_wait_hook(); }
 		context(const context&) = delete; // Contexts can't be copied!
 		context(context&&) = default; // Contexts shouldn't be moved after reactive objects are created from them...
 		context& operator=(const context&) = delete;
@@ -71,10 +79,83 @@ namespace stylizer {
 		}
 
 		context& update() {
+			process_owner_tasks();
 			process_events(*this);
 			return *this;
 		}
 
+		// GPU objects are only created by the thread which owns the context (the one which created it, unless ownership is claimed)
+		// Other threads (eg loaders running on the thread pool) hand their GPU work over with run_on_owner, it runs during the owner's next update
+		bool is_owner_thread() const { return owner->thread == std::this_thread::get_id(); }
+		context& claim_ownership() {
+			owner->thread = std::this_thread::get_id();
+			install_wait_hook();
+			return *this;
+		}
+
+		// NOTE: Runs func immediately when called from the owner thread
+		template<typename Tfunc>
+		std::future<std::invoke_result_t<Tfunc>> run_on_owner(Tfunc&& func) {
+			auto task = std::make_shared<std::packaged_task<std::invoke_result_t<Tfunc>()>>(std::forward<Tfunc>(func));
+			auto out = task->get_future();
+			if(is_owner_thread()) (*task)();
+			else queue_on_owner([task] { (*task)(); });
+			return out;
+		}
+
+		// Runs func during the owner's next update (even when called from the owner thread)
+		void queue_on_owner(std::function<void()> func) {
+			std::scoped_lock lock(owner->mutex);
+			owner->tasks.emplace_back(std::move(func));
+			owner->queued.notify_all();
+		}
+
+		// Awaitable which resumes the awaiting coroutine during the owner's next update
+		auto next_frame() {
+			struct awaiter {
+				context& ctx;
+				bool await_ready() { return false; }
+				void await_suspend(std::coroutine_handle<> handle) { ctx.queue_on_owner([handle] { handle.resume(); }); }
+				void await_resume() {}
+			};
+			return awaiter{*this};
+		}
+		// Awaitable which continues the awaiting coroutine on the owner thread (without waiting if it is already there)
+		auto resume_on_owner() {
+			struct awaiter {
+				context& ctx;
+				bool await_ready() { return ctx.is_owner_thread(); }
+				void await_suspend(std::coroutine_handle<> handle) { ctx.queue_on_owner([handle] { handle.resume(); }); }
+				void await_resume() {}
+			};
+			return awaiter{*this};
+		}
+
+		// Returns how many queued tasks were run (none unless called from the owner thread)
+		size_t process_owner_tasks() { return process_owner_tasks(*owner); }
+
+		// Waits for future, the owner thread keeps running queued tasks meanwhile so that loaders waiting on it can't deadlock
+		template<typename T>
+		T wait(std::future<T>& future) {
+			while(is_owner_thread() && future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+				if(!process_owner_tasks()) {
+					std::unique_lock lock(owner->mutex);
+					owner->queued.wait_for(lock, std::chrono::milliseconds(1), [this] { return !owner->tasks.empty(); });
+				}
+			return future.get();
+		}
+
+		// Expires once the context (or whichever context it was moved into) is destroyed
+		std::weak_ptr<const void> lifetime() const { return owner; }
+
+		// The pool CPU work belonging to this context (loading, mesh processing, instance building, etc) is spread across
+		// NOTE: Defaults to the shared pool, which has no threads in single threaded builds
+		thread_pool& jobs() { return *job_pool; }
+		context& set_jobs(thread_pool& pool) {
+			job_pool = &pool;
+			return *this;
+		}
+
 		// TODO: Is there a better name than send?
 		void send(error_severity severity, std::string_view message, size_t error_tag = 0) {
 			get_error_handler()(severity, message, error_tag);
@@ -95,6 +176,35 @@ namespace stylizer {
 	protected:
 		// Hide some of super's methods
 		using super::tick;
+
+		struct owner_state {
+			std::thread::id thread = std::this_thread::get_id();
+			std::mutex mutex;
+			std::condition_variable queued;
+			std::deque<std::function<void()>> tasks;
+		};
+		std::shared_ptr<owner_state> owner = std::make_shared<owner_state>(); // Shared so that contexts stay movable
+		thread_pool* job_pool = &thread_pool::get_default();
+
+		static size_t process_owner_tasks(owner_state& owner) {
+			if(owner.thread != std::this_thread::get_id()) return 0;
+			std::deque<std::function<void()>> tasks;
+			{
+				std::scoped_lock lock(owner.mutex);
+				std::swap(tasks, owner.tasks);
+			}
+			for(auto& task: tasks) task();
+			return tasks.size();
+		}
+
+		// Keeps owner tasks running while the owner thread is blocked in the pool (eg in ctx.jobs().parallel_for over loads which upload)
+		// NOTE: The most recently created (or claimed) context on a thread wins
+		void install_wait_hook() {
+			thread_pool::wait_hook() = [owner = std::weak_ptr<owner_state>(owner)] {
+				auto state = owner.lock();
+				return state && process_owner_tasks(*state) > 0;
+			};
+		}
 	};
 
 
@@ -115,6 +225,8 @@ namespace stylizer {
 
 		static texture& get_default_texture(context& ctx);
 
+		uint32_t mip_level_count() const { return config.mip_level_count; }
+
 		texture& configure_sampler(context& ctx, const sampler_config& config = {}) {
 			sample_config = config;
 			api::current_backend::texture::configure_sampler(ctx, config);
@@ -284,6 +396,9 @@ namespace stylizer {
 		material& operator=(material&) = default;
 
 
+		// Also frees the GPU objects the material created for itself (called by maybe_owned::release before an owned material is deleted)
+		virtual void release() { api::current_backend::render::pipeline::release(); }
+
 		virtual std::span<maybe_owned<api::current_backend::texture>> textures(context& ctx) = 0;
 		virtual std::span<maybe_owned<api::current_backend::buffer>> buffers(context& ctx) = 0;
 		virtual std::span<std::string_view> requested_mesh_attributes() = 0;
@@ -440,6 +555,19 @@ namespace stylizer {
 		std::span<const std::byte> to_bytes() override {
 			return byte_span<instance_data>(static_cast<std::vector<instance_data>&>(*this));
 		}
+
+		// Fills the buffer with func(i) for every i in [0, count), spread across the context's jobs
+		// NOTE: Doesn't upload, call upload afterwards
+		template<typename Tfunc>
+		buffer& build(context& ctx, size_t count, const Tfunc& func) {
+			constexpr size_t chunk_size = 1024;
+			std::vector<instance_data>::resize(count);
+			ctx.jobs().parallel_for((count + chunk_size - 1) / chunk_size, [&](size_t chunk) {
+				for(size_t i = chunk * chunk_size, end = std::min(i + chunk_size, count); i < end; ++i)
+					(*this)[i] = func(i);
+			});
+			return *this;
+		}
 	};
 
 }
\ No newline at end of file
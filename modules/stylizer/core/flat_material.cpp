@@ -173,4 +173,12 @@ float4 fragment(varryings vert) : SV_Target {
 		return *this;
 	}
 
+	void flat_material::release() {
+		if(auto texture = std::get_if<maybe_owned<stylizer::texture>>(&color))
+			texture->release(); // Only frees the texture if the material owns it
+		config_buffer.release();
+		group.release();
+		material::release();
+	}
+
 }
\ No newline at end of file
@@ -34,5 +34,6 @@ namespace stylizer {
 		std::span<api::current_backend::bind_group> bind_groups(context& ctx) override;
 
 		flat_material& upload(context& ctx);
+		void release() override;
 	};
 }
\ No newline at end of file
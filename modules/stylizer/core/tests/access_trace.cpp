@@ -0,0 +1,78 @@
+#include "check.hpp"
+
+#include <stylizer/core/api.hpp>
+#include <stylizer/core/util/access_trace.hpp>
+
+#include <fstream>
+
+using namespace stylizer;
+
+int main() {
+	int errors = 0;
+	auto connection = get_error_handler().connect([&](auto, auto, auto) { ++errors; });
+
+	auto directory = std::filesystem::temp_directory_path() / "stylizer_test_access_trace";
+	std::filesystem::remove_all(directory);
+	std::filesystem::create_directories(directory);
+
+	access_trace trace;
+	{ // Only the first request for each file is recorded, and only while recording
+		trace.record("ignored.png", 1);
+		trace.start();
+		trace.record("first.png", 10);
+		trace.record("second.obj", 20);
+		trace.record("first.png", 10);
+		trace.stop();
+		trace.record("late.png", 30);
+
+		auto entries = trace.entries();
+		STYLIZER_CHECK(entries.size() == 2 && !trace.recording());
+		if(entries.size() == 2) {
+			STYLIZER_CHECK(entries[0].path == "first.png" && entries[0].bytes == 10);
+			STYLIZER_CHECK(entries[1].path == "second.obj" && entries[1].bytes == 20 && entries[1].at >= entries[0].at);
+		}
+	}
+
+	{ // Manifests round trip (paths with spaces included), malformed lines are skipped
+		trace.start();
+		trace.record("models/a model.obj", 123);
+		trace.record("textures/b.png", 456);
+		trace.stop();
+		auto manifest = directory / "startup.trace";
+		STYLIZER_CHECK(trace.save(manifest));
+		{
+			std::ofstream out(manifest, std::ios::app);
+			out << "not a line\n" << "12 many textures/c.png\n";
+		}
+
+		auto loaded = access_trace::load(manifest);
+		STYLIZER_CHECK(loaded.size() == 2);
+		if(loaded.size() == 2) {
+			STYLIZER_CHECK(loaded[0].path == "models/a model.obj" && loaded[0].bytes == 123);
+			STYLIZER_CHECK(loaded[1].path == "textures/b.png" && loaded[1].bytes == 456);
+		}
+		STYLIZER_CHECK(access_trace::load(directory / "missing.trace").empty());
+	}
+
+	{ // Prefetching maps the files which still exist into the file cache, and skips the rest
+		auto file = directory / "prefetched.bin";
+		{
+			std::ofstream out(file, std::ios::binary);
+			out << "some bytes to read ahead";
+		}
+		std::vector<access_trace::entry> files = {{file}, {directory / "gone.bin"}};
+		{
+			thread_pool pool(2);
+			STYLIZER_CHECK(prefetch_files(files, pool) == 2);
+		} // Joining the pool waits for the prefetches
+
+		auto before = get_file_cache().get_statistics();
+		auto handle = get_file_cache().acquire(std::filesystem::canonical(file));
+		STYLIZER_CHECK(handle && get_file_cache().get_statistics().hits == before.hits + 1);
+	}
+
+	STYLIZER_CHECK(errors == 0);
+	get_file_cache().clear();
+	std::filesystem::remove_all(directory);
+	return tests::result();
+}
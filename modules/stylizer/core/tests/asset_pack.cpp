@@ -0,0 +1,109 @@
+#include "check.hpp"
+
+#include <stylizer/core/api.hpp>
+#include <stylizer/core/util/asset_pack.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace stylizer;
+
+static void write_file(const std::filesystem::path& path, std::span<const std::byte> bytes) {
+	std::filesystem::create_directories(path.parent_path());
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	out.write((const char*)bytes.data(), bytes.size());
+}
+
+static std::vector<std::byte> read_file(const std::filesystem::path& path) {
+	std::ifstream in(path, std::ios::binary);
+	std::vector<std::byte> out(std::filesystem::file_size(path));
+	in.read((char*)out.data(), out.size());
+	return out;
+}
+
+static bool same_bytes(std::span<const std::byte> a, std::span<const std::byte> b) {
+	return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+}
+
+int main() {
+	int errors = 0;
+	auto connection = get_error_handler().connect([&](auto, auto, auto) { ++errors; });
+
+	// A tiny file and a large (compressible) one in a subdirectory
+	auto root = std::filesystem::temp_directory_path() / "stylizer_test_asset_pack";
+	std::filesystem::remove_all(root);
+	std::string small_text = "Hello asset pack";
+	std::vector<std::byte> small(std::as_bytes(std::span(small_text)).begin(), std::as_bytes(std::span(small_text)).end());
+	std::vector<std::byte> large(300 * 1024);
+	for(size_t i = 0; i < large.size(); ++i)
+		large[i] = std::byte((i / 7) % 13);
+	write_file(root / "assets/small.txt", small);
+	write_file(root / "assets/nested/large.bin", large);
+
+	{ // Packed files read back as they were, found by their path relative to the mount point
+		STYLIZER_CHECK(asset_pack::write(root / "plain.spak", root / "assets"));
+		auto pack = asset_pack::open(root / "plain.spak", "/mounted");
+		STYLIZER_CHECK(pack && pack->entries().size() == 2 && errors == 0);
+		if(pack) {
+			auto found_small = pack->find(std::string_view{"small.txt"});
+			auto found_large = pack->find(std::filesystem::path("/mounted/nested/large.bin"));
+			STYLIZER_CHECK(found_small && found_large && !pack->find(std::string_view{"missing.txt"}));
+			if(found_small && found_large) {
+				STYLIZER_CHECK(same_bytes(pack->load(*found_small).span(), small));
+				STYLIZER_CHECK(same_bytes(pack->load(*found_large).span(), large));
+				STYLIZER_CHECK(found_large->offset % pack->header().alignment == 0);
+			}
+		}
+	}
+
+	{ // A pack whose index runs past the end of the file is rejected
+		auto bytes = read_file(root / "plain.spak");
+		write_file(root / "truncated_index.spak", std::span(bytes).first(sizeof(asset_pack::header) + sizeof(asset_pack::entry) + 4));
+		errors = 0;
+		STYLIZER_CHECK(!asset_pack::open(root / "truncated_index.spak", "/mounted") && errors == 1);
+	}
+
+	for(auto method: {compression::LZ4, compression::Zstd}) {
+		if(!compression_available(method)) continue;
+		auto name = method == compression::LZ4 ? std::string("lz4") : std::string("zstd");
+
+		{ // Compressed entries are split into blocks and decompress back to the original bytes
+			errors = 0;
+			STYLIZER_CHECK(asset_pack::write(root / (name + ".spak"), root / "assets", {.compression = method, .block_size = 16 * 1024}));
+			auto pack = asset_pack::open(root / (name + ".spak"), "/mounted");
+			STYLIZER_CHECK(pack && errors == 0);
+			if(!pack) continue;
+			auto found_small = pack->find(std::string_view{"small.txt"});
+			auto found_large = pack->find(std::string_view{"nested/large.bin"});
+			STYLIZER_CHECK(found_small && found_large);
+			if(!found_small || !found_large) continue;
+			STYLIZER_CHECK(found_small->compression() == compression::None); // Doesn't get smaller
+			STYLIZER_CHECK(found_large->compression() == method && found_large->size < large.size());
+			STYLIZER_CHECK(same_bytes(pack->load(*found_large).span(), large) && same_bytes(pack->load(*found_small).span(), small));
+		}
+
+		{ // As is a compressed entry whose block table no longer fits in its blob
+			auto bytes = read_file(root / (name + ".spak"));
+			asset_pack::header header;
+			std::memcpy(&header, bytes.data(), sizeof(header));
+			for(size_t i = 0; i < header.entry_count; ++i) {
+				auto at = header.index_offset + i * sizeof(asset_pack::entry);
+				asset_pack::entry entry;
+				std::memcpy(&entry, bytes.data() + at, sizeof(entry));
+				if(entry.compression() == compression::None) continue;
+				entry.size = sizeof(asset_pack::block_table) + sizeof(asset_pack::block);
+				std::memcpy(bytes.data() + at, &entry, sizeof(entry));
+			}
+			write_file(root / (name + "_truncated_table.spak"), bytes);
+			errors = 0;
+			STYLIZER_CHECK(!asset_pack::open(root / (name + "_truncated_table.spak"), "/mounted") && errors == 1);
+		}
+	}
+
+	get_file_cache().clear();
+	std::filesystem::remove_all(root);
+	return tests::result();
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdio>
+
+namespace stylizer::tests {
+	// Failed checks are counted (rather than aborting) so that every check in a test runs
+	inline int& failures() {
+		static int count = 0;
+		return count;
+	}
+
+	// What main returns
+	inline int result() {
+		if(failures()) std::fprintf(stderr, "%d check(s) failed\n", failures());
+		return failures() == 0 ? 0 : 1;
+	}
+}
+
+#define STYLIZER_CHECK(condition) do { \
+	if(!(condition)) { \
+		std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+		++stylizer::tests::failures(); \
+	} \
+} while(false)
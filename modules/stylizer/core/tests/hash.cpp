@@ -0,0 +1,33 @@
+#include "check.hpp"
+
+#include <stylizer/core/util/hash.hpp>
+
+#include <string_view>
+#include <vector>
+
+using namespace stylizer;
+
+static uint64_t hash(std::string_view text, uint64_t seed = 0) {
+	return content_hash(std::as_bytes(std::span(text)), seed);
+}
+
+int main() {
+	// Reference XXH64 values, covering the short (< 32 bytes) and striped paths
+	STYLIZER_CHECK(hash("") == 0xef46db3751d8e999ull);
+	STYLIZER_CHECK(hash("abc") == 0x44bc2cf5ad770999ull);
+	STYLIZER_CHECK(hash("abc", 1) == 0xbea9ca8199328908ull);
+	STYLIZER_CHECK(hash("Nobody inspects the spammish repetition") == 0xfbcea83c8a378bf1ull);
+
+	std::vector<std::byte> bytes(1024);
+	for(size_t i = 0; i < bytes.size(); ++i)
+		bytes[i] = std::byte(i % 256);
+	STYLIZER_CHECK(content_hash(bytes) == 0x6f3914f18fe4df57ull);
+
+	// Only the content matters, not where it lives
+	auto copy = bytes;
+	STYLIZER_CHECK(content_hash(copy) == content_hash(bytes));
+	copy[512] ^= std::byte{1};
+	STYLIZER_CHECK(content_hash(copy) != content_hash(bytes));
+
+	return tests::result();
+}
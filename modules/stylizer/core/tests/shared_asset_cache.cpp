@@ -0,0 +1,71 @@
+#include "check.hpp"
+
+#include <stylizer/core/api.hpp>
+#include <stylizer/core/util/shared_asset_cache.hpp>
+
+#include <algorithm>
+#include <string_view>
+
+using namespace stylizer;
+
+static std::span<const std::byte> bytes_of(std::string_view text) { return std::as_bytes(std::span(text)); }
+
+static bool same_bytes(std::span<const std::byte> a, std::span<const std::byte> b) {
+	return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+}
+
+int main() {
+	int errors = 0;
+	auto connection = get_error_handler().connect([&](auto, auto, auto) { ++errors; });
+
+	auto directory = std::filesystem::temp_directory_path() / "stylizer_test_shared_asset_cache";
+	std::filesystem::remove_all(directory);
+	shared_asset_cache cache(directory);
+	auto source = bytes_of("source file"), decoded = bytes_of("decoded pixels");
+
+	{ // Keys depend on the source's bytes, what it was decoded into, and that format's version
+		auto key = shared_asset_cache::make_key(source, "image", 1);
+		STYLIZER_CHECK(key == shared_asset_cache::make_key(bytes_of("source file"), "image", 1));
+		STYLIZER_CHECK(key != shared_asset_cache::make_key(bytes_of("other file"), "image", 1));
+		STYLIZER_CHECK(key != shared_asset_cache::make_key(source, "model", 1));
+		STYLIZER_CHECK(key != shared_asset_cache::make_key(source, "image", 2));
+	}
+
+	auto key = shared_asset_cache::make_key(source, "image", 1);
+	{ // Published entries are mapped back, by this cache and any other opened on the same directory (eg in another process)
+		STYLIZER_CHECK(!cache.find(key));
+		auto published = cache.publish(key, decoded);
+		STYLIZER_CHECK(published && same_bytes(published.span(), decoded));
+
+		shared_asset_cache other(directory);
+		auto found = other.find(key);
+		STYLIZER_CHECK(found && same_bytes(found.span(), decoded));
+		STYLIZER_CHECK(same_bytes(other.publish(key, bytes_of("ignored")).span(), decoded)); // The first publish wins
+	}
+
+	{ // Empty blobs can't be mapped, so they aren't published
+		STYLIZER_CHECK(!cache.publish(key + 1, {}) && !cache.find(key + 1));
+	}
+
+	{ // Removed and cleared entries are gone, while handles to them keep their contents alive
+		auto held = cache.find(key);
+		STYLIZER_CHECK(cache.remove(key) && !cache.find(key) && !cache.remove(key));
+		STYLIZER_CHECK(held && same_bytes(held.span(), decoded));
+
+		cache.publish(key, decoded);
+		cache.publish(key + 2, bytes_of("another entry"));
+		STYLIZER_CHECK(cache.clear() == 2 && !cache.find(key) && !cache.find(key + 2));
+	}
+
+	{ // Only the enabled cache is handed to the decoders
+		STYLIZER_CHECK(!get_shared_asset_cache());
+		auto& enabled = enable_shared_asset_cache(directory);
+		STYLIZER_CHECK(get_shared_asset_cache().get() == &enabled && enabled.get_directory() == directory);
+		disable_shared_asset_cache();
+		STYLIZER_CHECK(!get_shared_asset_cache());
+	}
+
+	STYLIZER_CHECK(errors == 0);
+	std::filesystem::remove_all(directory);
+	return tests::result();
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "api.hpp"
+
+namespace stylizer::texture_capabilities {
+	// The optional texture features of the graphics API, declared here (and only here) rather than probed for by name
+	// NOTE: Entries name the API's formats directly, so a renamed or removed format fails to compile instead of silently falling back
+
+	// Block compressed formats
+	constexpr texture::format BC1 = texture::format::BC1, BC1srgb = texture::format::BC1srgb;
+	constexpr texture::format BC2 = texture::format::BC2, BC2srgb = texture::format::BC2srgb;
+	constexpr texture::format BC3 = texture::format::BC3, BC3srgb = texture::format::BC3srgb;
+	constexpr texture::format BC4 = texture::format::BC4, BC4signed = texture::format::BC4signed;
+	constexpr texture::format BC5 = texture::format::BC5, BC5signed = texture::format::BC5signed;
+	constexpr texture::format BC6H = texture::format::BC6H, BC6Hsigned = texture::format::BC6Hsigned;
+	constexpr texture::format BC7 = texture::format::BC7, BC7srgb = texture::format::BC7srgb;
+
+	// ASTC in any of its block sizes (4x4 up to 12x12), Undefined for sizes ASTC doesn't have
+	constexpr texture::format astc(uint8_t block_width, uint8_t block_height, bool srgb) {
+		switch((block_width << 8) | block_height) {
+			case (4 << 8) | 4: return srgb ? texture::format::ASTC4x4srgb : texture::format::ASTC4x4;
+			case (5 << 8) | 4: return srgb ? texture::format::ASTC5x4srgb : texture::format::ASTC5x4;
+			case (5 << 8) | 5: return srgb ? texture::format::ASTC5x5srgb : texture::format::ASTC5x5;
+			case (6 << 8) | 5: return srgb ? texture::format::ASTC6x5srgb : texture::format::ASTC6x5;
+			case (6 << 8) | 6: return srgb ? texture::format::ASTC6x6srgb : texture::format::ASTC6x6;
+			case (8 << 8) | 5: return srgb ? texture::format::ASTC8x5srgb : texture::format::ASTC8x5;
+			case (8 << 8) | 6: return srgb ? texture::format::ASTC8x6srgb : texture::format::ASTC8x6;
+			case (8 << 8) | 8: return srgb ? texture::format::ASTC8x8srgb : texture::format::ASTC8x8;
+			case (10 << 8) | 5: return srgb ? texture::format::ASTC10x5srgb : texture::format::ASTC10x5;
+			case (10 << 8) | 6: return srgb ? texture::format::ASTC10x6srgb : texture::format::ASTC10x6;
+			case (10 << 8) | 8: return srgb ? texture::format::ASTC10x8srgb : texture::format::ASTC10x8;
+			case (10 << 8) | 10: return srgb ? texture::format::ASTC10x10srgb : texture::format::ASTC10x10;
+			case (12 << 8) | 10: return srgb ? texture::format::ASTC12x10srgb : texture::format::ASTC12x10;
+			case (12 << 8) | 12: return srgb ? texture::format::ASTC12x12srgb : texture::format::ASTC12x12;
+			default: return texture::format::Undefined;
+		}
+	}
+}
@@ -0,0 +1,48 @@
+#include <stylizer/core/api.hpp>
+#include <stylizer/core/util/asset_pack.hpp>
+
+#include <charconv>
+#include <iostream>
+
+int main(int argc, char** argv) {
+	auto usage = [&] {
+		std::cerr << "Usage: " << argv[0] << " <output pack> <asset directory> [--alignment N] [--compression none|lz4|zstd] [--block-size N] [--level N]" << std::endl;
+		return 1;
+	};
+	if(argc < 3) return usage();
+
+	stylizer::asset_pack::write_config config;
+	for(int i = 3; i < argc; i += 2) {
+		if(i + 1 >= argc) return usage();
+		std::string_view flag = argv[i], value = argv[i + 1];
+		auto parse = [&](auto& out) {
+			return std::from_chars(value.data(), value.data() + value.size(), out).ec == std::errc{};
+		};
+
+		bool valid = true;
+		if(flag == "--alignment") valid = parse(config.alignment);
+		else if(flag == "--block-size") valid = parse(config.block_size) && config.block_size > 0;
+		else if(flag == "--level") valid = parse(config.level);
+		else if(flag == "--compression") {
+			if(value == "none") config.compression = stylizer::compression::None;
+			else if(value == "lz4") config.compression = stylizer::compression::LZ4;
+			else if(value == "zstd") config.compression = stylizer::compression::Zstd;
+			else valid = false;
+		} else valid = false;
+
+		if(!valid) {
+			std::cerr << "Invalid argument: " << flag << " " << value << std::endl;
+			return usage();
+		}
+	}
+
+	stylizer::context{}.register_default_error_handler();
+	try {
+		if(!stylizer::asset_pack::write(argv[1], argv[2], config))
+			return 1;
+	} catch(const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,104 @@
+#include "access_trace.hpp"
+#include "asset_pack.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <fstream>
+
+namespace stylizer {
+
+	access_trace& access_trace::start() {
+		std::scoped_lock lock(mutex);
+		recorded.clear();
+		seen.clear();
+		started = std::chrono::steady_clock::now();
+		active = true;
+		return *this;
+	}
+
+	access_trace& access_trace::stop() {
+		active = false;
+		return *this;
+	}
+
+	void access_trace::record(const std::filesystem::path& file, size_t bytes) {
+		if(!active) return;
+		std::scoped_lock lock(mutex);
+		if(!seen.insert(file.string()).second) return;
+		recorded.push_back({file, std::chrono::steady_clock::now() - started, bytes});
+	}
+
+	std::vector<access_trace::entry> access_trace::entries() const {
+		std::scoped_lock lock(mutex);
+		return recorded;
+	}
+
+	bool access_trace::save(const std::filesystem::path& manifest) const {
+		std::ofstream out(manifest, std::ios::trunc);
+		for(auto& entry: entries())
+			out << std::llround(entry.at.count() * 1000) << ' ' << entry.bytes << ' ' << entry.path.string() << '\n';
+		return bool(out);
+	}
+
+	std::vector<access_trace::entry> access_trace::load(const std::filesystem::path& manifest) {
+		std::vector<entry> out;
+		std::ifstream in(manifest);
+		for(std::string line; std::getline(in, line); ) {
+			auto first = line.find(' ');
+			auto second = first == line.npos ? line.npos : line.find(' ', first + 1);
+			if(second == line.npos) continue;
+
+			long long milliseconds;
+			size_t bytes;
+			if(std::from_chars(line.data(), line.data() + first, milliseconds).ec != std::errc{}) continue;
+			if(std::from_chars(line.data() + first + 1, line.data() + second, bytes).ec != std::errc{}) continue;
+			out.push_back({line.substr(second + 1), std::chrono::duration<double>(milliseconds / 1000.0), bytes});
+		}
+		return out;
+	}
+
+	access_trace& get_access_trace() {
+		static access_trace trace;
+		return trace;
+	}
+
+	// Prefetching bypasses load_file_handle so that it doesn't show up in the trace being recorded
+	static void prefetch_file(const std::filesystem::path& file, thread_pool& pool) {
+		try {
+			if(auto packed = find_in_mounted_asset_packs(file, pool); packed)
+				return advise(packed->span(), access_hint::WillNeed);
+
+			std::error_code ec;
+			auto canonical = std::filesystem::canonical(std::filesystem::absolute(file), ec);
+			if(ec) return; // The file has gone away since the trace was recorded
+
+			// NOTE: The handle is dropped straight away, the mapping stays in the file cache (until evicted) for the real load to find
+			advise(get_file_cache().acquire(canonical).span(), access_hint::WillNeed);
+		} catch(...) {} // The error handler may throw, prefetching is only ever a hint
+	}
+
+	size_t prefetch_files(std::span<const access_trace::entry> files, thread_pool& pool /* = thread_pool::get_default() */) {
+		if(files.empty()) return 0;
+
+		// Reading ahead is bound by the disk rather than the CPU, so only a few workers are occupied
+		// NOTE: Each lane walks every nth file so that the files are still (roughly) started in the order they were recorded
+		constexpr size_t max_lanes = 4;
+		auto paths = std::make_shared<std::vector<std::filesystem::path>>();
+		paths->reserve(files.size());
+		for(auto& file: files)
+			paths->push_back(file.path);
+
+		size_t lanes = std::clamp<size_t>(pool.size(), 1, std::min(max_lanes, paths->size()));
+		for(size_t lane = 0; lane < lanes; ++lane)
+			pool.enqueue([paths, lane, lanes, &pool] {
+				for(size_t i = lane; i < paths->size(); i += lanes)
+					prefetch_file((*paths)[i], pool);
+			});
+		return paths->size();
+	}
+
+	size_t prefetch_traced_files(const std::filesystem::path& manifest, thread_pool& pool /* = thread_pool::get_default() */) {
+		return prefetch_files(access_trace::load(manifest), pool);
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "load_file.hpp"
+#include "thread_pool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <unordered_set>
+
+namespace stylizer {
+
+	// Records which files are requested through load_file (and when), so that the next run can prefetch them before they are needed
+	// Eg:
+	//   stylizer::prefetch_traced_files("startup.trace"); // Reads ahead whatever the last run loaded, in the background
+	//   stylizer::get_access_trace().start();
+	//   ... load everything needed at startup ...
+	//   stylizer::get_access_trace().stop().save("startup.trace");
+	struct access_trace {
+		struct entry {
+			std::filesystem::path path; // As requested (relative paths are resolved against the working directory again when prefetching)
+			std::chrono::duration<double> at; // Since recording started
+			size_t bytes = 0;
+		};
+
+		access_trace& start();
+		access_trace& stop();
+		bool recording() const { return active; }
+
+		// NOTE: Only the first request for each file is recorded
+		void record(const std::filesystem::path& file, size_t bytes);
+
+		// In the order the files were first requested
+		std::vector<entry> entries() const;
+
+		// One `<milliseconds> <bytes> <path>` line per file
+		bool save(const std::filesystem::path& manifest) const;
+		static std::vector<entry> load(const std::filesystem::path& manifest);
+
+	protected:
+		std::atomic<bool> active = false;
+		std::chrono::steady_clock::time_point started;
+		std::vector<entry> recorded;
+		std::unordered_set<std::string> seen;
+		mutable std::mutex mutex;
+	};
+
+	access_trace& get_access_trace();
+
+	// Maps the files into the file cache and has the kernel read them ahead, in the background on pool
+	// NOTE: Files are started in the order they are listed, missing ones are skipped (the trace may be stale), and asset packs need to be mounted first for their files to be found
+	// Returns how many files were queued
+	size_t prefetch_files(std::span<const access_trace::entry> files, thread_pool& pool = thread_pool::get_default());
+	size_t prefetch_traced_files(const std::filesystem::path& manifest, thread_pool& pool = thread_pool::get_default());
+}
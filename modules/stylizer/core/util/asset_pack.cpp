@@ -0,0 +1,286 @@
+#include "asset_pack.hpp"
+#include "thread_pool.hpp"
+#include "../api.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <list>
+#include <string>
+#include <vector>
+
+namespace stylizer {
+
+	// The blocks must exactly cover the uncompressed entry and lie inside of the stored blob
+	static bool valid_block_table(const asset_pack::entry& entry, std::span<const std::byte> data) {
+		if(data.size() < sizeof(asset_pack::block_table)) return false;
+		auto& table = *(const asset_pack::block_table*)data.data();
+		if(table.block_size == 0 || table.block_count != (entry.uncompressed_size + table.block_size - 1) / table.block_size
+			|| table.block_count > (data.size() - sizeof(asset_pack::block_table)) / sizeof(asset_pack::block)
+		) return false;
+
+		std::span<const asset_pack::block> blocks = {(const asset_pack::block*)(data.data() + sizeof(asset_pack::block_table)), table.block_count};
+		return std::all_of(blocks.begin(), blocks.end(), [&](const asset_pack::block& block) {
+			return block.offset <= data.size() && block.size <= data.size() - block.offset;
+		});
+	}
+
+	std::optional<asset_pack> asset_pack::open(const std::filesystem::path& pack, const std::filesystem::path& mount_point, access_hint hint /* = access_hint::Normal */) {
+		asset_pack out;
+		out.path = std::filesystem::canonical(std::filesystem::absolute(pack));
+		out.mount_point = std::filesystem::absolute(mount_point).lexically_normal();
+		out.file = get_file_cache().acquire(out.path);
+		if(!out.file) return {};
+
+		auto bytes = out.file.span();
+		if(bytes.size() < sizeof(struct header) || out.header().magic != magic || out.header().version != version) {
+			get_error_handler()(stylizer::error_severity::Error, "`" + out.path.string() + "` is not a valid asset pack!", 0);
+			return {};
+		}
+		auto& header = out.header();
+		// NOTE: Written so that corrupt (huge) offsets and sizes can't overflow
+		auto fits = [](uint64_t offset, uint64_t size, uint64_t total) { return offset <= total && size <= total - offset; };
+		auto truncated = [&] {
+			get_error_handler()(stylizer::error_severity::Error, "Asset pack `" + out.path.string() + "` is truncated or corrupt!", 0);
+			return std::optional<asset_pack>{};
+		};
+		if(header.entry_count > bytes.size() / sizeof(entry) || !fits(header.index_offset, header.entry_count * sizeof(entry), bytes.size())
+			|| !fits(header.strings_offset, header.strings_size, bytes.size())
+		) return truncated();
+
+		// Every range an entry refers to is checked once here, so lookups and loads can slice the mapping without checking again
+		for(auto& entry: out.entries())
+			if(!fits(entry.path_offset, entry.path_size, bytes.size()) || entry.path_offset < header.strings_offset
+				|| entry.path_offset + entry.path_size > header.strings_offset + header.strings_size
+				|| !fits(entry.offset, entry.size, bytes.size())
+				|| (entry.compression() == compression::None && entry.size != entry.uncompressed_size)
+				|| (entry.compression() != compression::None && !valid_block_table(entry, out.entry_data(entry)))
+			) return truncated();
+
+		advise(bytes, hint);
+		// The index and path table are needed for every lookup
+		advise(bytes.subspan(header.index_offset, header.entry_count * sizeof(entry)), access_hint::WillNeed);
+		advise(bytes.subspan(header.strings_offset, header.strings_size), access_hint::WillNeed);
+		return out;
+	}
+
+	bool asset_pack::write(const std::filesystem::path& output, const std::filesystem::path& directory, const write_config& config) {
+		if(config.alignment == 0 || (config.alignment & (config.alignment - 1)) != 0) {
+			get_error_handler()(stylizer::error_severity::Error, "Asset pack alignment must be a power of two!", 0);
+			return false;
+		}
+		if(!compression_available(config.compression)) {
+			get_error_handler()(stylizer::error_severity::Error, "The requested asset pack compression method is not available in this build!", 0);
+			return false;
+		}
+
+		std::vector<std::pair<std::string, std::filesystem::path>> files;
+		for(auto& file: std::filesystem::recursive_directory_iterator(directory))
+			if(file.is_regular_file())
+				files.emplace_back(file.path().lexically_relative(directory).generic_string(), file.path());
+		std::sort(files.begin(), files.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+		auto align = [alignment = config.alignment](uint64_t offset) { return (offset + alignment - 1) & ~uint64_t(alignment - 1); };
+
+		struct header header;
+		header.entry_count = files.size();
+		header.index_offset = sizeof(struct header);
+		header.strings_offset = header.index_offset + files.size() * sizeof(entry);
+		header.alignment = config.alignment;
+
+		std::vector<entry> index(files.size());
+		std::string strings;
+		for(size_t i = 0; i < files.size(); ++i) {
+			index[i].path_offset = header.strings_offset + strings.size();
+			index[i].path_size = files[i].first.size();
+			strings += files[i].first;
+		}
+		header.strings_size = strings.size();
+
+		std::ofstream out(output, std::ios::binary | std::ios::trunc);
+		if(!out) {
+			get_error_handler()(stylizer::error_severity::Error, "Failed to open `" + output.string() + "` for writing!", 0);
+			return false;
+		}
+		// The index is rewritten once the blob sizes are known
+		out.write((const char*)&header, sizeof(header));
+		out.write((const char*)index.data(), index.size() * sizeof(entry));
+		out.write(strings.data(), strings.size());
+
+		std::vector<std::byte> buffer;
+		std::vector<std::vector<std::byte>> compressed;
+		for(size_t i = 0; i < files.size(); ++i) {
+			std::ifstream in(files[i].second, std::ios::binary);
+			buffer.resize(std::filesystem::file_size(files[i].second));
+			if(!in.read((char*)buffer.data(), buffer.size())) {
+				get_error_handler()(stylizer::error_severity::Error, "Failed to read `" + files[i].second.string() + "` while packing!", 0);
+				return false;
+			}
+
+			auto& entry = index[i];
+			entry.offset = align(out.tellp());
+			entry.uncompressed_size = buffer.size();
+			std::vector<char> padding(entry.offset - out.tellp(), 0);
+			out.write(padding.data(), padding.size());
+
+			if(config.compression != compression::None && !buffer.empty()) {
+				block_table table{config.block_size, (buffer.size() + config.block_size - 1) / config.block_size};
+				compressed.resize(table.block_count);
+				thread_pool::get_default().parallel_for(table.block_count, [&](size_t b) {
+					auto source = std::span<const std::byte>{buffer}.subspan(b * table.block_size);
+					compressed[b] = compress(config.compression, source.first(std::min<size_t>(source.size(), table.block_size)), config.level);
+				});
+
+				std::vector<block> blocks(table.block_count);
+				uint64_t offset = sizeof(block_table) + blocks.size() * sizeof(block), total = offset;
+				for(size_t b = 0; b < blocks.size(); ++b) {
+					blocks[b] = {offset, compressed[b].size()};
+					offset += compressed[b].size();
+					total += compressed[b].size();
+				}
+
+				bool failed = std::any_of(compressed.begin(), compressed.end(), [](auto& block) { return block.empty(); });
+				if(!failed && total < buffer.size()) {
+					entry.flags = (uint32_t)config.compression;
+					entry.size = total;
+					out.write((const char*)&table, sizeof(table));
+					out.write((const char*)blocks.data(), blocks.size() * sizeof(block));
+					for(auto& block: compressed)
+						out.write((const char*)block.data(), block.size());
+					continue;
+				}
+			}
+
+			entry.size = buffer.size();
+			out.write((const char*)buffer.data(), buffer.size());
+		}
+
+		out.seekp(header.index_offset);
+		out.write((const char*)index.data(), index.size() * sizeof(entry));
+		return bool(out);
+	}
+
+	std::span<const asset_pack::entry> asset_pack::entries() const {
+		return {(const entry*)(file.span().data() + header().index_offset), header().entry_count};
+	}
+
+	std::string_view asset_pack::entry_path(const entry& entry) const {
+		return {(const char*)file.span().data() + entry.path_offset, entry.path_size};
+	}
+
+	std::span<std::byte> asset_pack::entry_data(const entry& entry) const {
+		return file.span().subspan(entry.offset, entry.size);
+	}
+
+	file_cache::handle asset_pack::load(const entry& entry, thread_pool& pool /* = thread_pool::get_default() */) const {
+		auto data = entry_data(entry);
+		if(entry.compression() == compression::None)
+			return {file.owner, data};
+
+		{
+			std::scoped_lock lock(decompressed->mutex);
+			if(auto found = decompressed->entries.find(&entry); found != decompressed->entries.end()) {
+				if(auto cached = found->second.lock(); cached)
+					return {cached, *cached};
+				decompressed->entries.erase(found); // Nobody is using it anymore
+			}
+		}
+
+		auto fail = [&](std::string_view why) -> file_cache::handle {
+			get_error_handler()(stylizer::error_severity::Error, "Failed to decompress `" + std::string(entry_path(entry)) + "` from asset pack `" + path.string() + "`: " + std::string(why), 0);
+			return {};
+		};
+		if(!compression_available(entry.compression()))
+			return fail("compression method not available in this build");
+
+		// NOTE: The block table was validated when the pack was opened
+		auto start = std::chrono::steady_clock::now();
+		auto& table = *(const block_table*)data.data();
+		std::span<const block> blocks = {(const block*)(data.data() + sizeof(block_table)), table.block_count};
+
+		auto out = decompression_arena::get_default().allocate(entry.uncompressed_size);
+		std::atomic<bool> succeeded = true;
+		pool.parallel_for(blocks.size(), [&](size_t b) {
+			auto destination = std::span<std::byte>{*out}.subspan(std::min(b * table.block_size, out->size()));
+			destination = destination.first(std::min<size_t>(destination.size(), table.block_size));
+			if(!decompress(entry.compression(), data.subspan(blocks[b].offset, blocks[b].size), destination))
+				succeeded = false;
+		});
+		if(!succeeded) return fail("corrupt block");
+
+		get_file_cache().record_decompression(data.size(), out->size(), std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+		std::scoped_lock lock(decompressed->mutex);
+		if(auto cached = decompressed->entries[&entry].lock(); cached) // Someone else decompressed it at the same time
+			return {cached, *cached};
+		std::erase_if(decompressed->entries, [](const auto& cached) { return cached.second.expired(); });
+		decompressed->entries[&entry] = out;
+		return {out, *out};
+	}
+
+	const asset_pack::entry* asset_pack::find(std::string_view relative_path) const {
+		auto entries = this->entries();
+		auto found = std::lower_bound(entries.begin(), entries.end(), relative_path, [this](const entry& entry, std::string_view path) {
+			return entry_path(entry) < path;
+		});
+		if(found == entries.end() || entry_path(*found) != relative_path) return nullptr;
+		return &*found;
+	}
+
+	const asset_pack::entry* asset_pack::find(const std::filesystem::path& path) const {
+		// NOTE: Purely lexical, packed paths can't be symlinks so there is no need to touch the filesystem
+		auto relative = std::filesystem::absolute(path).lexically_normal().lexically_relative(mount_point);
+		if(relative.empty() || *relative.begin() == "..") return nullptr;
+		return find(std::string_view{relative.generic_string()});
+	}
+
+	const asset_pack& asset_pack::prefetch() const {
+		advise(file.span(), access_hint::WillNeed);
+		return *this;
+	}
+
+	// NOTE: A list so that pointers returned from mount_asset_pack stay valid
+	static std::list<asset_pack>& get_mounted_asset_packs() {
+		static std::list<asset_pack> packs;
+		return packs;
+	}
+	static std::mutex& get_mounted_asset_packs_mutex() {
+		static std::mutex mutex;
+		return mutex;
+	}
+
+	asset_pack* mount_asset_pack(const std::filesystem::path& pack, const std::filesystem::path& mount_point /* = current_path */, access_hint hint /* = access_hint::Normal */) {
+		auto opened = asset_pack::open(pack, mount_point, hint);
+		if(!opened) return nullptr;
+
+		std::scoped_lock lock(get_mounted_asset_packs_mutex());
+		return &get_mounted_asset_packs().emplace_back(std::move(*opened));
+	}
+
+	bool unmount_asset_pack(const std::filesystem::path& pack_) {
+		auto pack = std::filesystem::canonical(std::filesystem::absolute(pack_));
+
+		std::scoped_lock lock(get_mounted_asset_packs_mutex());
+		auto& packs = get_mounted_asset_packs();
+		auto found = std::find_if(packs.begin(), packs.end(), [&](const asset_pack& mounted) { return mounted.path == pack; });
+		if(found == packs.end()) return false;
+
+		packs.erase(found);
+		return true;
+	}
+
+	std::optional<file_cache::handle> find_in_mounted_asset_packs(const std::filesystem::path& file, thread_pool& pool /* = thread_pool::get_default() */) {
+		std::optional<asset_pack> found_pack;
+		const asset_pack::entry* found = nullptr;
+		{
+			std::scoped_lock lock(get_mounted_asset_packs_mutex());
+			auto& packs = get_mounted_asset_packs();
+			for(auto pack = packs.rbegin(); pack != packs.rend() && !found; ++pack)
+				if(found = pack->find(file); found)
+					found_pack = *pack; // NOTE: The copy keeps the mapping alive even if the pack gets unmounted
+		}
+		// Decompression happens outside of the lock so other lookups aren't blocked
+		if(found) return found_pack->load(*found, pool);
+		return {};
+	}
+}
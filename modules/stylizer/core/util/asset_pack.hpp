@@ -0,0 +1,101 @@
+#pragma once
+
+#include "compression.hpp"
+#include "load_file.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+
+namespace stylizer {
+
+	// A single file containing many assets which is mapped once and then sliced
+	// Layout (little endian):
+	//   header
+	//   index: header.entry_count entries sorted by path
+	//   strings: the paths referenced by the index (relative to the packed directory, '/' separated)
+	//   blobs: each aligned to header.alignment
+	// Compressed blobs start with a block_table followed by its blocks, every block can be decompressed independently
+	struct asset_pack {
+		constexpr static uint32_t magic = 0x4B415053; // "SPAK"
+		constexpr static uint32_t version = 2;
+
+		struct header {
+			uint32_t magic = asset_pack::magic;
+			uint32_t version = asset_pack::version;
+			uint64_t entry_count = 0;
+			uint64_t index_offset = 0;
+			uint64_t strings_offset = 0;
+			uint64_t strings_size = 0;
+			uint32_t alignment = 0;
+			uint32_t flags = 0;
+		};
+
+		struct entry {
+			uint64_t path_offset = 0;
+			uint32_t path_size = 0;
+			uint32_t flags = 0; // Lowest byte is the compression method
+			uint64_t offset = 0;
+			uint64_t size = 0; // Size stored in the pack
+			uint64_t uncompressed_size = 0;
+
+			enum compression compression() const { return (enum compression)(flags & 0xFF); }
+		};
+
+		struct block_table {
+			uint64_t block_size = 0; // Uncompressed size of every block but the last
+			uint64_t block_count = 0;
+		};
+		struct block {
+			uint64_t offset = 0; // Relative to the start of the blob
+			uint64_t size = 0;
+		};
+
+		struct write_config {
+			uint32_t alignment = 64;
+			enum compression compression = compression::None;
+			uint32_t block_size = 256 * 1024;
+			int level = 0; // 0 = the compressor's default
+		};
+
+		std::filesystem::path path;
+		file_cache::handle file;
+		std::filesystem::path mount_point;
+
+		static std::optional<asset_pack> open(const std::filesystem::path& pack, const std::filesystem::path& mount_point, access_hint hint = access_hint::Normal);
+		// Packs every regular file below directory, returns false (after reporting an error) on failure
+		// NOTE: Files which don't get smaller when compressed are stored uncompressed
+		static bool write(const std::filesystem::path& output, const std::filesystem::path& directory, const write_config& config);
+		static bool write(const std::filesystem::path& output, const std::filesystem::path& directory) { return write(output, directory, write_config{}); }
+
+		const struct header& header() const { return *(const struct header*)file.span().data(); }
+		std::span<const entry> entries() const;
+		std::string_view entry_path(const entry& entry) const;
+		std::span<std::byte> entry_data(const entry& entry) const;
+
+		// Returns a view of the mapped entry, compressed entries are decompressed (in parallel per block on pool) into the default decompression_arena
+		file_cache::handle load(const entry& entry, thread_pool& pool = thread_pool::get_default()) const;
+
+		// Binary searches the index for a path relative to the mount point
+		const entry* find(std::string_view relative_path) const;
+		// Resolves a path (relative to the working directory or absolute) against the mount point
+		const entry* find(const std::filesystem::path& path) const;
+
+		// Asks the kernel to start reading the whole pack in
+		const asset_pack& prefetch() const;
+
+	protected:
+		// Decompressed entries are shared while anyone is still using them, expired ones are pruned as entries are looked up
+		struct decompression_cache {
+			std::mutex mutex;
+			std::unordered_map<const entry*, std::weak_ptr<std::vector<std::byte>>> entries;
+		};
+		std::shared_ptr<decompression_cache> decompressed = std::make_shared<decompression_cache>();
+	};
+
+	// Mounted packs are searched (most recently mounted first) by load_file before falling back to the filesystem
+	asset_pack* mount_asset_pack(const std::filesystem::path& pack, const std::filesystem::path& mount_point = std::filesystem::current_path(), access_hint hint = access_hint::Normal);
+	bool unmount_asset_pack(const std::filesystem::path& pack);
+	std::optional<file_cache::handle> find_in_mounted_asset_packs(const std::filesystem::path& file, thread_pool& pool = thread_pool::get_default());
+}
@@ -0,0 +1,180 @@
+#include "asset_telemetry.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+	#include <sys/mman.h>
+	#include <sys/resource.h>
+	#include <unistd.h>
+#endif
+
+namespace stylizer {
+
+	// The asset the current thread is loading (owned by the outermost scope)
+	static thread_local const std::string* current_asset = nullptr;
+
+	static void thread_page_faults(size_t& major, size_t& minor) {
+#if defined(__linux__)
+		rusage usage;
+		if(getrusage(RUSAGE_THREAD, &usage) == 0) {
+			major = usage.ru_majflt;
+			minor = usage.ru_minflt;
+			return;
+		}
+#endif
+		major = minor = 0;
+	}
+
+	asset_telemetry::scope::scope(phase phase, const std::filesystem::path& asset /* = {} */) : measuring(phase) {
+		auto& telemetry = get_asset_telemetry();
+		if(!telemetry.enabled()) return;
+
+		if(!asset.empty() && (!current_asset || *current_asset != asset.string())) {
+			this->asset = asset.string();
+			previous = std::exchange(current_asset, &this->asset);
+			outermost = true;
+			thread_page_faults(major_faults, minor_faults);
+		} else if(!current_asset) return;
+
+		this->telemetry = &telemetry;
+		start = std::chrono::steady_clock::now();
+	}
+
+	asset_telemetry::scope::~scope() {
+		if(!telemetry) return;
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		size_t major = 0, minor = 0;
+		if(outermost) thread_page_faults(major, minor);
+		telemetry->update(*current_asset, [&](record& record) {
+			switch(measuring) {
+			case phase::Load: break;
+			case phase::Map: record.map_seconds += seconds; break;
+			case phase::Decode: record.decode_seconds += seconds; break;
+			case phase::Upload: record.upload_seconds += seconds; break;
+			}
+			if(!outermost) return;
+
+			++record.loads;
+			record.wall_seconds += seconds;
+			record.major_faults += major - major_faults;
+			record.minor_faults += minor - minor_faults;
+		});
+		if(outermost) current_asset = previous;
+	}
+
+	template<typename Tfunc>
+	void asset_telemetry::update(const std::string& asset, const Tfunc& func) {
+		std::scoped_lock lock(mutex);
+		auto [found, inserted] = lookup.try_emplace(asset, entries.size());
+		if(inserted) entries.push_back({asset});
+		func(entries[found->second]);
+	}
+
+	void asset_telemetry::record_mapped(std::span<const std::byte> memory) {
+		if(!enabled() || !current_asset) return;
+		update(*current_asset, [&](record& record) { record.bytes_mapped += memory.size(); });
+	}
+
+	void asset_telemetry::record_touched(std::span<const std::byte> memory) {
+		if(!enabled() || !current_asset || memory.empty()) return;
+
+		size_t touched = memory.size(); // Without mincore everything is assumed to have been read
+#if defined(__unix__) || defined(__APPLE__)
+		static const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+		auto begin = (uintptr_t)memory.data() & ~(page_size - 1);
+		auto end = (uintptr_t)(memory.data() + memory.size());
+	#ifdef __APPLE__
+		std::vector<char> resident((end - begin + page_size - 1) / page_size);
+	#else
+		std::vector<unsigned char> resident((end - begin + page_size - 1) / page_size);
+	#endif
+		if(mincore((void*)begin, end - begin, resident.data()) == 0) {
+			touched = 0;
+			for(auto page: resident)
+				if(page & 1) touched += page_size;
+			touched = std::min(touched, memory.size());
+		}
+#endif
+		update(*current_asset, [&](record& record) { record.bytes_touched += touched; });
+	}
+
+	void asset_telemetry::record_upload(size_t bytes) {
+		if(!enabled() || !current_asset) return;
+		update(*current_asset, [&](record& record) { record.upload_bytes += bytes; });
+	}
+
+	std::vector<asset_telemetry::record> asset_telemetry::records() const {
+		std::scoped_lock lock(mutex);
+		return entries;
+	}
+
+	std::optional<asset_telemetry::record> asset_telemetry::find(const std::filesystem::path& asset) const {
+		std::scoped_lock lock(mutex);
+		if(auto found = lookup.find(asset.string()); found != lookup.end())
+			return entries[found->second];
+		return {};
+	}
+
+	asset_telemetry& asset_telemetry::clear() {
+		std::scoped_lock lock(mutex);
+		entries.clear();
+		lookup.clear();
+		return *this;
+	}
+
+	static void write_json_string(std::ostream& out, std::string_view string) {
+		out << '"';
+		for(char c: string)
+			switch(c) {
+			case '"': out << "\\\""; break;
+			case '\\': out << "\\\\"; break;
+			case '\n': out << "\\n"; break;
+			case '\t': out << "\\t"; break;
+			default:
+				if((unsigned char)c < 0x20) {
+					char escaped[7];
+					std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+					out << escaped;
+				} else out << c;
+			}
+		out << '"';
+	}
+
+	std::string asset_telemetry::to_json() const {
+		std::ostringstream out;
+		out << "[";
+		bool first = true;
+		for(auto& record: records()) {
+			out << (first ? "\n" : ",\n") << "\t{\"path\": ";
+			first = false;
+			write_json_string(out, record.path);
+			out << ", \"loads\": " << record.loads
+				<< ", \"bytes_mapped\": " << record.bytes_mapped
+				<< ", \"bytes_touched\": " << record.bytes_touched
+				<< ", \"major_faults\": " << record.major_faults
+				<< ", \"minor_faults\": " << record.minor_faults
+				<< ", \"upload_bytes\": " << record.upload_bytes
+				<< ", \"map_seconds\": " << record.map_seconds
+				<< ", \"decode_seconds\": " << record.decode_seconds
+				<< ", \"upload_seconds\": " << record.upload_seconds
+				<< ", \"wall_seconds\": " << record.wall_seconds << "}";
+		}
+		out << (first ? "]\n" : "\n]\n");
+		return out.str();
+	}
+
+	bool asset_telemetry::dump_json(const std::filesystem::path& output) const {
+		std::ofstream out(output, std::ios::trunc);
+		out << to_json();
+		return bool(out);
+	}
+
+	asset_telemetry& get_asset_telemetry() {
+		static asset_telemetry telemetry;
+		return telemetry;
+	}
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace stylizer {
+	struct asset_telemetry;
+	asset_telemetry& get_asset_telemetry();
+
+	// Per asset breakdown of where loading time goes (disk, parsing/decoding or uploading)
+	// Eg:
+	//   stylizer::get_asset_telemetry().enable();
+	//   ... load ...
+	//   stylizer::get_asset_telemetry().dump_json("load_telemetry.json");
+	// NOTE: Disabled by default, while disabled measuring costs a single atomic load
+	struct asset_telemetry {
+		struct record {
+			std::string path;
+			size_t loads = 0;
+			size_t bytes_mapped = 0;
+			size_t bytes_touched = 0; // Resident after decoding (mincore), on a cold page cache this is what was actually read from disk
+			size_t major_faults = 0, minor_faults = 0; // Of the loading thread, work handed to other threads (eg parallel parsing) isn't included
+			size_t upload_bytes = 0;
+			double map_seconds = 0, decode_seconds = 0, upload_seconds = 0;
+			double wall_seconds = 0; // From the start of the load until it returned, everything above included
+		};
+
+		enum class phase {
+			Load, // The whole load, only needs a path if it isn't nested inside another load
+			Map,
+			Decode,
+			Upload,
+		};
+
+		// Measures from construction to destruction and adds the result to the asset's record
+		// NOTE: Scopes without a path are attributed to whichever asset the thread is currently loading (and ignored if there is none)
+		struct scope {
+			scope(phase phase, const std::filesystem::path& asset = {});
+			scope(const scope&) = delete;
+			~scope();
+
+		protected:
+			struct asset_telemetry* telemetry = nullptr;
+			enum phase measuring;
+			std::string asset;
+			const std::string* previous = nullptr;
+			bool outermost = false; // The first scope of an asset on this thread, measures the wall time and page faults
+			std::chrono::steady_clock::time_point start;
+			size_t major_faults = 0, minor_faults = 0;
+		};
+
+		asset_telemetry& enable(bool enabled = true) {
+			active = enabled;
+			return *this;
+		}
+		bool enabled() const { return active; }
+
+		// Runs func as the decode phase of the asset being loaded on this thread, and records how much of memory it ended up touching
+		template<typename Tfunc>
+		static auto measure_decode(std::span<const std::byte> memory, const Tfunc& func) {
+			auto out = [&] {
+				scope measure(phase::Decode);
+				return func();
+			}();
+			get_asset_telemetry().record_touched(memory);
+			return out;
+		}
+
+		// Attributed to the asset being loaded on this thread
+		void record_mapped(std::span<const std::byte> memory);
+		void record_touched(std::span<const std::byte> memory);
+		void record_upload(size_t bytes);
+
+		std::vector<record> records() const;
+		std::optional<record> find(const std::filesystem::path& asset) const;
+		asset_telemetry& clear();
+
+		std::string to_json() const;
+		bool dump_json(const std::filesystem::path& output) const;
+
+	protected:
+		std::atomic<bool> active = false;
+		std::vector<record> entries; // In the order the assets were first loaded
+		std::unordered_map<std::string, size_t> lookup;
+		mutable std::mutex mutex;
+
+		template<typename Tfunc>
+		void update(const std::string& asset, const Tfunc& func);
+	};
+}
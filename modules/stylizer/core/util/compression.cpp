@@ -0,0 +1,109 @@
+#include "compression.hpp"
+
+#include <algorithm>
+
+#ifdef STYLIZER_LZ4_AVAILABLE
+	#include <lz4.h>
+	#include <lz4hc.h>
+#endif
+#ifdef STYLIZER_ZSTD_AVAILABLE
+	#include <zstd.h>
+#endif
+
+namespace stylizer {
+
+	bool compression_available(compression method) {
+		switch(method) {
+		case compression::None: return true;
+#ifdef STYLIZER_LZ4_AVAILABLE
+		case compression::LZ4: return true;
+#endif
+#ifdef STYLIZER_ZSTD_AVAILABLE
+		case compression::Zstd: return true;
+#endif
+		default: return false;
+		}
+	}
+
+	std::vector<std::byte> compress(compression method, std::span<const std::byte> source, int level /* = 0 */) {
+		std::vector<std::byte> out;
+		switch(method) {
+		case compression::None:
+			out.assign(source.begin(), source.end());
+			break;
+#ifdef STYLIZER_LZ4_AVAILABLE
+		case compression::LZ4: {
+			out.resize(LZ4_compressBound(source.size()));
+			int size = level > 0
+				? LZ4_compress_HC((const char*)source.data(), (char*)out.data(), source.size(), out.size(), level)
+				: LZ4_compress_default((const char*)source.data(), (char*)out.data(), source.size(), out.size());
+			out.resize(std::max(size, 0));
+		} break;
+#endif
+#ifdef STYLIZER_ZSTD_AVAILABLE
+		case compression::Zstd: {
+			out.resize(ZSTD_compressBound(source.size()));
+			auto size = ZSTD_compress(out.data(), out.size(), source.data(), source.size(), level ? level : ZSTD_CLEVEL_DEFAULT);
+			out.resize(ZSTD_isError(size) ? 0 : size);
+		} break;
+#endif
+		default: break;
+		}
+		return out;
+	}
+
+	bool decompress(compression method, std::span<const std::byte> source, std::span<std::byte> destination) {
+		switch(method) {
+		case compression::None:
+			if(source.size() != destination.size()) return false;
+			std::copy(source.begin(), source.end(), destination.begin());
+			return true;
+#ifdef STYLIZER_LZ4_AVAILABLE
+		case compression::LZ4:
+			return LZ4_decompress_safe((const char*)source.data(), (char*)destination.data(), source.size(), destination.size()) == int(destination.size());
+#endif
+#ifdef STYLIZER_ZSTD_AVAILABLE
+		case compression::Zstd:
+			return ZSTD_decompress(destination.data(), destination.size(), source.data(), source.size()) == destination.size();
+#endif
+		default: return false;
+		}
+	}
+
+	std::shared_ptr<std::vector<std::byte>> decompression_arena::allocate(size_t size) {
+		std::unique_ptr<std::vector<std::byte>> buffer;
+		{
+			std::scoped_lock lock(mutex);
+			// Prefer the smallest free buffer that is already big enough
+			auto best = free.end();
+			for(auto it = free.begin(); it != free.end(); ++it)
+				if((*it)->capacity() >= size && (best == free.end() || (*it)->capacity() < (*best)->capacity()))
+					best = it;
+			if(best == free.end() && !free.empty()) best = free.end() - 1;
+
+			if(best != free.end()) {
+				retained_bytes -= (*best)->capacity();
+				buffer = std::move(*best);
+				free.erase(best);
+			}
+		}
+		if(!buffer) buffer = std::make_unique<std::vector<std::byte>>();
+		buffer->resize(size);
+
+		return {buffer.release(), [this](std::vector<std::byte>* buffer) { recycle(buffer); }};
+	}
+
+	void decompression_arena::recycle(std::vector<std::byte>* buffer) {
+		std::unique_ptr<std::vector<std::byte>> owned(buffer);
+		std::scoped_lock lock(mutex);
+		if(retained_bytes + owned->capacity() > max_retained_bytes) return;
+
+		retained_bytes += owned->capacity();
+		free.emplace_back(std::move(owned));
+	}
+
+	decompression_arena& decompression_arena::get_default() {
+		static decompression_arena arena;
+		return arena;
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+namespace stylizer {
+
+	enum class compression : uint32_t {
+		None = 0,
+		LZ4 = 1, // Requires STYLIZER_LZ4_AVAILABLE
+		Zstd = 2, // Requires STYLIZER_ZSTD_AVAILABLE
+	};
+
+	bool compression_available(compression method);
+
+	// Returns an empty vector if the method is unavailable or compression fails
+	std::vector<std::byte> compress(compression method, std::span<const std::byte> source, int level = 0);
+	// NOTE: destination must be exactly the size of the decompressed data
+	bool decompress(compression method, std::span<const std::byte> source, std::span<std::byte> destination);
+
+	// Recycles decompression buffers so that streaming compressed assets doesn't constantly hit the allocator
+	struct decompression_arena {
+		size_t max_retained_bytes = 64 * 1024 * 1024;
+
+		// The buffer is handed back to the arena once the last reference is dropped
+		std::shared_ptr<std::vector<std::byte>> allocate(size_t size);
+
+		static decompression_arena& get_default();
+
+	protected:
+		std::vector<std::unique_ptr<std::vector<std::byte>>> free;
+		size_t retained_bytes = 0;
+		std::mutex mutex;
+
+		void recycle(std::vector<std::byte>* buffer);
+	};
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace stylizer {
+
+	template<typename T>
+	inline T byteswap(T value) {
+		static_assert(std::is_trivially_copyable_v<T>);
+		std::byte bytes[sizeof(T)];
+		std::memcpy(bytes, &value, sizeof(T));
+		for(size_t i = 0; i < sizeof(T) / 2; ++i)
+			std::swap(bytes[i], bytes[sizeof(T) - 1 - i]);
+		std::memcpy(&value, bytes, sizeof(T));
+		return value;
+	}
+
+	// Reads a (possibly unaligned) value stored with the given endianness
+	template<typename T>
+	inline T load_endian(const std::byte* at, std::endian endian) {
+		T out;
+		std::memcpy(&out, at, sizeof(T));
+		return endian == std::endian::native ? out : byteswap(out);
+	}
+	template<typename T>
+	inline T load_little_endian(const std::byte* at) { return load_endian<T>(at, std::endian::little); }
+	template<typename T>
+	inline T load_big_endian(const std::byte* at) { return load_endian<T>(at, std::endian::big); }
+}
@@ -0,0 +1,158 @@
+#include "file_watcher.hpp"
+#include "load_file.hpp"
+#include "../api.hpp"
+
+#include <tuple>
+#include <vector>
+
+#ifdef __linux__
+	#include <sys/inotify.h>
+	#include <unistd.h>
+	#include <cerrno>
+#endif
+
+namespace stylizer {
+
+	file_watcher::file_watcher() {
+#ifdef __linux__
+		inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if(inotify < 0)
+			get_error_handler()(stylizer::error_severity::Warning, "Failed to initialize inotify, falling back to polling for file changes!", 0);
+#endif
+	}
+
+	file_watcher::~file_watcher() {
+		polled_contexts.clear(); // Disconnect the update hooks before anything they use is torn down
+#ifdef __linux__
+		if(inotify >= 0) close(inotify);
+#endif
+	}
+
+	file_watcher& file_watcher::get_default() {
+		static file_watcher watcher;
+		return watcher;
+	}
+
+	file_watcher::token file_watcher::watch(const std::filesystem::path& file_, callback_t on_change) {
+		auto file = std::filesystem::canonical(std::filesystem::absolute(file_));
+
+		std::scoped_lock lock(mutex);
+#ifdef __linux__
+		// NOTE: Watch the parent directory since most editors save by replacing the file
+		if(inotify >= 0) {
+			auto directory = file.parent_path();
+			auto& [descriptor, count] = directory_watches[directory];
+			if(count++ == 0) {
+				descriptor = inotify_add_watch(inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO); // NOTE: Not IN_CREATE, new files are usually still being written
+				if(descriptor < 0)
+					get_error_handler()(stylizer::error_severity::Warning, "Failed to watch `" + directory.string() + "` for changes!", 0);
+				else directories[descriptor] = directory;
+			}
+		}
+#endif
+
+		std::error_code ec;
+		auto id = next_id++;
+		watches[id] = {file, std::move(on_change), std::filesystem::last_write_time(file, ec)};
+		return {this, id};
+	}
+
+	void file_watcher::unwatch(size_t id) {
+		std::scoped_lock lock(mutex);
+		auto found = watches.find(id);
+		if(found == watches.end()) return;
+
+#ifdef __linux__
+		if(auto directory = directory_watches.find(found->second.file.parent_path()); directory != directory_watches.end())
+			if(--directory->second.second == 0) {
+				if(directory->second.first >= 0) {
+					inotify_rm_watch(inotify, directory->second.first);
+					directories.erase(directory->second.first);
+				}
+				directory_watches.erase(directory);
+			}
+#endif
+		watches.erase(found);
+	}
+
+	size_t file_watcher::poll() {
+		std::unordered_set<std::filesystem::path> changed, triggered;
+		std::vector<std::tuple<size_t, std::filesystem::path, callback_t>> callbacks;
+		{
+			std::scoped_lock lock(mutex);
+			bool polled = false;
+#ifdef __linux__
+			if(inotify >= 0) {
+				polled = true;
+				alignas(inotify_event) char buffer[16 * 1024];
+				while(true) {
+					auto size = read(inotify, buffer, sizeof(buffer));
+					if(size <= 0) break; // EAGAIN, nothing left to read
+
+					for(char* at = buffer; at < buffer + size; ) {
+						auto& event = *(inotify_event*)at;
+						if(event.len > 0)
+							if(auto directory = directories.find(event.wd); directory != directories.end())
+								changed.insert(directory->second / event.name);
+						at += sizeof(inotify_event) + event.len;
+					}
+				}
+			}
+#endif
+			std::error_code ec;
+			for(auto& [id, watch]: watches) {
+				if(!polled) {
+					auto last_write = std::filesystem::last_write_time(watch.file, ec);
+					if(!ec && last_write != watch.last_write) {
+						watch.last_write = last_write;
+						changed.insert(watch.file);
+					}
+				}
+				if(changed.contains(watch.file)) {
+					triggered.insert(watch.file);
+					callbacks.emplace_back(id, watch.file, watch.on_change);
+				}
+			}
+		}
+
+		// NOTE: Callbacks are invoked without holding the lock so that they can (un)watch files
+		for(auto& file: changed)
+			get_file_cache().invalidate(file);
+		for(auto& [id, file, callback]: callbacks) {
+			{
+				// An earlier callback may have torn down whatever this one refers to
+				std::scoped_lock lock(mutex);
+				if(!watches.contains(id)) continue;
+			}
+			callback(file);
+		}
+		return triggered.size();
+	}
+
+	static bool same_lifetime(const std::weak_ptr<const void>& a, const std::weak_ptr<const void>& b) {
+		return !a.owner_before(b) && !b.owner_before(a);
+	}
+
+	file_watcher& file_watcher::poll_on_update(context& ctx) {
+		auto lifetime = ctx.lifetime();
+		std::scoped_lock lock(mutex);
+		std::erase_if(polled_contexts, [](const polled_context& polled) { return polled.lifetime.expired(); });
+		for(auto& polled: polled_contexts)
+			if(same_lifetime(polled.lifetime, lifetime))
+				return *this;
+
+		polled_contexts.emplace_back(std::move(lifetime), connection(ctx.process_events.connect([this](context&) {
+			poll();
+		})));
+		return *this;
+	}
+
+	file_watcher& file_watcher::stop_polling_on_update(context& ctx) {
+		auto lifetime = ctx.lifetime();
+		std::scoped_lock lock(mutex);
+		std::erase_if(polled_contexts, [&lifetime](const polled_context& polled) {
+			return polled.lifetime.expired() || same_lifetime(polled.lifetime, lifetime);
+		});
+		return *this;
+	}
+}
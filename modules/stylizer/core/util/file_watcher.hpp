@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stylizer/api/api.hpp>
+
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace stylizer {
+
+	// Watches files for modification, uses inotify on Linux and falls back to polling modification times elsewhere
+	// NOTE: Files served from mounted asset packs are not watched
+	struct file_watcher {
+		using callback_t = std::function<void(const std::filesystem::path&)>;
+
+		// Stops watching when destroyed
+		struct token {
+			file_watcher* watcher = nullptr;
+			size_t id = 0;
+
+			token() = default;
+			token(file_watcher* watcher, size_t id) : watcher(watcher), id(id) {}
+			token(const token&) = delete;
+			token(token&& o) : watcher(std::exchange(o.watcher, nullptr)), id(std::exchange(o.id, 0)) {}
+			token& operator=(const token&) = delete;
+			token& operator=(token&& o) {
+				release();
+				watcher = std::exchange(o.watcher, nullptr);
+				id = std::exchange(o.id, 0);
+				return *this;
+			}
+			~token() { release(); }
+
+			void release() {
+				if(watcher) watcher->unwatch(id);
+				watcher = nullptr;
+			}
+		};
+
+		file_watcher();
+		file_watcher(const file_watcher&) = delete;
+		file_watcher& operator=(const file_watcher&) = delete;
+		~file_watcher();
+
+		static file_watcher& get_default();
+
+		// NOTE: on_change is invoked from whichever thread calls poll
+		token watch(const std::filesystem::path& file, callback_t on_change);
+		void unwatch(size_t id);
+
+		// Remaps every changed file in the file cache and then invokes its callbacks, returns how many files changed
+		size_t poll();
+		// Polls every time the context updates
+		// NOTE: Contexts are forgotten (and their update hook dropped) once they are destroyed
+		file_watcher& poll_on_update(struct context& ctx);
+		// Disconnects the update hook installed by poll_on_update
+		file_watcher& stop_polling_on_update(struct context& ctx);
+
+	protected:
+		struct watched {
+			std::filesystem::path file;
+			callback_t on_change;
+			std::filesystem::file_time_type last_write;
+		};
+		std::unordered_map<size_t, watched> watches;
+		size_t next_id = 1;
+		struct polled_context {
+			std::weak_ptr<const void> lifetime; // Expires with the context (even if it has been moved)
+			connection hook;
+		};
+		std::vector<polled_context> polled_contexts;
+		std::mutex mutex;
+
+#ifdef __linux__
+		int inotify = -1;
+		std::unordered_map<int, std::filesystem::path> directories;
+		std::unordered_map<std::filesystem::path, std::pair<int, size_t>> directory_watches; // Directory -> (watch descriptor, number of files watched in it)
+#endif
+	};
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+namespace stylizer {
+
+	// 64-bit content hash (the XXH64 algorithm), fast enough to run over every loaded file
+	// NOTE: Not cryptographic, only meant to detect identical content
+	inline uint64_t content_hash(std::span<const std::byte> data, uint64_t seed = 0) {
+		constexpr uint64_t prime1 = 0x9E3779B185EBCA87ull, prime2 = 0xC2B2AE3D27D4EB4Full, prime3 = 0x165667B19E3779F9ull,
+			prime4 = 0x85EBCA77C2B2AE63ull, prime5 = 0x27D4EB2F165667C5ull;
+
+		auto read64 = [](const std::byte* at) { uint64_t out; std::memcpy(&out, at, sizeof(out)); return out; };
+		auto read32 = [](const std::byte* at) { uint32_t out; std::memcpy(&out, at, sizeof(out)); return out; };
+		auto round = [](uint64_t accumulator, uint64_t input) {
+			return std::rotl(accumulator + input * prime2, 31) * prime1;
+		};
+		auto merge = [&](uint64_t accumulator, uint64_t value) {
+			return (accumulator ^ round(0, value)) * prime1 + prime4;
+		};
+
+		auto at = data.data(), end = data.data() + data.size();
+		uint64_t hash;
+		if(data.size() >= 32) {
+			uint64_t v1 = seed + prime1 + prime2, v2 = seed + prime2, v3 = seed, v4 = seed - prime1;
+			for(; at + 32 <= end; at += 32) {
+				v1 = round(v1, read64(at));
+				v2 = round(v2, read64(at + 8));
+				v3 = round(v3, read64(at + 16));
+				v4 = round(v4, read64(at + 24));
+			}
+			hash = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) + std::rotl(v4, 18);
+			hash = merge(merge(merge(merge(hash, v1), v2), v3), v4);
+		} else hash = seed + prime5;
+		hash += data.size();
+
+		for(; at + 8 <= end; at += 8)
+			hash = std::rotl(hash ^ round(0, read64(at)), 27) * prime1 + prime4;
+		if(at + 4 <= end) {
+			hash = std::rotl(hash ^ (read32(at) * prime1), 23) * prime2 + prime3;
+			at += 4;
+		}
+		for(; at < end; ++at)
+			hash = std::rotl(hash ^ (uint64_t(*at) * prime5), 11) * prime1;
+
+		hash ^= hash >> 33;
+		hash *= prime2;
+		hash ^= hash >> 29;
+		hash *= prime3;
+		hash ^= hash >> 32;
+		return hash;
+	}
+
+	// Mixes another value into an existing hash (for keys made up of a content hash and some options)
+	inline uint64_t hash_combine(uint64_t hash, uint64_t value) {
+		return hash ^ (value + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2));
+	}
+}
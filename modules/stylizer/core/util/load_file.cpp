@@ -1,22 +1,254 @@
 #include "load_file.hpp"
+#include "access_trace.hpp"
+#include "asset_pack.hpp"
+#include "asset_telemetry.hpp"
+#include "thread_pool.hpp"
 #include "../api.hpp"
 #include <filesystem>
 
-std::unordered_map<std::filesystem::path, mio::mmap_source>& stylizer::get_loaded_files() {
-	static std::unordered_map<std::filesystem::path, mio::mmap_source> loaded_files;
-	return loaded_files;
-}
+#if defined(__unix__) || defined(__APPLE__)
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace stylizer {
+
+	file_cache::handle file_cache::acquire(const std::filesystem::path& file) {
+		{
+			std::scoped_lock lock(mutex);
+			if(auto found = lookup.find(file); found != lookup.end()) {
+				++stats.hits;
+				lru.splice(lru.begin(), lru, found->second);
+				return {found->second->mapping};
+			}
+			++stats.misses;
+		}
+
+		// NOTE: Mapping happens outside the lock so that concurrent misses don't serialize on the syscalls
+		std::error_code ec;
+		auto mapping = std::make_shared<mio::mmap_source>(mio::make_mmap_source(file.string(), ec));
+		if(ec) {
+			get_error_handler()(stylizer::error_severity::Error, ec.message(), 0);
+			return {};
+		}
 
-std::span<std::byte> stylizer::load_file(const std::filesystem::path& f) {
-	auto file = std::filesystem::canonical(std::filesystem::absolute(f));
+		std::scoped_lock lock(mutex);
+		if(auto found = lookup.find(file); found != lookup.end()) // Someone else mapped it while we weren't looking
+			return {found->second->mapping};
+
+		stats.mapped_bytes += mapping->mapped_length();
+		++stats.mapped_files;
+		lru.push_front({file, mapping});
+		lookup[file] = lru.begin();
+		if(mapping->size() > 0)
+			by_address[(const std::byte*)mapping->data()] = lru.begin();
+
+		handle out{std::move(mapping)}; // Make sure the new mapping is referenced so it can't be evicted
+		trim_locked();
+		return out;
+	}
 
-	if(get_loaded_files().contains(file)) {
-		auto& mmap = get_loaded_files()[file];
-		return {(std::byte*)mmap.data(), mmap.size()};
+	std::list<file_cache::entry>::iterator file_cache::find_containing_locked(std::span<const std::byte> memory) {
+		// The last mapping starting at or before memory is the only one which can contain it
+		auto found = by_address.upper_bound(memory.data());
+		if(found == by_address.begin()) return lru.end();
+		auto& entry = *(--found)->second;
+		auto begin = (const std::byte*)entry.mapping->data(), end = begin + entry.mapping->size();
+		if(memory.data() + memory.size() <= end)
+			return found->second;
+		return lru.end();
 	}
 
-	std::error_code ec;
-	auto& mmap = get_loaded_files()[file] = mio::make_mmap_source(file.string(), ec);
-	if(ec) get_error_handler()(stylizer::error_severity::Error, ec.message(), 0);
-	return {(std::byte*)mmap.data(), mmap.size()};
-}
\ No newline at end of file
+	file_cache::handle file_cache::pin(std::span<const std::byte> memory) {
+		std::scoped_lock lock(mutex);
+		if(auto found = find_containing_locked(memory); found != lru.end())
+			return {found->mapping, {(std::byte*)memory.data(), memory.size()}};
+		return {};
+	}
+
+	file_cache::handle file_cache::pin_private(std::span<const std::byte> memory) {
+		std::filesystem::path path;
+		size_t offset = 0;
+		{
+			std::scoped_lock lock(mutex);
+			if(auto found = find_containing_locked(memory); found != lru.end()) {
+				path = found->path;
+				offset = memory.data() - (const std::byte*)found->mapping->data();
+			}
+		}
+		if(path.empty()) return {};
+
+#if defined(__unix__) || defined(__APPLE__)
+		// NOTE: Mapping the file again shares its pages with the cached mapping until they are written to
+		if(int descriptor = ::open(path.c_str(), O_RDONLY); descriptor >= 0) {
+			struct stat status;
+			size_t size = offset + memory.size();
+			void* base = MAP_FAILED;
+			if(fstat(descriptor, &status) == 0 && size_t(status.st_size) >= size && size > 0) // The file may have shrunk since it was cached
+				base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, descriptor, 0);
+			close(descriptor);
+			if(base != MAP_FAILED)
+				return {std::shared_ptr<void>(base, [size](void* base) { munmap(base, size); }), {(std::byte*)base + offset, memory.size()}};
+		}
+#endif
+		auto copy = std::make_shared<std::vector<std::byte>>(memory.begin(), memory.end());
+		return {copy, *copy};
+	}
+
+	file_cache& file_cache::set_budget(const budget& budget) {
+		std::scoped_lock lock(mutex);
+		limits = budget;
+		trim_locked();
+		return *this;
+	}
+
+	void file_cache::record_decompression(size_t compressed_bytes, size_t decompressed_bytes, double seconds) {
+		std::scoped_lock lock(mutex);
+		stats.compressed_bytes += compressed_bytes;
+		stats.decompressed_bytes += decompressed_bytes;
+		stats.decompression_seconds += seconds;
+	}
+
+	bool file_cache::invalidate(const std::filesystem::path& file) {
+		std::scoped_lock lock(mutex);
+		auto found = lookup.find(file);
+		if(found == lookup.end()) return false;
+
+		erase(found->second);
+		return true;
+	}
+
+	bool file_cache::evict(const std::filesystem::path& file) {
+		std::scoped_lock lock(mutex);
+		auto found = lookup.find(file);
+		if(found == lookup.end() || found->second->referenced()) return false;
+
+		erase(found->second);
+		return true;
+	}
+
+	file_cache& file_cache::trim() {
+		std::scoped_lock lock(mutex);
+		trim_locked();
+		return *this;
+	}
+
+	void file_cache::trim_locked() {
+		auto it = lru.end();
+		while(it != lru.begin() && (stats.mapped_bytes > limits.max_bytes || stats.mapped_files > limits.max_entries)) {
+			--it;
+			if(it->referenced()) continue;
+			erase(it++);
+		}
+	}
+
+	file_cache& file_cache::clear() {
+		std::scoped_lock lock(mutex);
+		for(auto it = lru.begin(); it != lru.end(); )
+			if(it->referenced()) ++it;
+			else erase(it++);
+		return *this;
+	}
+
+	void file_cache::erase(std::list<entry>::iterator it) {
+		stats.mapped_bytes -= it->mapping->mapped_length();
+		--stats.mapped_files;
+		++stats.evictions;
+		lookup.erase(it->path);
+		if(auto found = by_address.find((const std::byte*)it->mapping->data()); found != by_address.end() && found->second == it)
+			by_address.erase(found);
+		lru.erase(it);
+	}
+
+	static thread_local std::filesystem::path load_path;
+
+	const std::filesystem::path& current_load_path() { return load_path; }
+	current_load_path_scope::current_load_path_scope(std::filesystem::path path) : previous(std::exchange(load_path, std::move(path))) {}
+	current_load_path_scope::~current_load_path_scope() { load_path = std::move(previous); }
+
+	file_cache& get_file_cache() {
+		static file_cache cache;
+		return cache;
+	}
+
+	void advise(std::span<const std::byte> memory, access_hint hint) {
+#if defined(__unix__) || defined(__APPLE__)
+		if(memory.empty()) return;
+
+		int advice = MADV_NORMAL;
+		switch(hint) {
+		case access_hint::Normal: advice = MADV_NORMAL; break;
+		case access_hint::Sequential: advice = MADV_SEQUENTIAL; break;
+		case access_hint::Random: advice = MADV_RANDOM; break;
+		case access_hint::WillNeed: advice = MADV_WILLNEED; break;
+		case access_hint::DontNeed: advice = MADV_DONTNEED; break;
+		}
+
+		// madvise requires a page aligned start address
+		static const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+		auto begin = (uintptr_t)memory.data() & ~(page_size - 1);
+		auto end = (uintptr_t)(memory.data() + memory.size());
+		madvise((void*)begin, end - begin, advice);
+#endif
+	}
+
+	file_cache::handle load_file_handle(const std::filesystem::path& f, thread_pool& pool /* = thread_pool::get_default() */) {
+		asset_telemetry::scope measure(asset_telemetry::phase::Map, f);
+		auto packed = find_in_mounted_asset_packs(f, pool);
+		auto out = packed ? std::move(*packed) : get_file_cache().acquire(std::filesystem::canonical(std::filesystem::absolute(f)));
+		if(auto& trace = get_access_trace(); trace.recording() && out)
+			trace.record(f, out.span().size());
+		get_asset_telemetry().record_mapped(out.span());
+		return out;
+	}
+
+	std::span<std::byte> load_file(const std::filesystem::path& f) {
+		return load_file_handle(f).span();
+	}
+
+	static file_cache::handle load_file_and_read_ahead(const std::filesystem::path& file) {
+		asset_telemetry::scope measure(asset_telemetry::phase::Map, file);
+		file_cache::handle out;
+		if(auto packed = find_in_mounted_asset_packs(file); packed)
+			out = std::move(*packed);
+		else {
+			std::error_code ec;
+			auto canonical = std::filesystem::canonical(std::filesystem::absolute(file), ec);
+			if(ec) {
+				get_error_handler()(stylizer::error_severity::Error, ec.message(), 0);
+				return {};
+			}
+			out = get_file_cache().acquire(canonical);
+		}
+
+		advise(out.span(), access_hint::WillNeed);
+		if(auto& trace = get_access_trace(); trace.recording() && out)
+			trace.record(file, out.span().size());
+		get_asset_telemetry().record_mapped(out.span());
+		return out;
+	}
+
+	std::vector<std::future<file_cache::handle>> load_files_async(std::span<const std::filesystem::path> files) {
+		std::vector<std::future<file_cache::handle>> out;
+		out.reserve(files.size());
+		for(auto& file: files)
+			out.emplace_back(thread_pool::get_default().submit([file] {
+				return load_file_and_read_ahead(file);
+			}));
+		return out;
+	}
+
+	void load_files_async(std::span<const std::filesystem::path> files, std::function<void(const std::filesystem::path&, file_cache::handle)> on_complete) {
+		auto shared_on_complete = std::make_shared<decltype(on_complete)>(std::move(on_complete));
+		for(auto& file: files)
+			thread_pool::get_default().enqueue([file, shared_on_complete] {
+				file_cache::handle handle;
+				try {
+					handle = load_file_and_read_ahead(file);
+				} catch(...) {} // The error handler may throw, the failure has already been reported by then
+				(*shared_on_complete)(file, std::move(handle));
+			});
+	}
+}
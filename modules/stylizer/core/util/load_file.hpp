@@ -1,22 +1,149 @@
 #pragma once
 
+#include <concepts>
 #include <cstddef>
 #include <filesystem>
+#include <functional>
+#include <future>
+#include <limits>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <span>
+#include <vector>
 #include "../thirdparty/mio.hpp"
+#include "thread_pool.hpp"
 
 namespace stylizer {
-	std::unordered_map<std::filesystem::path, mio::mmap_source>& get_loaded_files();
+
+	struct file_cache {
+		// A handle keeps its mapping alive (and out of the eviction queue) for as long as it exists
+		struct handle {
+			std::shared_ptr<const void> owner; // Usually the file's mapping, but decompressed pack entries own their own buffer
+			std::span<std::byte> view; // The part of the owned memory this handle refers to (files inside asset packs share a mapping)
+
+			handle() = default;
+			handle(std::shared_ptr<mio::mmap_source> mapping) : owner(mapping) {
+				if(mapping) view = {(std::byte*)mapping->data(), mapping->size()};
+			}
+			handle(std::shared_ptr<const void> owner, std::span<std::byte> view) : owner(std::move(owner)), view(view) {}
+
+			std::span<std::byte> span() const { return view; }
+			operator std::span<std::byte>() const { return span(); }
+			explicit operator bool() const { return owner != nullptr; }
+		};
+
+		struct budget {
+			size_t max_bytes = std::numeric_limits<size_t>::max();
+			size_t max_entries = std::numeric_limits<size_t>::max();
+		};
+
+		struct statistics {
+			size_t hits = 0, misses = 0, evictions = 0;
+			size_t mapped_bytes = 0, mapped_files = 0;
+
+			// Compressed asset pack entries
+			size_t compressed_bytes = 0, decompressed_bytes = 0;
+			double decompression_seconds = 0;
+			double decompression_throughput() const { return decompression_seconds > 0 ? decompressed_bytes / decompression_seconds : 0; } // Bytes per second
+		};
+
+		handle acquire(const std::filesystem::path& file);
+		// Returns a handle to whichever cached mapping contains memory (or an empty handle if none does)
+		// NOTE: Lets loaders which are only handed a span keep views into the file alive
+		handle pin(std::span<const std::byte> memory);
+		// Like pin, but the view is of a private copy-on-write mapping of the file, so writing to it touches neither the file nor anyone else's view
+		// NOTE: Falls back to a copy of memory where private mappings aren't supported, returns an empty handle if memory isn't part of a cached mapping
+		handle pin_private(std::span<const std::byte> memory);
+
+		file_cache& set_budget(const budget& budget);
+		budget get_budget() const {
+			std::scoped_lock lock(mutex);
+			return limits;
+		}
+		statistics get_statistics() const {
+			std::scoped_lock lock(mutex);
+			return stats;
+		}
+
+		void record_decompression(size_t compressed_bytes, size_t decompressed_bytes, double seconds);
+
+		// Forgets the file's mapping so that the next load maps it again, existing handles keep the old contents alive
+		bool invalidate(const std::filesystem::path& file);
+		// Unmaps the file unless a handle to it is still alive
+		bool evict(const std::filesystem::path& file);
+		// Evicts unreferenced mappings (least recently used first) until the cache fits its budget
+		file_cache& trim();
+		file_cache& clear();
+
+	protected:
+		struct entry {
+			std::filesystem::path path;
+			std::shared_ptr<mio::mmap_source> mapping;
+
+			bool referenced() const { return mapping.use_count() > 1; }
+		};
+
+		// Front is the most recently used
+		std::list<entry> lru;
+		std::unordered_map<std::filesystem::path, std::list<entry>::iterator> lookup;
+		std::map<const std::byte*, std::list<entry>::iterator> by_address; // Keyed on where each (non-empty) mapping starts, so pinning doesn't walk the whole cache
+		budget limits;
+		statistics stats;
+		mutable std::mutex mutex;
+
+		void erase(std::list<entry>::iterator it);
+		void trim_locked();
+		// The entry whose mapping contains memory, or lru.end()
+		std::list<entry>::iterator find_containing_locked(std::span<const std::byte> memory);
+	};
+
+	file_cache& get_file_cache();
+
+	enum class access_hint {
+		Normal,
+		Sequential,
+		Random,
+		WillNeed,
+		DontNeed,
+	};
+	// Forwards the hint to the kernel (madvise) where supported, otherwise does nothing
+	void advise(std::span<const std::byte> memory, access_hint hint);
+
+	// NOTE: Files in compressed asset packs are decompressed on pool
+	file_cache::handle load_file_handle(const std::filesystem::path& file, thread_pool& pool = thread_pool::get_default());
+	// NOTE: The returned span is only valid until the file is evicted, prefer load_file_handle if the cache has a budget
 	std::span<std::byte> load_file(const std::filesystem::path& file);
 
+	// Canonicalizes, maps and starts reading ahead each file on the default thread pool
+	std::vector<std::future<file_cache::handle>> load_files_async(std::span<const std::filesystem::path> files);
+	// NOTE: on_complete is invoked from the worker threads
+	void load_files_async(std::span<const std::filesystem::path> files, std::function<void(const std::filesystem::path&, file_cache::handle)> on_complete);
+
+	// The file whose bytes load_file is currently handing to a loader on this thread (empty if the loader was handed memory some other way)
+	// NOTE: Lets loaders which are only handed a span resolve paths stored in the file relative to it
+	const std::filesystem::path& current_load_path();
+	struct current_load_path_scope {
+		std::filesystem::path previous;
+		current_load_path_scope(std::filesystem::path path);
+		current_load_path_scope(const current_load_path_scope&) = delete;
+		~current_load_path_scope();
+	};
+
 	template<typename Tfunc>
 	auto load_file(const std::filesystem::path& file, const Tfunc& func) {
-		return func(load_file(file), file.extension().string());
+		auto handle = load_file_handle(file);
+		current_load_path_scope scope(file);
+		return func(handle.span(), file.extension().string());
 	}
 
-	template<typename Tfunc>
-	auto load_file(struct context& ctx, const std::filesystem::path& file, const Tfunc& func) {
-		return func(ctx, load_file(file), file.extension().string());
+	// NOTE: Templated on the context so that this header doesn't need its definition
+	template<typename Tfunc, std::derived_from<struct context> Tcontext>
+	auto load_file(Tcontext& ctx, const std::filesystem::path& file, const Tfunc& func) {
+		auto handle = load_file_handle(file, ctx.jobs());
+		current_load_path_scope scope(file);
+		return func(ctx, handle.span(), file.extension().string());
 	}
-}
\ No newline at end of file
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "maybe_owned.hpp"
+
+#include <stylizer/api/api.hpp>
+
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace stylizer {
+	struct context;
+
+	// Maps file extensions to the functions which load them
+	// NOTE: Thread safe, lookups only take a shared lock so any number of threads can load at once
+	template<typename T>
+	struct loader_registry {
+		using loader = std::function<maybe_owned<T>(context&, std::span<std::byte>, std::string_view)>;
+
+		loader_registry() = default;
+		loader_registry(std::initializer_list<std::pair<const std::string, loader>> loaders) : loaders(loaders.begin(), loaders.end()) {}
+
+		// Replaces any loader already registered for the extension
+		loader_registry& add(std::string_view extension, loader loader) {
+			std::unique_lock lock(mutex);
+			loaders.insert_or_assign(std::string(extension), std::move(loader));
+			return *this;
+		}
+		bool remove(std::string_view extension) {
+			std::unique_lock lock(mutex);
+			if(auto found = loaders.find(extension); found != loaders.end()) {
+				loaders.erase(found);
+				return true;
+			}
+			return false;
+		}
+
+		// NOTE: Returns a copy so that the loader stays valid even if it is replaced while running
+		loader find(std::string_view extension) const {
+			std::shared_lock lock(mutex);
+			if(auto found = loaders.find(extension); found != loaders.end())
+				return found->second;
+			return {};
+		}
+		bool contains(std::string_view extension) const {
+			std::shared_lock lock(mutex);
+			return loaders.find(extension) != loaders.end();
+		}
+		std::vector<std::string> extensions() const {
+			std::shared_lock lock(mutex);
+			std::vector<std::string> out;
+			for(auto& [extension, loader]: loaders)
+				out.push_back(extension);
+			return out;
+		}
+
+		// Loads memory with whichever loader is registered for extension (reporting an error if there is none)
+		maybe_owned<T> operator()(context& ctx, std::span<std::byte> memory, std::string_view extension) const {
+			auto loader = find(extension);
+			if(!loader) {
+				get_error_handler()(stylizer::error_severity::Error, "No loader is registered for `" + std::string(extension) + "` files!", 0);
+				return {};
+			}
+			return loader(ctx, memory, extension);
+		}
+
+	protected:
+		struct string_hash {
+			using is_transparent = void;
+			size_t operator()(std::string_view string) const { return std::hash<std::string_view>{}(string); }
+		};
+
+		mutable std::shared_mutex mutex;
+		std::unordered_map<std::string, loader, string_hash, std::equal_to<>> loaders;
+	};
+}
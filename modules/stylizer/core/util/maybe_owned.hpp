@@ -27,7 +27,7 @@ namespace stylizer {
 		maybe_owned(T&& moved) requires(requires(T a) { {new T(a)}; }) : value(new T(std::move(moved))), owned(true) {}
 		maybe_owned(T* ptr, bool owned = false) : value(ptr), owned(owned) {}
 		maybe_owned(const maybe_owned& o) requires(requires (T a, T b) { {a = b}; }) { *this = o; }
-		maybe_owned(maybe_owned&& o)  { *this = std::move(o); }
+		maybe_owned(maybe_owned&& o) noexcept { *this = std::move(o); } // NOTE: noexcept so that vectors move (rather than copy) when they grow
 		maybe_owned& operator=(const maybe_owned& o) requires(requires (T a, T b) { {a = b}; }) {
 			if(owned) release();
 			if(o.owned)	{
@@ -41,7 +41,7 @@ namespace stylizer {
 			}
 			return *this;
 		}
-		maybe_owned& operator=(maybe_owned&& o) {
+		maybe_owned& operator=(maybe_owned&& o) noexcept {
 			if(owned) release();
 			value = std::exchange(o.value, nullptr);
 			owned = std::exchange(o.owned, false);
@@ -0,0 +1,120 @@
+#include "shared_asset_cache.hpp"
+#include "hash.hpp"
+
+#include <stylizer/api/api.hpp>
+
+#include <charconv>
+#include <fstream>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+	#include <unistd.h>
+#endif
+
+namespace stylizer {
+
+	shared_asset_cache::shared_asset_cache(std::filesystem::path directory /* = default_directory() */) : directory(std::move(directory)) {
+		std::error_code ec;
+		std::filesystem::create_directories(this->directory, ec);
+		if(ec) get_error_handler()(stylizer::error_severity::Warning, "Failed to create the shared asset cache at `" + this->directory.string() + "`: " + ec.message(), 0);
+	}
+
+	std::filesystem::path shared_asset_cache::default_directory() {
+		std::error_code ec;
+		if(std::filesystem::is_directory("/dev/shm", ec))
+			return "/dev/shm/stylizer-assets";
+		return std::filesystem::temp_directory_path() / "stylizer-assets";
+	}
+
+	uint64_t shared_asset_cache::make_key(std::span<const std::byte> source, std::string_view kind, uint64_t version) {
+		return hash_combine(hash_combine(content_hash(source), content_hash(std::as_bytes(std::span(kind)))), version);
+	}
+
+	std::filesystem::path shared_asset_cache::entry_path(uint64_t key) const {
+		char name[17];
+		auto end = std::to_chars(name, name + sizeof(name), key, 16).ptr;
+		return directory / (std::string(name, end) + ".asset");
+	}
+
+	file_cache::handle shared_asset_cache::find(uint64_t key) const {
+		auto path = entry_path(key);
+		std::error_code ec;
+		if(!std::filesystem::is_regular_file(path, ec)) return {};
+
+		// NOTE: Mapped through the file cache so that every load in this process shares one mapping
+		try {
+			return get_file_cache().acquire(path);
+		} catch(...) { return {}; } // Removed by another process since we checked, treat it as a miss
+	}
+
+	file_cache::handle shared_asset_cache::publish(uint64_t key, std::span<const std::byte> blob) {
+		if(blob.empty()) return {}; // Empty files can't be mapped
+		if(auto existing = find(key)) return existing; // Someone else got there first
+
+		auto path = entry_path(key);
+		auto temporary = path;
+#if defined(__unix__) || defined(__APPLE__)
+		temporary += "." + std::to_string(getpid());
+#endif
+		temporary += "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+
+		{
+			std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+			out.write((const char*)blob.data(), blob.size());
+			if(!out) {
+				get_error_handler()(stylizer::error_severity::Warning, "Failed to publish `" + path.string() + "` to the shared asset cache!", 0);
+				out.close();
+				std::error_code ec;
+				std::filesystem::remove(temporary, ec);
+				return {};
+			}
+		}
+
+		// NOTE: If another process published the same entry meanwhile this replaces it with identical bytes, mappings of theirs stay valid
+		std::error_code ec;
+		std::filesystem::rename(temporary, path, ec);
+		if(ec) {
+			std::filesystem::remove(temporary, ec);
+			return {};
+		}
+		return find(key);
+	}
+
+	bool shared_asset_cache::remove(uint64_t key) {
+		auto path = entry_path(key);
+		get_file_cache().invalidate(path);
+		std::error_code ec;
+		return std::filesystem::remove(path, ec);
+	}
+
+	size_t shared_asset_cache::clear() {
+		size_t removed = 0;
+		std::error_code ec;
+		for(auto& entry: std::filesystem::directory_iterator(directory, ec)) {
+			if(entry.path().extension() != ".asset") continue;
+			get_file_cache().invalidate(entry.path());
+			if(std::filesystem::remove(entry.path(), ec)) ++removed;
+		}
+		return removed;
+	}
+
+	static std::mutex shared_asset_cache_mutex;
+	static std::shared_ptr<shared_asset_cache> enabled_shared_asset_cache;
+
+	shared_asset_cache& enable_shared_asset_cache(std::filesystem::path directory /* = shared_asset_cache::default_directory() */) {
+		auto cache = std::make_shared<shared_asset_cache>(std::move(directory));
+		std::scoped_lock lock(shared_asset_cache_mutex);
+		enabled_shared_asset_cache = cache;
+		return *cache;
+	}
+
+	void disable_shared_asset_cache() {
+		std::scoped_lock lock(shared_asset_cache_mutex);
+		enabled_shared_asset_cache = nullptr;
+	}
+
+	std::shared_ptr<shared_asset_cache> get_shared_asset_cache() {
+		std::scoped_lock lock(shared_asset_cache_mutex);
+		return enabled_shared_asset_cache;
+	}
+}
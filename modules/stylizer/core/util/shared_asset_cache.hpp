@@ -0,0 +1,43 @@
+#pragma once
+
+#include "load_file.hpp"
+
+#include <string_view>
+
+namespace stylizer {
+
+	// Decoded assets shared between every process on the host (eg several headless render workers)
+	// Each entry is a file in a shared memory directory (/dev/shm where available), published once and then mapped read only by everyone who looks it up,
+	// so the pages are only held in memory once no matter how many processes use them
+	// NOTE: Entries are never evicted automatically, call clear when the cache is no longer needed (tmpfs counts against RAM)
+	struct shared_asset_cache {
+		shared_asset_cache(std::filesystem::path directory = default_directory());
+
+		static std::filesystem::path default_directory();
+		const std::filesystem::path& get_directory() const { return directory; }
+
+		// Derives an entry's key from the source file's bytes, what it was decoded into, and the version of that format
+		static uint64_t make_key(std::span<const std::byte> source, std::string_view kind, uint64_t version);
+
+		// Returns a (read only) mapping of the entry, or an empty handle if it hasn't been published yet
+		file_cache::handle find(uint64_t key) const;
+		// Writes blob as the entry for key and returns a mapping of it (or an empty handle if writing failed)
+		// NOTE: Entries are written to a temporary file and renamed into place, so other processes never see a partial entry
+		file_cache::handle publish(uint64_t key, std::span<const std::byte> blob);
+
+		bool remove(uint64_t key);
+		// Returns how many entries were removed, processes which still map them keep their contents alive
+		size_t clear();
+
+	protected:
+		std::filesystem::path directory;
+
+		std::filesystem::path entry_path(uint64_t key) const;
+	};
+
+	// The image and model decoders only consult the shared cache while it is enabled
+	shared_asset_cache& enable_shared_asset_cache(std::filesystem::path directory = shared_asset_cache::default_directory());
+	void disable_shared_asset_cache();
+	// NOTE: Shared so that disabling the cache doesn't pull it out from under loads which are in flight
+	std::shared_ptr<shared_asset_cache> get_shared_asset_cache();
+}
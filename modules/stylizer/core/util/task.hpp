@@ -0,0 +1,159 @@
+#pragma once
+
+#include "../api.hpp"
+#include "load_file.hpp"
+#include "thread_pool.hpp"
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <string>
+
+namespace stylizer {
+
+	// Lazily started coroutine, it only runs once it is awaited (or detached)
+	// Eg:
+	//   stylizer::task<> stream_level(stylizer::context& ctx) {
+	//     auto image = co_await stylizer::load_async<stylizer::image>(ctx, "albedo.png"); // Read and decoded on the pool, resumes on the context's owner
+	//     auto texture = image->upload(ctx);
+	//     co_await ctx.next_frame();
+	//     ...
+	//   }
+	//   stream_level(ctx).detach(); // Progresses as the owner calls ctx.update()
+	template<typename T = void>
+	struct task {
+		struct promise_type;
+		using handle_t = std::coroutine_handle<promise_type>;
+
+		struct promise_base {
+			std::coroutine_handle<> continuation = {};
+			std::exception_ptr exception = {};
+			bool detached = false;
+
+			std::suspend_always initial_suspend() noexcept { return {}; }
+			auto final_suspend() noexcept {
+				struct awaiter {
+					bool await_ready() noexcept { return false; }
+					std::coroutine_handle<> await_suspend(handle_t handle) noexcept {
+						auto& promise = handle.promise();
+						if(promise.continuation) return promise.continuation;
+						if(promise.detached) handle.destroy(); // Nobody is left to clean up after a detached task
+						return std::noop_coroutine();
+					}
+					void await_resume() noexcept {}
+				};
+				return awaiter{};
+			}
+
+			void unhandled_exception() {
+				if(!detached) {
+					exception = std::current_exception();
+					return;
+				}
+				// Nobody is awaiting a detached task, so report its failure instead
+				std::string message = "Detached task failed with an unknown exception!";
+				try { throw; }
+				catch(const std::exception& e) { message = e.what(); }
+				catch(...) {}
+				try {
+					get_error_handler()(stylizer::error_severity::Error, message, 0);
+				} catch(...) {} // The error handler may throw, which would escape whoever resumed the task
+			}
+		};
+
+		template<typename Tresult>
+		struct promise_result : public promise_base {
+			std::optional<Tresult> result;
+			template<typename Tvalue>
+			void return_value(Tvalue&& value) { result.emplace(std::forward<Tvalue>(value)); }
+			Tresult take() { return std::move(*result); }
+		};
+		template<std::same_as<void> Tresult>
+		struct promise_result<Tresult> : public promise_base {
+			void return_void() {}
+			void take() {}
+		};
+
+		struct promise_type : public promise_result<T> {
+			task get_return_object() { return task{handle_t::from_promise(*this)}; }
+		};
+
+		task() = default;
+		explicit task(handle_t handle) : handle(handle) {}
+		task(const task&) = delete;
+		task(task&& o) : handle(std::exchange(o.handle, {})) {}
+		task& operator=(const task&) = delete;
+		task& operator=(task&& o) {
+			if(handle) handle.destroy();
+			handle = std::exchange(o.handle, {});
+			return *this;
+		}
+		~task() { if(handle) handle.destroy(); }
+
+		bool done() const { return !handle || handle.done(); }
+
+		auto operator co_await() && {
+			struct awaiter {
+				handle_t handle;
+				bool await_ready() { return !handle || handle.done(); }
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) {
+					handle.promise().continuation = awaiting;
+					return handle; // Symmetric transfer, starts the task
+				}
+				T await_resume() {
+					if(handle.promise().exception) std::rethrow_exception(handle.promise().exception);
+					return handle.promise().take();
+				}
+			};
+			return awaiter{handle};
+		}
+
+		// Starts the task and lets it run to completion on its own
+		void detach() {
+			if(!handle) return;
+			auto started = std::exchange(handle, {});
+			started.promise().detached = true;
+			started.resume();
+		}
+
+	protected:
+		handle_t handle = {};
+	};
+
+	// Awaitable which continues the awaiting coroutine on one of the pool's threads
+	// NOTE: Continues inline if the pool has no threads
+	inline auto resume_on(thread_pool& pool) {
+		struct awaiter {
+			thread_pool& pool;
+			bool await_ready() { return pool.size() == 0; }
+			void await_suspend(std::coroutine_handle<> handle) { pool.enqueue([handle] { handle.resume(); }); }
+			void await_resume() {}
+		};
+		return awaiter{pool};
+	}
+
+	// Reads and decodes the file on the pool (with T's registered loaders), then resumes on the context's owner where it is safe to upload the result
+	// NOTE: T is anything with a static load(context&, path), eg stylizer::image or stylizer::model
+	template<typename T>
+	task<maybe_owned<T>> load_async(context& ctx, std::filesystem::path file, thread_pool& pool) {
+		co_await resume_on(pool);
+		std::optional<maybe_owned<T>> loaded;
+		std::exception_ptr exception;
+		try {
+			loaded.emplace(T::load(ctx, file));
+		} catch(...) {
+			exception = std::current_exception();
+		}
+
+		// NOTE: Errors are rethrown on the owner thread, pool threads have nowhere to report them
+		co_await ctx.resume_on_owner();
+		if(exception) std::rethrow_exception(exception);
+		co_return std::move(*loaded);
+	}
+
+	// Decodes on the context's jobs
+	template<typename T>
+	task<maybe_owned<T>> load_async(context& ctx, std::filesystem::path file) {
+		return load_async<T>(ctx, std::move(file), ctx.jobs());
+	}
+}
@@ -0,0 +1,223 @@
+#include "thread_pool.hpp"
+
+#include <stylizer/api/api.hpp>
+
+namespace stylizer {
+
+	void* scratch_arena::allocate(size_t size, size_t alignment /* = alignof(std::max_align_t) */) {
+		while(true) {
+			if(current < blocks.size()) {
+				auto& block = blocks[current];
+				auto base = (uintptr_t)block.data.get();
+				size_t aligned = ((base + offset + alignment - 1) & ~uintptr_t(alignment - 1)) - base;
+				if(aligned + size <= block.size) {
+					offset = aligned + size;
+					return block.data.get() + aligned;
+				}
+				if(current + 1 < blocks.size()) { // Move on to the next (already allocated) block
+					++current;
+					offset = 0;
+					continue;
+				}
+			}
+
+			// Out of blocks, each new one is at least double the size of the last
+			size_t capacity = std::max<size_t>({size + alignment, 64 * 1024, blocks.empty() ? 0 : blocks.back().size * 2});
+			blocks.push_back({std::make_unique<std::byte[]>(capacity), capacity});
+			current = blocks.size() - 1;
+			offset = 0;
+		}
+	}
+
+	size_t scratch_arena::capacity() const {
+		size_t out = 0;
+		for(auto& block: blocks)
+			out += block.size;
+		return out;
+	}
+
+	void scratch_arena::trim() {
+		// Blocks past the current one are unused, as is the current one if nothing has been allocated from it
+		size_t first_unused = offset == 0 ? current : current + 1;
+		for(size_t held = capacity(); blocks.size() > first_unused && held > max_retained_bytes; blocks.pop_back())
+			held -= blocks.back().size;
+	}
+
+	// The pool (and queue) the current thread works for
+	static thread_local thread_pool* current_pool = nullptr;
+	static thread_local size_t current_worker = 0;
+
+	thread_pool::thread_pool(size_t threads /* = default_thread_count() */) {
+		for(size_t i = 0; i < threads; ++i)
+			queues.emplace_back(std::make_unique<queue>());
+
+		workers.reserve(threads);
+		for(size_t i = 0; i < threads; ++i)
+			workers.emplace_back([this, i] {
+				current_pool = this;
+				current_worker = i;
+				while(true) {
+					if(run_pending_job(i)) continue;
+
+					std::unique_lock lock(mutex);
+					wake.wait(lock, [this] { return stopping || pending > 0; });
+					if(stopping && pending == 0) return;
+				}
+			});
+	}
+
+	thread_pool::~thread_pool() {
+		{
+			std::scoped_lock lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for(auto& worker: workers)
+			worker.join();
+	}
+
+	thread_pool& thread_pool::get_default() {
+		static thread_pool pool;
+		return pool;
+	}
+
+	void thread_pool::enqueue(std::function<void()> job) {
+		if(workers.empty()) return job(); // Single threaded
+
+		// Jobs spawned by a worker stay on its queue (where they are likely to find their data in cache), others are spread round robin
+		size_t target = current_pool == this ? current_worker : next_queue++ % queues.size();
+		{
+			std::scoped_lock lock(queues[target]->mutex);
+			queues[target]->jobs.emplace_back(std::move(job));
+			++pending;
+		}
+		{ std::scoped_lock lock(mutex); } // Makes sure a worker deciding whether to sleep sees the new job
+		wake.notify_one();
+	}
+
+	bool thread_pool::run_pending_job() {
+		return run_pending_job(current_pool == this ? current_worker : next_queue++);
+	}
+
+	bool thread_pool::run_pending_job(size_t worker) {
+		if(queues.empty() || pending == 0) return false;
+
+		std::function<void()> job;
+		for(size_t i = 0; i < queues.size() && !job; ++i) {
+			auto& queue = *queues[(worker + i) % queues.size()];
+			std::scoped_lock lock(queue.mutex);
+			if(queue.jobs.empty()) continue;
+
+			if(i == 0 && current_pool == this) { // Our own queue, newest first
+				job = std::move(queue.jobs.back());
+				queue.jobs.pop_back();
+			} else { // Steal the oldest
+				job = std::move(queue.jobs.front());
+				queue.jobs.pop_front();
+			}
+			--pending;
+		}
+		if(!job) return false;
+
+		job();
+		return true;
+	}
+
+	std::function<bool()>& thread_pool::wait_hook() {
+		static thread_local std::function<bool()> hook;
+		return hook;
+	}
+
+	scratch_arena& thread_pool::scratch() {
+		static thread_local scratch_arena arena;
+		return arena;
+	}
+
+	job_graph::node job_graph::add(std::function<void()> job, std::initializer_list<node> dependencies /* = {} */) {
+		node out = entries.size();
+		entries.push_back({std::move(job)});
+		for(auto dependency: dependencies)
+			depend(out, dependency);
+		return out;
+	}
+
+	job_graph& job_graph::depend(node job, node dependency) {
+		entries[dependency].dependents.push_back(job);
+		++entries[job].dependency_count;
+		return *this;
+	}
+
+	void job_graph::run(thread_pool& pool /* = thread_pool::get_default() */) {
+		if(entries.empty()) return;
+
+		// Make sure every job can run (there are no cycles) before starting, otherwise waiting would never end
+		std::vector<size_t> remaining_dependencies(entries.size());
+		std::vector<node> ready;
+		for(node i = 0; i < entries.size(); ++i)
+			if((remaining_dependencies[i] = entries[i].dependency_count) == 0)
+				ready.push_back(i);
+		size_t reachable = 0;
+		for(size_t i = 0; i < ready.size(); ++i, ++reachable)
+			for(auto dependent: entries[ready[i]].dependents)
+				if(--remaining_dependencies[dependent] == 0)
+					ready.push_back(dependent);
+		if(reachable != entries.size()) {
+			get_error_handler()(stylizer::error_severity::Error, "Job graph has a dependency cycle!", 0);
+			return;
+		}
+
+		// NOTE: Shared with the jobs, the last one may still be notifying after the wait below sees everything done
+		struct state {
+			job_graph& graph;
+			thread_pool& pool;
+			std::unique_ptr<std::atomic<size_t>[]> remaining;
+			std::atomic<size_t> done = 0;
+			std::atomic<bool> failed = false;
+			std::exception_ptr exception;
+			std::mutex mutex;
+			std::condition_variable finished;
+
+			static void schedule(std::shared_ptr<state> shared, node n) {
+				auto& pool = shared->pool;
+				pool.enqueue([shared = std::move(shared), n] {
+					auto& entries = shared->graph.entries;
+					if(!shared->failed)
+						try {
+							entries[n].job();
+						} catch(...) {
+							std::scoped_lock lock(shared->mutex);
+							if(!shared->exception) shared->exception = std::current_exception();
+							shared->failed = true;
+						}
+
+					for(auto dependent: entries[n].dependents)
+						if(--shared->remaining[dependent] == 0)
+							schedule(shared, dependent);
+					// NOTE: The graph may be gone once done is incremented, so only shared is touched afterwards
+					if(size_t count = entries.size(); ++shared->done == count) {
+						std::scoped_lock lock(shared->mutex);
+						shared->finished.notify_all();
+					}
+				});
+			}
+		};
+		auto shared = std::make_shared<state>(*this, pool);
+		shared->remaining = std::make_unique<std::atomic<size_t>[]>(entries.size());
+		for(node i = 0; i < entries.size(); ++i)
+			shared->remaining[i] = entries[i].dependency_count;
+
+		for(node i = 0; i < entries.size(); ++i)
+			if(entries[i].dependency_count == 0)
+				state::schedule(shared, i);
+
+		// Help out until everything has finished
+		while(shared->done != entries.size())
+			if(!pool.help_while_waiting()) {
+				std::unique_lock lock(shared->mutex);
+				shared->finished.wait_for(lock, std::chrono::milliseconds(1), [&] { return shared->done == entries.size(); });
+			}
+
+		std::scoped_lock lock(shared->mutex);
+		if(shared->exception) std::rethrow_exception(shared->exception);
+	}
+}
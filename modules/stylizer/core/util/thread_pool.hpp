@@ -0,0 +1,197 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace stylizer {
+
+	// Bump allocator for temporaries inside of jobs, every thread has its own (see thread_pool::scratch)
+	// NOTE: Memory is reclaimed when the scope it was allocated in ends and kept around for the next allocation, up to max_retained_bytes
+	struct scratch_arena {
+		struct scope {
+			scratch_arena& arena;
+			size_t block, offset;
+			scope(scratch_arena& arena) : arena(arena), block(arena.current), offset(arena.offset) {}
+			scope(const scope&) = delete;
+			~scope() {
+				arena.rewind(block, offset);
+				arena.trim();
+			}
+		};
+
+		// Unused blocks past this are freed when a scope ends, so a single huge temporary doesn't stay pinned for the life of the thread
+		size_t max_retained_bytes = 64 * 1024 * 1024;
+
+		scratch_arena() = default;
+		scratch_arena(const scratch_arena&) = delete;
+		scratch_arena& operator=(const scratch_arena&) = delete;
+
+		void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+		// NOTE: The elements are left uninitialized
+		template<typename T>
+		std::span<T> allocate(size_t count) {
+			static_assert(std::is_trivially_destructible_v<T>, "Scratch memory is never destroyed");
+			return {(T*)allocate(count * sizeof(T), alignof(T)), count};
+		}
+
+		scope make_scope() { return {*this}; }
+		size_t capacity() const;
+		// Frees unused blocks (newest first) until no more than max_retained_bytes are held
+		void trim();
+
+	protected:
+		struct block {
+			std::unique_ptr<std::byte[]> data;
+			size_t size;
+		};
+		std::vector<block> blocks;
+		size_t current = 0, offset = 0;
+
+		void rewind(size_t block, size_t offset) {
+			current = block;
+			this->offset = offset;
+		}
+	};
+
+	// Work stealing pool: every worker has its own queue (worked through newest first) and steals the oldest jobs from the others once it runs dry
+	// NOTE: A pool without threads (eg in single threaded builds) runs every job inline on the calling thread
+	struct thread_pool {
+		thread_pool(size_t threads = default_thread_count());
+		thread_pool(const thread_pool&) = delete;
+		thread_pool& operator=(const thread_pool&) = delete;
+		~thread_pool();
+
+		static thread_pool& get_default();
+		static size_t default_thread_count() {
+#ifdef STYLIZER_SINGLE_THREADED
+			return 0;
+#else
+			return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+#endif
+		}
+
+		size_t size() const { return workers.size(); }
+
+		void enqueue(std::function<void()> job);
+
+		template<typename Tfunc>
+		auto submit(Tfunc&& func) -> std::future<std::invoke_result_t<Tfunc>> {
+			using result_t = std::invoke_result_t<Tfunc>;
+			// NOTE: std::function requires copyable callables, so the packaged task lives behind a shared pointer
+			auto task = std::make_shared<std::packaged_task<result_t()>>(std::forward<Tfunc>(func));
+			auto out = task->get_future();
+			enqueue([task]{ (*task)(); });
+			return out;
+		}
+
+		// Runs one queued job on the calling thread (returns false if there was none), lets threads which are waiting help out
+		bool run_pending_job();
+
+		// Called (on the calling thread) whenever one of the pool's blocking waits has no job to help with, returns whether it did any work
+		// NOTE: Per thread, contexts install one on their owner thread to keep running owner tasks, otherwise jobs waiting on the owner would deadlock
+		static std::function<bool()>& wait_hook();
+
+		// Runs func(i) for every i in [0, count) and waits for all of them to finish
+		// NOTE: The calling thread participates so this is safe to call from inside of a job
+		template<typename Tfunc>
+		void parallel_for(size_t count, const Tfunc& func) {
+			if(count == 0) return;
+
+			struct state {
+				std::atomic<size_t> next = 0, done = 0;
+				std::exception_ptr exception;
+				std::mutex mutex;
+				std::condition_variable finished;
+			};
+			auto shared = std::make_shared<state>();
+			auto work = [shared, count, &func] {
+				for(size_t i = shared->next++; i < count; i = shared->next++) {
+					try {
+						func(i);
+					} catch(...) {
+						std::scoped_lock lock(shared->mutex);
+						if(!shared->exception) shared->exception = std::current_exception();
+					}
+					if(++shared->done == count) {
+						std::scoped_lock lock(shared->mutex);
+						shared->finished.notify_all();
+					}
+				}
+			};
+
+			for(size_t i = 0, helpers = std::min(count - 1, size()); i < helpers; ++i)
+				enqueue(work);
+			work();
+
+			while(shared->done != count)
+				if(!help_while_waiting()) {
+					std::unique_lock lock(shared->mutex);
+					shared->finished.wait_for(lock, std::chrono::milliseconds(1), [&] { return shared->done == count; });
+				}
+
+			std::scoped_lock lock(shared->mutex); // The last job may still be notifying
+			if(shared->exception) std::rethrow_exception(shared->exception);
+		}
+
+		// The calling thread's scratch arena
+		static scratch_arena& scratch();
+
+	protected:
+		struct queue {
+			std::mutex mutex;
+			std::deque<std::function<void()>> jobs;
+		};
+		std::vector<std::unique_ptr<queue>> queues; // One per worker
+		std::vector<std::thread> workers;
+		std::atomic<size_t> pending = 0, next_queue = 0;
+		std::mutex mutex;
+		std::condition_variable wake;
+		bool stopping = false;
+
+		bool run_pending_job(size_t worker);
+		// Runs a queued job or the wait hook, returns false if neither had anything to do
+		bool help_while_waiting() {
+			if(run_pending_job()) return true;
+			auto& hook = wait_hook();
+			return hook && hook();
+		}
+
+		friend struct job_graph;
+	};
+
+	// Jobs with dependencies between them, each job runs once every job it depends on has finished
+	// NOTE: A graph can be run any number of times
+	struct job_graph {
+		using node = size_t;
+
+		node add(std::function<void()> job, std::initializer_list<node> dependencies = {});
+		// Makes job wait for dependency
+		job_graph& depend(node job, node dependency);
+
+		size_t size() const { return entries.size(); }
+
+		// Runs every job on the pool and waits for all of them to finish (the calling thread helps out meanwhile)
+		// NOTE: Once a job throws the jobs which haven't started yet are skipped, the exception is rethrown here
+		void run(thread_pool& pool = thread_pool::get_default());
+
+	protected:
+		struct entry {
+			std::function<void()> job;
+			std::vector<node> dependents;
+			size_t dependency_count = 0;
+		};
+		std::vector<entry> entries;
+	};
+}
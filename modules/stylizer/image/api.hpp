@@ -2,12 +2,27 @@
 
 #include "api.hpp"
 
+#include <limits>
 #include <optional>
 #include <stylizer/core/api.hpp>
+#include <stylizer/core/util/file_watcher.hpp>
 #include <stylizer/core/util/load_file.hpp>
+#include <stylizer/core/util/loader_registry.hpp>
 #include <stylizer/core/util/maybe_owned.hpp>
 
 namespace stylizer { inline namespace images {
+	// Asks upload to write (and generate if the image doesn't store them) count mip levels, clamped to the image's full chain so the default asks for every level
+	// NOTE: upload's default config already asks for every level, hand built configs need to go through this to get them too
+	inline texture::create_config with_mip_levels(texture::create_config config = {}, size_t count = std::numeric_limits<uint32_t>::max()) {
+		config.mip_level_count = count;
+		return config;
+	}
+	// Asks upload to only write the image itself, skipping mip generation (eg for textures which are reuploaded every frame)
+	inline texture::create_config without_mip_levels(texture::create_config config = {}) {
+		config.mip_level_count = 1;
+		return config;
+	}
+
 	struct image { STYLIZER_MOVE_AND_MAKE_OWNED_BASE_METHODS(image)
 		// For a 2D image the Z dimension is 1
 		// The W dimension is bytes of color data
@@ -15,8 +30,32 @@ namespace stylizer { inline namespace images {
 		template<typename Tcolor>
 		using pixel_grid = stdmath::stl::mdspan<Tcolor, stdmath::stl::extents<size_t, stdmath::stl::dynamic_extent, stdmath::stl::dynamic_extent, stdmath::stl::dynamic_extent>>;
 
-		static std::unordered_map<std::string, std::function<maybe_owned<image>(context&, std::span<std::byte>, std::string_view)>>& get_loader_set();
+		// Owned images are released through maybe_owned<image>, derived members (eg a mapped file) need to be destroyed too
+		virtual ~image() = default;
+
+		static loader_registry<image>& get_loader_set();
 		static maybe_owned<image> load(context& ctx, std::filesystem::path file);
+		// Content addressed: files with identical bytes share a single decoded image / uploaded texture no matter their path
+		// NOTE: The returned references stay valid until clear_shared_cache is called
+		// NOTE: Files which fail to decode aren't cached, load_shared returns nullptr and load_shared_texture the default texture for them
+		// NOTE: Textures are only shared between loads asking for the same sampler_config
+		// NOTE: Only load_shared keeps the decoded image around, load_shared_texture drops it once the texture is uploaded
+		static image* load_shared(context& ctx, std::filesystem::path file);
+		static texture& load_shared_texture(context& ctx, std::filesystem::path file, const std::optional<texture::sampler_config>& sampler_config = texture::sampler_config{});
+		static void clear_shared_cache();
+
+		// Decodes every file concurrently on the context's jobs, the results line up with files
+		// NOTE: If any file fails to load, everything loaded so far is released and the first error is rethrown
+		static std::vector<maybe_owned<image>> load_many(context& ctx, std::span<const std::filesystem::path> files);
+		// Uploads every image with a single trip to the context's owner (rather than one per image)
+		static std::vector<texture> upload_many(context& ctx, std::span<image* const> images, texture::create_config config_template = with_mip_levels(), const std::optional<texture::sampler_config>& sampler_config = {});
+		// Batched load_shared_texture: decodes the files concurrently then uploads whichever textures aren't already shared in one batch
+		// NOTE: Files which fail to decode are returned as nullptr
+		static std::vector<texture*> load_shared_textures(context& ctx, std::span<const std::filesystem::path> files, const std::optional<texture::sampler_config>& sampler_config = texture::sampler_config{});
+
+		// Reloads and reuploads the image into target whenever file changes on disk
+		// NOTE: ctx and target must outlive the returned token
+		static file_watcher::token watch_for_changes(context& ctx, std::filesystem::path file, texture& target, std::function<void(texture&)> on_reloaded = {});
 
 		virtual texture::format get_format() = 0;
 		virtual byte_grid get_byte_grid() = 0;
@@ -28,28 +67,15 @@ namespace stylizer { inline namespace images {
 			return {bytes.data_handle(), bytes.extent(0)};
 		}
 
-		virtual texture& upload(context& ctx, texture& texture, texture::create_config config_template = {}, const std::optional<texture::sampler_config>& sampler_config = {}) {
-			auto byte_grid = get_byte_grid();
-			stdmath::uint3 extents = {extent(0), extent(1), extent(2)};
-			auto bytes_per_row = extents.x * extents.z * extent(3);
-			auto rows_per_image = extents.y;
-			auto size = bytes_per_row * rows_per_image;
-			
-			if(!texture || texture.texture_format() != get_format()) {
-				if(texture) texture.release();
-				config_template.format = get_format();
-				config_template.size = extents;
-				config_template.usage |= api::usage::CopyDestination;
-				texture = texture::create(ctx, config_template, sampler_config);
-			}
-			texture.write(ctx, {byte_grid.data_handle(), size}, {
-				.offset = 0,
-				.bytes_per_row = bytes_per_row,
-				.rows_per_image = rows_per_image
-			}, extents);
-			return texture;
-		};
-		texture upload(context& ctx, texture::create_config config_template = {}, const std::optional<texture::sampler_config>& sampler_config = {}) {
+		// Every mip level below this one (down to 1x1), which upload writes along with the image itself
+		// NOTE: Generated (in linear space for sRGB formats, with rows spread across pool) unless the image already stores them, only called when upload's config asks for mip levels (which it does by default)
+		virtual std::vector<maybe_owned<image>> get_mip_levels(thread_pool& pool = thread_pool::get_default());
+
+		// NOTE: By default every mip level is written, pass without_mip_levels() to only write the image itself
+		virtual texture& upload(context& ctx, texture& texture, texture::create_config config_template = with_mip_levels(), const std::optional<texture::sampler_config>& sampler_config = {});
+		// Uploads the image along with already prepared mip levels (eg generated off of the context's owner thread)
+		virtual texture& upload(context& ctx, texture& texture, std::span<image* const> mip_levels, texture::create_config config_template = {}, const std::optional<texture::sampler_config>& sampler_config = {});
+		texture upload(context& ctx, texture::create_config config_template = with_mip_levels(), const std::optional<texture::sampler_config>& sampler_config = {}) {
 			texture out;
 			return std::move(upload(ctx, out, config_template, sampler_config));
 		}
@@ -0,0 +1,538 @@
+#include "block_compression.hpp"
+
+#include <cmath>
+#include <cstring>
+#if defined(__SSSE3__)
+	#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	#include <arm_neon.h>
+#endif
+
+namespace stylizer { inline namespace images {
+
+	static uint16_t read16(const std::byte* data) { uint16_t out; std::memcpy(&out, data, sizeof(out)); return out; }
+	static uint32_t read32(const std::byte* data) { uint32_t out; std::memcpy(&out, data, sizeof(out)); return out; }
+	static uint64_t read64(const std::byte* data) { uint64_t out; std::memcpy(&out, data, sizeof(out)); return out; }
+
+	static stdmath::byte4 expand565(uint16_t color) {
+		uint8_t r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+		return {uint8_t((r << 3) | (r >> 2)), uint8_t((g << 2) | (g >> 4)), uint8_t((b << 3) | (b >> 2)), 255};
+	}
+
+	// The colors a BC1/BC2/BC3 block's indices pick from, in BC2/BC3 the 3 color (punch through alpha) mode doesn't exist
+	static void color_palette(uint16_t c0, uint16_t c1, bool allow_punch_through, stdmath::byte4 palette[4]) {
+		palette[0] = expand565(c0);
+		palette[1] = expand565(c1);
+		auto mix = [&](int w0, int w1, int divisor) {
+			stdmath::byte4 out;
+			for(int c = 0; c < 3; ++c)
+				out[c] = uint8_t((palette[0][c] * w0 + palette[1][c] * w1 + divisor / 2) / divisor);
+			out[3] = 255;
+			return out;
+		};
+		if(c0 > c1 || !allow_punch_through) {
+			palette[2] = mix(2, 1, 3);
+			palette[3] = mix(1, 2, 3);
+		} else {
+			palette[2] = mix(1, 1, 2);
+			palette[3] = {0, 0, 0, 0};
+		}
+	}
+
+	static void decode_color_block(const std::byte* block, stdmath::byte4 out[16], bool allow_punch_through) {
+		stdmath::byte4 palette[4];
+		color_palette(read16(block), read16(block + 2), allow_punch_through, palette);
+		uint32_t indices = read32(block + 4);
+		for(size_t i = 0; i < 16; ++i)
+			out[i] = palette[(indices >> (i * 2)) & 3];
+	}
+
+	// The values a BC4 block's (or the alpha half of a BC3 block's) indices pick from
+	static void channel_palette(int e0, int e1, bool is_signed, int palette[8]) {
+		palette[0] = e0;
+		palette[1] = e1;
+		if(e0 > e1)
+			for(int i = 1; i < 7; ++i)
+				palette[i + 1] = ((7 - i) * e0 + i * e1 + 3) / 7;
+		else {
+			for(int i = 1; i < 5; ++i)
+				palette[i + 1] = ((5 - i) * e0 + i * e1 + 2) / 5;
+			palette[6] = is_signed ? -127 : 0;
+			palette[7] = is_signed ? 127 : 255;
+		}
+	}
+
+	// Signed blocks are remapped to [0, 255]
+	static void decode_channel_block(const std::byte* block, uint8_t out[16], bool is_signed) {
+		int e0 = uint8_t(block[0]), e1 = uint8_t(block[1]);
+		if(is_signed) { // [-127, 127] (-128 clamps to -127)
+			e0 = std::max<int>(int8_t(e0), -127);
+			e1 = std::max<int>(int8_t(e1), -127);
+		}
+		int palette[8];
+		channel_palette(e0, e1, is_signed, palette);
+
+		uint64_t indices = read64(block) >> 16;
+		for(size_t i = 0; i < 16; ++i) {
+			int value = palette[(indices >> (i * 3)) & 7];
+			out[i] = is_signed ? uint8_t(((value + 127) * 255 + 127) / 254) : uint8_t(value);
+		}
+	}
+
+	bool can_decompress(block_format format) {
+		using family = block_format::family;
+		switch(format.type) {
+			case family::RGBA8: case family::BC1: case family::BC2: case family::BC3: case family::BC4: case family::BC5: return true;
+			default: return false;
+		}
+	}
+
+	std::optional<dynamic_memory_image<stdmath::byte4>> decompress_blocks(block_format format, std::span<const std::byte> blocks, size_t width, size_t height) {
+		using family = block_format::family;
+		if(!can_decompress(format) || blocks.size() < format.level_size(width, height)) return {};
+
+		dynamic_memory_image<stdmath::byte4> out(dynamic_memory_image<stdmath::byte4>::extents_t(width, height, 1));
+		out.format = texture_format_of(block_format{family::RGBA8, 1, 1, format.srgb});
+		auto pixels = (stdmath::byte4*)out.data.data();
+		if(format.type == family::RGBA8) {
+			std::memcpy(pixels, blocks.data(), width * height * sizeof(stdmath::byte4));
+			return out;
+		}
+
+		size_t blocks_wide = format.blocks_wide(width), blocks_high = format.blocks_high(height);
+		for(size_t by = 0; by < blocks_high; ++by)
+			for(size_t bx = 0; bx < blocks_wide; ++bx) {
+				auto block = blocks.data() + (by * blocks_wide + bx) * format.bytes_per_block();
+				stdmath::byte4 texels[16];
+				uint8_t channel[16];
+				switch(format.type) {
+				case family::BC1:
+					decode_color_block(block, texels, true);
+					break;
+				case family::BC2: {
+					decode_color_block(block + 8, texels, false);
+					uint64_t alpha = read64(block);
+					for(size_t i = 0; i < 16; ++i)
+						texels[i][3] = uint8_t(((alpha >> (i * 4)) & 15) * 17);
+				} break;
+				case family::BC3:
+					decode_color_block(block + 8, texels, false);
+					decode_channel_block(block, channel, false);
+					for(size_t i = 0; i < 16; ++i)
+						texels[i][3] = channel[i];
+					break;
+				case family::BC4:
+					decode_channel_block(block, channel, format.is_signed);
+					for(size_t i = 0; i < 16; ++i)
+						texels[i] = {channel[i], channel[i], channel[i], 255};
+					break;
+				case family::BC5:
+					decode_channel_block(block, channel, format.is_signed);
+					for(size_t i = 0; i < 16; ++i)
+						texels[i] = {channel[i], 0, 0, 255};
+					decode_channel_block(block + 8, channel, format.is_signed);
+					for(size_t i = 0; i < 16; ++i)
+						texels[i][1] = channel[i];
+					break;
+				default: break;
+				}
+
+				// Partial blocks along the edges are cropped
+				for(size_t y = 0; y < 4 && by * 4 + y < height; ++y)
+					for(size_t x = 0; x < 4 && bx * 4 + x < width; ++x)
+						pixels[(by * 4 + y) * width + bx * 4 + x] = texels[y * 4 + x];
+			}
+		return out;
+	}
+
+	// Finds the nearest palette entry to each of a block's pixels, returns the summed squared error (each pixel's is written to errors)
+	// NOTE: Pixels and palette entries are RGBA8, channels which shouldn't count must be zeroed in both
+	static uint32_t nearest_indices(const uint8_t pixels[64], const uint8_t* palette, size_t palette_size, uint8_t indices[16], uint32_t errors[16]) {
+		alignas(16) uint32_t best[16], best_index[16];
+#if defined(__SSSE3__)
+		__m128i in[4], best_error[4], best_entry[4];
+		for(size_t i = 0; i < 4; ++i) {
+			in[i] = _mm_loadu_si128((const __m128i*)(pixels + i * 16));
+			best_error[i] = _mm_set1_epi32(INT32_MAX);
+			best_entry[i] = _mm_setzero_si128();
+		}
+		for(size_t p = 0; p < palette_size; ++p) {
+			uint32_t entry;
+			std::memcpy(&entry, palette + p * 4, sizeof(entry));
+			__m128i color = _mm_set1_epi32(entry), index = _mm_set1_epi32(p);
+			for(size_t i = 0; i < 4; ++i) {
+				// |pixel - color| squared and summed per pixel: madd sums pairs of channels, hadd the pairs
+				__m128i difference = _mm_or_si128(_mm_subs_epu8(in[i], color), _mm_subs_epu8(color, in[i]));
+				__m128i low = _mm_unpacklo_epi8(difference, _mm_setzero_si128()), high = _mm_unpackhi_epi8(difference, _mm_setzero_si128());
+				__m128i error = _mm_hadd_epi32(_mm_madd_epi16(low, low), _mm_madd_epi16(high, high));
+				__m128i closer = _mm_cmplt_epi32(error, best_error[i]);
+				best_error[i] = _mm_or_si128(_mm_and_si128(closer, error), _mm_andnot_si128(closer, best_error[i]));
+				best_entry[i] = _mm_or_si128(_mm_and_si128(closer, index), _mm_andnot_si128(closer, best_entry[i]));
+			}
+		}
+		for(size_t i = 0; i < 4; ++i) {
+			_mm_store_si128((__m128i*)(best + i * 4), best_error[i]);
+			_mm_store_si128((__m128i*)(best_index + i * 4), best_entry[i]);
+		}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+		uint8x16_t in[4];
+		uint32x4_t best_error[4], best_entry[4];
+		for(size_t i = 0; i < 4; ++i) {
+			in[i] = vld1q_u8(pixels + i * 16);
+			best_error[i] = vdupq_n_u32(UINT32_MAX);
+			best_entry[i] = vdupq_n_u32(0);
+		}
+		for(size_t p = 0; p < palette_size; ++p) {
+			uint32_t entry;
+			std::memcpy(&entry, palette + p * 4, sizeof(entry));
+			uint8x16_t color = vreinterpretq_u8_u32(vdupq_n_u32(entry));
+			uint32x4_t index = vdupq_n_u32(p);
+			for(size_t i = 0; i < 4; ++i) {
+				uint8x16_t difference = vabdq_u8(in[i], color);
+				uint16x8_t low = vmull_u8(vget_low_u8(difference), vget_low_u8(difference)), high = vmull_high_u8(difference, difference);
+				uint32x4_t error = vpaddq_u32(vpaddlq_u16(low), vpaddlq_u16(high));
+				uint32x4_t closer = vcltq_u32(error, best_error[i]);
+				best_error[i] = vbslq_u32(closer, error, best_error[i]);
+				best_entry[i] = vbslq_u32(closer, index, best_entry[i]);
+			}
+		}
+		for(size_t i = 0; i < 4; ++i) {
+			vst1q_u32(best + i * 4, best_error[i]);
+			vst1q_u32(best_index + i * 4, best_entry[i]);
+		}
+#else
+		for(size_t i = 0; i < 16; ++i) {
+			best[i] = UINT32_MAX;
+			for(size_t p = 0; p < palette_size; ++p) {
+				uint32_t error = 0;
+				for(size_t c = 0; c < 4; ++c) {
+					int difference = int(pixels[i * 4 + c]) - palette[p * 4 + c];
+					error += difference * difference;
+				}
+				if(error < best[i]) {
+					best[i] = error;
+					best_index[i] = p;
+				}
+			}
+		}
+#endif
+		uint32_t total = 0;
+		for(size_t i = 0; i < 16; ++i) {
+			indices[i] = best_index[i];
+			errors[i] = best[i];
+			total += best[i];
+		}
+		return total;
+	}
+
+	// Endpoints at the extremes of the (included) pixels' principal axis, over the first channels channels
+	static void principal_endpoints(const uint8_t pixels[64], size_t channels, uint16_t included, float low[4], float high[4]) {
+		float mean[4] = {}, count = 0;
+		for(size_t i = 0; i < 16; ++i)
+			if(included >> i & 1) {
+				for(size_t c = 0; c < channels; ++c)
+					mean[c] += pixels[i * 4 + c];
+				++count;
+			}
+		for(size_t c = 0; c < channels; ++c)
+			low[c] = high[c] = mean[c] /= std::max(count, 1.f);
+		if(count == 0) return;
+
+		float covariance[4][4] = {}, axis[4] = {};
+		for(size_t i = 0; i < 16; ++i)
+			if(included >> i & 1)
+				for(size_t a = 0; a < channels; ++a)
+					for(size_t b = 0; b < channels; ++b)
+						covariance[a][b] += (pixels[i * 4 + a] - mean[a]) * (pixels[i * 4 + b] - mean[b]);
+
+		// Power iteration, starting from the luminance-ish diagonal
+		for(size_t c = 0; c < channels; ++c)
+			axis[c] = 1;
+		for(size_t iteration = 0; iteration < 8; ++iteration) {
+			float next[4] = {}, length = 0;
+			for(size_t a = 0; a < channels; ++a) {
+				for(size_t b = 0; b < channels; ++b)
+					next[a] += covariance[a][b] * axis[b];
+				length = std::max(length, std::abs(next[a]));
+			}
+			if(length < 1e-6f) return; // Every pixel is the same
+			for(size_t c = 0; c < channels; ++c)
+				axis[c] = next[c] / length;
+		}
+
+		float min = INFINITY, max = -INFINITY;
+		for(size_t i = 0; i < 16; ++i)
+			if(included >> i & 1) {
+				float t = 0;
+				for(size_t c = 0; c < channels; ++c)
+					t += (pixels[i * 4 + c] - mean[c]) * axis[c];
+				min = std::min(min, t);
+				max = std::max(max, t);
+			}
+		float length_squared = 0;
+		for(size_t c = 0; c < channels; ++c)
+			length_squared += axis[c] * axis[c];
+		for(size_t c = 0; c < channels; ++c) {
+			low[c] = std::clamp(mean[c] + axis[c] * min / length_squared, 0.f, 255.f);
+			high[c] = std::clamp(mean[c] + axis[c] * max / length_squared, 0.f, 255.f);
+		}
+	}
+
+	// Least squares endpoints for the chosen indices, weights[index] is how far towards high each index lies
+	// Returns false (leaving the endpoints alone) if every included pixel picked the same weight
+	static bool refine_endpoints(const uint8_t pixels[64], size_t channels, uint16_t included, const uint8_t indices[16], const float* weights, float low[4], float high[4]) {
+		float aa = 0, ab = 0, bb = 0, ap[4] = {}, bp[4] = {};
+		for(size_t i = 0; i < 16; ++i)
+			if(included >> i & 1) {
+				float b = weights[indices[i]], a = 1 - b;
+				aa += a * a;
+				ab += a * b;
+				bb += b * b;
+				for(size_t c = 0; c < channels; ++c) {
+					ap[c] += a * pixels[i * 4 + c];
+					bp[c] += b * pixels[i * 4 + c];
+				}
+			}
+		float determinant = aa * bb - ab * ab;
+		if(std::abs(determinant) < 1e-6f) return false;
+		for(size_t c = 0; c < channels; ++c) {
+			low[c] = std::clamp((ap[c] * bb - bp[c] * ab) / determinant, 0.f, 255.f);
+			high[c] = std::clamp((bp[c] * aa - ap[c] * ab) / determinant, 0.f, 255.f);
+		}
+		return true;
+	}
+
+	static uint16_t pack565(const float color[4]) {
+		auto quantize = [](float value, int max) { return uint16_t(std::lround(value * max / 255)); };
+		return quantize(color[0], 31) << 11 | quantize(color[1], 63) << 5 | quantize(color[2], 31);
+	}
+
+	// BC1 color block (or the color half of a BC2/BC3 block), with punch through the pixels with alpha below half become transparent black
+	static void encode_color_block(const uint8_t in[64], std::byte out[8], bool punch_through) {
+		uint8_t pixels[64];
+		uint16_t opaque = 0;
+		for(size_t i = 0; i < 16; ++i) {
+			std::memcpy(pixels + i * 4, in + i * 4, 3);
+			pixels[i * 4 + 3] = 0; // Alpha doesn't count towards the error
+			if(!punch_through || in[i * 4 + 3] >= 128) opaque |= 1 << i;
+		}
+		bool three_color = opaque != 0xFFFF;
+
+		struct candidate {
+			uint32_t error = UINT32_MAX;
+			uint16_t c0 = 0, c1 = 0;
+			uint8_t indices[16] = {};
+		};
+		auto evaluate = [&](const float low[4], const float high[4]) {
+			candidate out;
+			out.c0 = pack565(high);
+			out.c1 = pack565(low);
+			if(three_color) { // c0 <= c1 selects the 3 color mode
+				if(out.c0 > out.c1) std::swap(out.c0, out.c1);
+			} else { // c0 > c1 selects the 4 color mode, equal endpoints are nudged apart
+				if(out.c0 < out.c1) std::swap(out.c0, out.c1);
+				if(out.c0 == out.c1) out.c1 > 0 ? --out.c1 : ++out.c0;
+			}
+
+			stdmath::byte4 palette[4];
+			color_palette(out.c0, out.c1, punch_through, palette);
+			uint8_t entries[16];
+			for(size_t p = 0; p < 4; ++p) {
+				for(size_t c = 0; c < 3; ++c)
+					entries[p * 4 + c] = palette[p][c];
+				entries[p * 4 + 3] = 0;
+			}
+			uint32_t errors[16];
+			nearest_indices(pixels, entries, three_color ? 3 : 4, out.indices, errors);
+			out.error = 0;
+			for(size_t i = 0; i < 16; ++i)
+				if(opaque >> i & 1) out.error += errors[i];
+				else out.indices[i] = 3;
+			return out;
+		};
+
+		candidate best;
+		if(opaque) {
+			float low[4], high[4];
+			principal_endpoints(pixels, 3, opaque, low, high);
+			best = evaluate(low, high);
+
+			// One least squares pass over the chosen indices (weights are towards c0, which evaluate packs from high)
+			constexpr static float four_color_weights[4] = {1, 0, 2.f / 3, 1.f / 3}, three_color_weights[4] = {1, 0, .5f, 0};
+			if(refine_endpoints(pixels, 3, opaque, best.indices, three_color ? three_color_weights : four_color_weights, low, high))
+				if(auto refined = evaluate(low, high); refined.error < best.error)
+					best = refined;
+		} else best.c0 = 0, best.c1 = 0xFFFF, std::fill(best.indices, best.indices + 16, 3); // Fully transparent
+
+		std::memcpy(out, &best.c0, 2);
+		std::memcpy(out + 2, &best.c1, 2);
+		uint32_t indices = 0;
+		for(size_t i = 0; i < 16; ++i)
+			indices |= uint32_t(best.indices[i]) << (i * 2);
+		std::memcpy(out + 4, &indices, 4);
+	}
+
+	// BC4 block (or the alpha half of a BC3 block) from one channel of the pixels, always in the 8 value mode
+	static void encode_channel_block(const uint8_t in[64], size_t channel, std::byte out[8]) {
+		uint8_t pixels[64] = {}, min = 255, max = 0;
+		for(size_t i = 0; i < 16; ++i) {
+			pixels[i * 4] = in[i * 4 + channel];
+			min = std::min(min, pixels[i * 4]);
+			max = std::max(max, pixels[i * 4]);
+		}
+
+		uint8_t indices[16] = {};
+		if(min != max) { // Otherwise every index picks e0 (in the 6 value mode, which doesn't matter)
+			int palette[8];
+			channel_palette(max, min, false, palette);
+			uint8_t entries[32] = {};
+			for(size_t p = 0; p < 8; ++p)
+				entries[p * 4] = palette[p];
+			uint32_t errors[16];
+			nearest_indices(pixels, entries, 8, indices, errors);
+		}
+
+		uint64_t bits = uint64_t(max) | uint64_t(min) << 8;
+		for(size_t i = 0; i < 16; ++i)
+			bits |= uint64_t(indices[i]) << (16 + i * 3);
+		std::memcpy(out, &bits, 8);
+	}
+
+	struct bit_writer {
+		std::byte* out;
+		size_t at = 0;
+
+		void write(uint32_t value, size_t bits) {
+			for(size_t i = 0; i < bits; ++i, ++at)
+				if(value >> i & 1) out[at / 8] |= std::byte(1 << (at % 8));
+		}
+	};
+
+	// BC7 block in mode 6 (one subset, 7 bit RGBA endpoints each with their own p-bit, 4 bit indices)
+	// NOTE: Only mode 6 is searched, it handles smooth and alpha content well but is weaker than a full mode search on blocks with sharp multicolor edges
+	static void encode_bc7_block(const uint8_t pixels[64], std::byte out[16]) {
+		constexpr static uint8_t weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+		struct candidate {
+			uint32_t error = UINT32_MAX;
+			uint8_t endpoints[2][4] = {}; // 7 bits
+			uint8_t p_bits[2] = {};
+			uint8_t indices[16] = {};
+		};
+		auto evaluate = [&](const float low[4], const float high[4]) {
+			candidate out;
+			uint8_t colors[2][4];
+			const float* ends[2] = {low, high};
+			for(size_t e = 0; e < 2; ++e) { // Pick whichever p-bit reconstructs the endpoint best
+				uint32_t best_error = UINT32_MAX;
+				for(uint8_t p = 0; p < 2; ++p) {
+					uint32_t error = 0;
+					uint8_t quantized[4];
+					for(size_t c = 0; c < 4; ++c) {
+						quantized[c] = std::clamp<long>(std::lround((ends[e][c] - p) / 2), 0, 127);
+						int difference = int(quantized[c] << 1 | p) - int(std::lround(ends[e][c]));
+						error += difference * difference;
+					}
+					if(error < best_error) {
+						best_error = error;
+						out.p_bits[e] = p;
+						std::memcpy(out.endpoints[e], quantized, 4);
+					}
+				}
+				for(size_t c = 0; c < 4; ++c)
+					colors[e][c] = out.endpoints[e][c] << 1 | out.p_bits[e];
+			}
+
+			uint8_t palette[64];
+			for(size_t i = 0; i < 16; ++i)
+				for(size_t c = 0; c < 4; ++c)
+					palette[i * 4 + c] = ((64 - weights[i]) * colors[0][c] + weights[i] * colors[1][c] + 32) >> 6;
+			uint32_t errors[16];
+			out.error = nearest_indices(pixels, palette, 16, out.indices, errors);
+			return out;
+		};
+
+		float low[4], high[4];
+		principal_endpoints(pixels, 4, 0xFFFF, low, high);
+		auto best = evaluate(low, high);
+		float towards_high[16];
+		for(size_t i = 0; i < 16; ++i)
+			towards_high[i] = weights[i] / 64.f;
+		if(refine_endpoints(pixels, 4, 0xFFFF, best.indices, towards_high, low, high))
+			if(auto refined = evaluate(low, high); refined.error < best.error)
+				best = refined;
+
+		// The first index's top bit is implied to be zero, so flip the block around if it is set
+		if(best.indices[0] & 8) {
+			std::swap(best.endpoints[0], best.endpoints[1]);
+			std::swap(best.p_bits[0], best.p_bits[1]);
+			for(auto& index: best.indices)
+				index = 15 - index;
+		}
+
+		std::memset(out, 0, 16);
+		bit_writer writer{out};
+		writer.write(1 << 6, 7); // Mode 6
+		for(size_t c = 0; c < 4; ++c)
+			for(size_t e = 0; e < 2; ++e)
+				writer.write(best.endpoints[e][c], 7);
+		writer.write(best.p_bits[0], 1);
+		writer.write(best.p_bits[1], 1);
+		writer.write(best.indices[0], 3);
+		for(size_t i = 1; i < 16; ++i)
+			writer.write(best.indices[i], 4);
+	}
+
+	bool can_compress(block_format format) {
+		using family = block_format::family;
+		if(format.is_signed) return false;
+		switch(format.type) {
+			case family::BC1: case family::BC3: case family::BC4: case family::BC5: case family::BC7: return true;
+			default: return false;
+		}
+	}
+
+	bool compress_blocks(block_format format, image& source, std::span<std::byte> destination, thread_pool& pool /* = thread_pool::get_default() */) {
+		using family = block_format::family;
+		size_t width = source.extent(0), height = source.extent(1);
+		if(!can_compress(format) || source.extent(3) != sizeof(stdmath::byte4) || source.extent(2) != 1) {
+			get_error_handler()(stylizer::error_severity::Error, "Only 2D RGBA8 images can be block compressed, and only into BC1, BC3, BC4, BC5, or BC7!", 0);
+			return false;
+		}
+		if(destination.size() < format.level_size(width, height)) {
+			get_error_handler()(stylizer::error_severity::Error, "Not enough room for the compressed blocks!", 0);
+			return false;
+		}
+
+		auto in = (const uint8_t*)source.get_byte_grid().data_handle();
+		size_t blocks_wide = format.blocks_wide(width), bytes_per_block = format.bytes_per_block();
+		pool.parallel_for(format.blocks_high(height), [&](size_t by) {
+			for(size_t bx = 0; bx < blocks_wide; ++bx) {
+				// Blocks hanging over the edges repeat the edge pixels
+				alignas(16) uint8_t pixels[64];
+				for(size_t y = 0; y < 4; ++y)
+					for(size_t x = 0; x < 4; ++x) {
+						size_t sx = std::min(bx * 4 + x, width - 1), sy = std::min(by * 4 + y, height - 1);
+						std::memcpy(pixels + (y * 4 + x) * 4, in + (sy * width + sx) * 4, 4);
+					}
+
+				auto block = destination.data() + (by * blocks_wide + bx) * bytes_per_block;
+				switch(format.type) {
+					case family::BC1: encode_color_block(pixels, block, true); break;
+					case family::BC3:
+						encode_channel_block(pixels, 3, block);
+						encode_color_block(pixels, block + 8, false);
+						break;
+					case family::BC4: encode_channel_block(pixels, 0, block); break;
+					case family::BC5:
+						encode_channel_block(pixels, 0, block);
+						encode_channel_block(pixels, 1, block + 8);
+						break;
+					case family::BC7: encode_bc7_block(pixels, block); break;
+					default: break;
+				}
+			}
+		});
+		return true;
+	}
+}}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "memory_image.hpp"
+
+#include <stylizer/core/texture_capabilities.hpp>
+#include <stylizer/core/util/thread_pool.hpp>
+
+#include <algorithm>
+#include <optional>
+
+namespace stylizer { inline namespace images {
+
+	// A GPU block compressed format (plain RGBA8 is treated as 1x1 "blocks" so uncompressed containers can take the same path)
+	struct block_format {
+		enum class family : uint8_t { Undefined, RGBA8, BC1, BC2, BC3, BC4, BC5, BC6H, BC7, ASTC };
+
+		family type = family::Undefined;
+		uint8_t block_width = 4, block_height = 4; // Only ASTC varies
+		bool srgb = false;
+		bool is_signed = false; // BC4/BC5 snorm and BC6H sfloat
+
+		constexpr bool operator==(const block_format&) const = default;
+		constexpr explicit operator bool() const { return type != family::Undefined; }
+
+		constexpr size_t bytes_per_block() const {
+			switch(type) {
+				case family::RGBA8: return 4;
+				case family::BC1: case family::BC4: return 8;
+				case family::Undefined: return 0;
+				default: return 16;
+			}
+		}
+
+		// Partial blocks along the edges are padded out to full blocks
+		constexpr size_t blocks_wide(size_t width) const { return (std::max<size_t>(width, 1) + block_width - 1) / block_width; }
+		constexpr size_t blocks_high(size_t height) const { return (std::max<size_t>(height, 1) + block_height - 1) / block_height; }
+		constexpr size_t bytes_per_row(size_t width) const { return blocks_wide(width) * bytes_per_block(); }
+		constexpr size_t level_size(size_t width, size_t height, size_t depth = 1) const { return bytes_per_row(width) * blocks_high(height) * std::max<size_t>(depth, 1); }
+	};
+
+	// Where one mip level lives inside of a file
+	struct block_level {
+		size_t offset = 0, size = 0;
+		uint32_t width = 0, height = 0, depth = 1;
+	};
+
+	// Levels stored one after another starting at offset, each halving the last (never going below 1)
+	inline std::vector<block_level> mip_layout(block_format format, uint32_t width, uint32_t height, uint32_t depth, size_t level_count, size_t offset = 0) {
+		std::vector<block_level> out(level_count);
+		for(auto& level: out) {
+			level = {offset, format.level_size(width, height, depth), width, height, depth};
+			offset += level.size;
+			width = std::max(width / 2, 1u);
+			height = std::max(height / 2, 1u);
+			depth = std::max(depth / 2, 1u);
+		}
+		return out;
+	}
+
+	// The texture format a block format is uploaded as, Undefined if the graphics API doesn't expose it (see texture_capabilities)
+	constexpr texture::format texture_format_of(block_format format) {
+		namespace formats = texture_capabilities;
+		using family = block_format::family;
+		switch(format.type) {
+			case family::RGBA8: return format.srgb ? texture::format::RGBA8srgb : texture::format::RGBA8;
+			case family::BC1: return format.srgb ? formats::BC1srgb : formats::BC1;
+			case family::BC2: return format.srgb ? formats::BC2srgb : formats::BC2;
+			case family::BC3: return format.srgb ? formats::BC3srgb : formats::BC3;
+			case family::BC4: return format.is_signed ? formats::BC4signed : formats::BC4;
+			case family::BC5: return format.is_signed ? formats::BC5signed : formats::BC5;
+			case family::BC6H: return format.is_signed ? formats::BC6Hsigned : formats::BC6H;
+			case family::BC7: return format.srgb ? formats::BC7srgb : formats::BC7;
+			case family::ASTC: return formats::astc(format.block_width, format.block_height, format.srgb);
+			default: return texture::format::Undefined;
+		}
+	}
+
+	// Whether the format can be decoded on the CPU (as a fallback for when the GPU can't sample it)
+	bool can_decompress(block_format format);
+	// Decodes a width x height level into RGBA8 (BC4 is expanded to grey, BC5 to red/green), returns nullopt if the format can't be decoded
+	// NOTE: Signed BC4/BC5 are remapped from [-1, 1] to [0, 255]
+	std::optional<dynamic_memory_image<stdmath::byte4>> decompress_blocks(block_format format, std::span<const std::byte> blocks, size_t width, size_t height);
+
+	// Whether the CPU encoder supports the format (BC1, BC3, BC4, BC5, and BC7, none of them signed)
+	bool can_compress(block_format format);
+	// Encodes a 2D RGBA8 image into destination (which must hold format.level_size(width, height) bytes), rows of blocks are spread across pool
+	// NOTE: BC1 makes pixels with alpha below half transparent, BC4 keeps red and BC5 red and green (eg of normal maps)
+	bool compress_blocks(block_format format, image& source, std::span<std::byte> destination, thread_pool& pool = thread_pool::get_default());
+}}
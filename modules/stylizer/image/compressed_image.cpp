@@ -0,0 +1,451 @@
+#include "compressed_image.hpp"
+#include "mipmap.hpp"
+
+#include <stylizer/core/util/compression.hpp>
+
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+
+namespace stylizer { inline namespace images {
+
+	template<typename T>
+	static T read(std::span<const std::byte> data, size_t offset) {
+		T out;
+		std::memcpy(&out, data.data() + offset, sizeof(out));
+		return out;
+	}
+
+	static std::nullopt_t fail(std::string_view message) {
+		get_error_handler()(stylizer::error_severity::Error, message, 0);
+		return std::nullopt;
+	}
+
+	// Whether every level lies inside of the file
+	static bool levels_in_bounds(const std::vector<block_level>& levels, size_t file_size) {
+		for(auto& level: levels)
+			if(level.offset > file_size || level.size > file_size - level.offset)
+				return false;
+		return true;
+	}
+
+	constexpr static std::array<std::byte, 12> ktx2_identifier = {std::byte{0xAB}, std::byte{'K'}, std::byte{'T'}, std::byte{'X'}, std::byte{' '}, std::byte{'2'}, std::byte{'0'}, std::byte{0xBB}, std::byte{'\r'}, std::byte{'\n'}, std::byte{0x1A}, std::byte{'\n'}};
+
+	bool compressed_image::is_ktx2(std::span<const std::byte> data) {
+		return data.size() >= ktx2_identifier.size() && std::equal(ktx2_identifier.begin(), ktx2_identifier.end(), data.begin());
+	}
+
+	bool compressed_image::is_dds(std::span<const std::byte> data) {
+		return data.size() >= 4 && read<uint32_t>(data, 0) == 0x20534444; // "DDS "
+	}
+
+	// In VkFormat order
+	constexpr static std::pair<uint8_t, uint8_t> astc_blocks[] = {{4, 4}, {5, 4}, {5, 5}, {6, 5}, {6, 6}, {8, 5}, {8, 6}, {8, 8}, {10, 5}, {10, 6}, {10, 8}, {10, 10}, {12, 10}, {12, 12}};
+
+	static block_format from_vulkan_format(uint32_t format) {
+		using family = block_format::family;
+		switch(format) {
+			case 37: return {family::RGBA8, 1, 1}; // VK_FORMAT_R8G8B8A8_UNORM
+			case 43: return {family::RGBA8, 1, 1, true}; // VK_FORMAT_R8G8B8A8_SRGB
+			case 131: case 133: return {family::BC1}; // VK_FORMAT_BC1_RGB(A)_UNORM_BLOCK
+			case 132: case 134: return {family::BC1, 4, 4, true};
+			case 135: return {family::BC2};
+			case 136: return {family::BC2, 4, 4, true};
+			case 137: return {family::BC3};
+			case 138: return {family::BC3, 4, 4, true};
+			case 139: return {family::BC4};
+			case 140: return {family::BC4, 4, 4, false, true};
+			case 141: return {family::BC5};
+			case 142: return {family::BC5, 4, 4, false, true};
+			case 143: return {family::BC6H};
+			case 144: return {family::BC6H, 4, 4, false, true};
+			case 145: return {family::BC7};
+			case 146: return {family::BC7, 4, 4, true};
+		}
+		if(format >= 157 && format <= 184) { // VK_FORMAT_ASTC_{W}x{H}_{UNORM, SRGB}_BLOCK
+			auto [w, h] = astc_blocks[(format - 157) / 2];
+			return {family::ASTC, w, h, (format - 157) % 2 == 1};
+		}
+		return {};
+	}
+
+	static uint32_t to_vulkan_format(block_format format) {
+		using family = block_format::family;
+		switch(format.type) {
+			case family::RGBA8: return format.srgb ? 43 : 37;
+			case family::BC1: return format.srgb ? 134 : 133; // With alpha, BC1 blocks can always hold punch through alpha
+			case family::BC2: return format.srgb ? 136 : 135;
+			case family::BC3: return format.srgb ? 138 : 137;
+			case family::BC4: return format.is_signed ? 140 : 139;
+			case family::BC5: return format.is_signed ? 142 : 141;
+			case family::BC6H: return format.is_signed ? 144 : 143;
+			case family::BC7: return format.srgb ? 146 : 145;
+			case family::ASTC:
+				for(uint32_t i = 0; i < std::size(astc_blocks); ++i)
+					if(astc_blocks[i] == std::pair{format.block_width, format.block_height})
+						return 157 + i * 2 + format.srgb;
+				return 0;
+			default: return 0;
+		}
+	}
+
+	std::optional<compressed_image::layout> compressed_image::parse_ktx2(std::span<const std::byte> data) {
+		constexpr size_t header_size = 80, level_record_size = 24;
+		if(!is_ktx2(data)) return fail("Not a KTX2 file, identifier doesn't match!");
+		if(data.size() < header_size) return fail("KTX2 file is truncated!");
+
+		auto vk_format = read<uint32_t>(data, 12);
+		layout out;
+		out.format = from_vulkan_format(vk_format);
+		if(!out.format) return fail("KTX2 file has an unsupported format (VkFormat " + std::to_string(vk_format) + ")!");
+		out.width = read<uint32_t>(data, 20);
+		out.height = std::max(read<uint32_t>(data, 24), 1u);
+		out.depth = std::max(read<uint32_t>(data, 28), 1u);
+		auto layers = read<uint32_t>(data, 32), faces = read<uint32_t>(data, 36);
+		auto level_count = std::max(read<uint32_t>(data, 40), 1u); // 0 asks for mips to be generated at load time, we only use what is stored
+		out.supercompression = read<uint32_t>(data, 44);
+
+		if(out.width == 0) return fail("KTX2 file has no width!");
+		if(layers > 1 || faces != 1) return fail("KTX2 texture arrays and cube maps aren't supported!");
+		if(out.supercompression != 0 && out.supercompression != 2) return fail("KTX2 file uses an unsupported supercompression scheme (only zstd is supported)!");
+		if(level_count > 32 || header_size + level_count * level_record_size > data.size()) return fail("KTX2 file is truncated!");
+
+		auto expected = mip_layout(out.format, out.width, out.height, out.depth, level_count);
+		for(size_t i = 0; i < level_count; ++i) {
+			size_t record = header_size + i * level_record_size;
+			auto offset = read<uint64_t>(data, record), size = read<uint64_t>(data, record + 8), uncompressed = read<uint64_t>(data, record + 16);
+			auto& level = out.levels.emplace_back(expected[i]);
+			level.offset = offset;
+			if(out.supercompression == 0) {
+				if(size != expected[i].size) return fail("KTX2 file has a level with an unexpected size!");
+			} else {
+				if(uncompressed != expected[i].size) return fail("KTX2 file has a level with an unexpected size!");
+				level.size = size;
+				out.uncompressed_sizes.push_back(uncompressed);
+			}
+		}
+		if(!levels_in_bounds(out.levels, data.size())) return fail("KTX2 file is truncated!");
+		return out;
+	}
+
+	static block_format from_dxgi_format(uint32_t format) {
+		using family = block_format::family;
+		switch(format) {
+			case 28: return {family::RGBA8, 1, 1}; // DXGI_FORMAT_R8G8B8A8_UNORM
+			case 29: return {family::RGBA8, 1, 1, true}; // DXGI_FORMAT_R8G8B8A8_UNORM_SRGB
+			case 71: return {family::BC1}; // DXGI_FORMAT_BC1_UNORM
+			case 72: return {family::BC1, 4, 4, true};
+			case 74: return {family::BC2};
+			case 75: return {family::BC2, 4, 4, true};
+			case 77: return {family::BC3};
+			case 78: return {family::BC3, 4, 4, true};
+			case 80: return {family::BC4};
+			case 81: return {family::BC4, 4, 4, false, true};
+			case 83: return {family::BC5};
+			case 84: return {family::BC5, 4, 4, false, true};
+			case 95: return {family::BC6H};
+			case 96: return {family::BC6H, 4, 4, false, true};
+			case 98: return {family::BC7};
+			case 99: return {family::BC7, 4, 4, true};
+			default: return {};
+		}
+	}
+
+	constexpr static uint32_t four_cc(const char (&name)[5]) {
+		return uint32_t(uint8_t(name[0])) | uint32_t(uint8_t(name[1])) << 8 | uint32_t(uint8_t(name[2])) << 16 | uint32_t(uint8_t(name[3])) << 24;
+	}
+
+	static block_format from_four_cc(uint32_t code) {
+		using family = block_format::family;
+		if(code == four_cc("DXT1")) return {family::BC1};
+		if(code == four_cc("DXT2") || code == four_cc("DXT3")) return {family::BC2};
+		if(code == four_cc("DXT4") || code == four_cc("DXT5")) return {family::BC3};
+		if(code == four_cc("ATI1") || code == four_cc("BC4U")) return {family::BC4};
+		if(code == four_cc("BC4S")) return {family::BC4, 4, 4, false, true};
+		if(code == four_cc("ATI2") || code == four_cc("BC5U")) return {family::BC5};
+		if(code == four_cc("BC5S")) return {family::BC5, 4, 4, false, true};
+		return {};
+	}
+
+	std::optional<compressed_image::layout> compressed_image::parse_dds(std::span<const std::byte> data) {
+		// Magic, then a 124 byte header (with the pixel format at 76), then a 20 byte DX10 header if the four character code is DX10
+		constexpr size_t header_size = 4 + 124, dx10_header_size = 20;
+		constexpr uint32_t mip_map_count_flag = 0x20000, four_cc_flag = 0x4, rgb_flag = 0x40, cube_map_flag = 0x200, volume_flag = 0x200000;
+		if(!is_dds(data)) return fail("Not a DDS file, magic number doesn't match!");
+		if(data.size() < header_size || read<uint32_t>(data, 4) != 124) return fail("DDS file is truncated!");
+
+		layout out;
+		auto flags = read<uint32_t>(data, 8);
+		out.height = std::max(read<uint32_t>(data, 12), 1u);
+		out.width = read<uint32_t>(data, 16);
+		auto caps2 = read<uint32_t>(data, 112);
+		out.depth = caps2 & volume_flag ? std::max(read<uint32_t>(data, 24), 1u) : 1;
+		uint32_t level_count = flags & mip_map_count_flag ? std::max(read<uint32_t>(data, 28), 1u) : 1;
+		auto pixel_flags = read<uint32_t>(data, 80), code = read<uint32_t>(data, 84);
+		if(out.width == 0) return fail("DDS file has no width!");
+		if(caps2 & cube_map_flag) return fail("DDS cube maps aren't supported!");
+		if(level_count > 32) return fail("DDS file has too many mip levels!");
+
+		size_t offset = header_size;
+		if(pixel_flags & four_cc_flag && code == four_cc("DX10")) {
+			if(data.size() < header_size + dx10_header_size) return fail("DDS file is truncated!");
+			auto dxgi_format = read<uint32_t>(data, header_size);
+			auto misc = read<uint32_t>(data, header_size + 8), array_size = read<uint32_t>(data, header_size + 12);
+			if(misc & 0x4 || array_size > 1) return fail("DDS texture arrays and cube maps aren't supported!");
+			out.format = from_dxgi_format(dxgi_format);
+			if(!out.format) return fail("DDS file has an unsupported format (DXGI format " + std::to_string(dxgi_format) + ")!");
+			offset += dx10_header_size;
+		} else if(pixel_flags & four_cc_flag) {
+			out.format = from_four_cc(code);
+			if(!out.format) return fail("DDS file has an unsupported four character code!");
+		} else if(pixel_flags & rgb_flag && read<uint32_t>(data, 88) == 32 && read<uint32_t>(data, 92) == 0xFF && read<uint32_t>(data, 96) == 0xFF00 && read<uint32_t>(data, 100) == 0xFF0000)
+			out.format = {block_format::family::RGBA8, 1, 1};
+		else return fail("DDS file has an unsupported pixel format (only block compressed and RGBA8 are supported)!");
+
+		out.levels = mip_layout(out.format, out.width, out.height, out.depth, level_count, offset);
+		if(!levels_in_bounds(out.levels, data.size())) return fail("DDS file is truncated!");
+		return out;
+	}
+
+	maybe_owned<image> compressed_image::decompress(size_t level /* = 0 */) {
+		auto decoded = decompress_blocks(format, level_data(level), levels[level].width, levels[level].height);
+		if(!decoded) {
+			get_error_handler()(stylizer::error_severity::Error, "Images in this block compressed format can't be decoded on the CPU!", 0);
+			return {};
+		}
+		return decoded->move_to_owned();
+	}
+
+	texture& compressed_image::upload(context& ctx, texture& texture, std::span<image* const> mip_levels, texture::create_config config_template /* = {} */, const std::optional<texture::sampler_config>& sampler_config /* = {} */) {
+		if(!ctx.is_owner_thread()) { // GPU objects are only created by the context's owner
+			auto uploaded = ctx.run_on_owner([&] { upload(ctx, texture, mip_levels, config_template, sampler_config); });
+			ctx.wait(uploaded);
+			return texture;
+		}
+
+		auto texture_format = get_format();
+		if(texture_format == texture::format::Undefined) {
+			auto decoded = decompress(0);
+			if(!decoded.value) return texture;
+			decoded->upload(ctx, texture, config_template, sampler_config);
+			decoded.release();
+			return texture;
+		}
+
+		stdmath::uint3 extents = {width, height, depth};
+		config_template.mip_level_count = levels.size();
+
+		auto current_size = texture ? texture.size() : stdmath::uint3{};
+		bool resized = current_size.x != extents.x || current_size.y != extents.y || current_size.z != extents.z;
+		if(!texture || texture.texture_format() != texture_format || resized || texture.mip_level_count() != config_template.mip_level_count) {
+			if(texture) texture.release();
+			config_template.format = texture_format;
+			config_template.size = extents;
+			config_template.usage |= api::usage::CopyDestination;
+			texture = texture::create(ctx, config_template, sampler_config);
+		}
+
+		for(size_t i = 0; i < levels.size(); ++i) {
+			auto& level = levels[i];
+			texture.write(ctx, level_data(i), {
+				.offset = 0,
+				.bytes_per_row = format.bytes_per_row(level.width),
+				.rows_per_image = format.blocks_high(level.height)
+			}, {level.width, level.height, level.depth}, stdmath::uint3{0, 0, 0}, i);
+		}
+		return texture;
+	}
+
+	maybe_owned<image> compressed_image::load(file_cache::handle file) {
+		auto data = file.span();
+		auto parsed = is_ktx2(data) ? parse_ktx2(data) : is_dds(data) ? parse_dds(data) : fail("Not a KTX2 or DDS file!");
+		if(!parsed) return {};
+
+		compressed_image out;
+		out.format = parsed->format;
+		out.width = parsed->width;
+		out.height = parsed->height;
+		out.depth = parsed->depth;
+		out.levels = std::move(parsed->levels);
+
+		if(parsed->supercompression == 0) out.file = std::move(file);
+		else { // Inflate every level into one buffer, the levels then point into it instead
+			if(!compression_available(compression::Zstd)) {
+				get_error_handler()(stylizer::error_severity::Error, "KTX2 file is zstd supercompressed but zstd support isn't available!", 0);
+				return {};
+			}
+
+			size_t total = 0;
+			for(auto size: parsed->uncompressed_sizes)
+				total += size;
+			auto inflated = std::make_shared<std::vector<std::byte>>(total);
+			size_t offset = 0;
+			for(size_t i = 0; i < out.levels.size(); ++i) {
+				auto& level = out.levels[i];
+				std::span<std::byte> destination(inflated->data() + offset, parsed->uncompressed_sizes[i]);
+				if(!stylizer::decompress(compression::Zstd, data.subspan(level.offset, level.size), destination)) {
+					get_error_handler()(stylizer::error_severity::Error, "Failed to inflate a supercompressed KTX2 level!", 0);
+					return {};
+				}
+				level.offset = offset;
+				level.size = destination.size();
+				offset += level.size;
+			}
+			out.file = {inflated, *inflated};
+		}
+		return out.move_to_owned();
+	}
+
+	maybe_owned<image> load_compressed_image_generic(context& ctx, std::span<std::byte> memory, std::string_view extension) {
+		auto file = get_file_cache().pin(memory);
+		if(!file) {
+			// Not backed by a cached mapping (eg a compressed asset pack entry), so the image gets its own copy
+			auto copy = std::make_shared<std::vector<std::byte>>(memory.begin(), memory.end());
+			file = {copy, *copy};
+		}
+		return compressed_image::load(std::move(file));
+	}
+
+	std::optional<compressed_image> compressed_image::compress(image& source, block_format::family format, bool mipmaps /* = true */, thread_pool& pool /* = thread_pool::get_default() */) {
+		using family = block_format::family;
+		block_format block{format};
+		block.srgb = format != family::BC4 && format != family::BC5 && api::is_srgb(source.get_format());
+		if(!can_compress(block)) {
+			get_error_handler()(stylizer::error_severity::Error, "Images can only be block compressed into BC1, BC3, BC4, BC5, or BC7!", 0);
+			return {};
+		}
+
+		std::vector<maybe_owned<image>> chain;
+		if(mipmaps) chain = generate_mipmaps(source);
+		std::vector<image*> sources = {&source};
+		for(auto& level: chain)
+			sources.push_back(&*level);
+
+		compressed_image out;
+		out.format = block;
+		out.width = source.extent(0);
+		out.height = source.extent(1);
+		out.levels = mip_layout(block, out.width, out.height, 1, sources.size());
+		auto blocks = std::make_shared<std::vector<std::byte>>(out.levels.back().offset + out.levels.back().size);
+
+		// NOTE: The first level is most of the work, so levels run side by side with their rows spread out as well
+		std::atomic<bool> failed = false;
+		pool.parallel_for(sources.size(), [&](size_t i) {
+			if(!compress_blocks(block, *sources[i], std::span(*blocks).subspan(out.levels[i].offset, out.levels[i].size), pool))
+				failed = true;
+		});
+		for(auto& level: chain)
+			level.release();
+		if(failed) return {};
+
+		out.file = {blocks, *blocks};
+		return out;
+	}
+
+	// Khronos data format descriptor (with a single basic block) describing how the blocks are laid out
+	static std::vector<uint32_t> data_format_descriptor(block_format format) {
+		using family = block_format::family;
+		struct sample { uint32_t offset, length, channel, lower = 0, upper = UINT32_MAX; };
+		constexpr uint32_t alpha = 15, linear = 0x10, is_signed = 0x40, is_float = 0x80;
+		uint32_t model = 0;
+		std::vector<sample> samples;
+		switch(format.type) {
+			case family::RGBA8:
+				model = 1; // RGBSDA
+				samples = {{0, 8, 0, 0, 255}, {8, 8, 1, 0, 255}, {16, 8, 2, 0, 255}, {24, 8, alpha, 0, 255}};
+				break;
+			case family::BC1: model = 128; samples = {{0, 64, 0}}; break;
+			case family::BC2: model = 129; samples = {{0, 64, alpha}, {64, 64, 0}}; break;
+			case family::BC3: model = 130; samples = {{0, 64, alpha}, {64, 64, 0}}; break;
+			case family::BC4: model = 131; samples = {{0, 64, 0}}; break;
+			case family::BC5: model = 132; samples = {{0, 64, 0}, {64, 64, 1}}; break;
+			case family::BC6H: model = 133; samples = {{0, 128, 0 | is_float, format.is_signed ? 0xBF800000 : 0, 0x3F800000}}; break;
+			case family::BC7: model = 134; samples = {{0, 128, 0}}; break;
+			case family::ASTC: model = 162; samples = {{0, 128, 0}}; break;
+			default: break;
+		}
+		for(auto& sample: samples) {
+			if(format.srgb && sample.channel == alpha) sample.channel |= linear; // Alpha is never sRGB encoded
+			if(format.is_signed) {
+				sample.channel |= is_signed;
+				if(!(sample.channel & is_float)) sample.lower = 0x80000000, sample.upper = 0x7FFFFFFF;
+			}
+		}
+
+		uint32_t block_size = 24 + 16 * samples.size();
+		std::vector<uint32_t> out = {
+			4 + block_size, // Total size
+			0, // Khronos vendor, basic descriptor type
+			2 | block_size << 16, // Version 1.3
+			model | 1 << 8 | (format.srgb ? 2u : 1u) << 16, // BT.709 primaries, sRGB or linear transfer, straight alpha
+			uint32_t(format.block_width - 1) | uint32_t(format.block_height - 1) << 8,
+			uint32_t(format.bytes_per_block()), 0,
+		};
+		for(auto& sample: samples) {
+			out.push_back(sample.offset | (sample.length - 1) << 16 | sample.channel << 24);
+			out.push_back(0); // Sample position
+			out.push_back(sample.lower);
+			out.push_back(sample.upper);
+		}
+		return out;
+	}
+
+	std::vector<std::byte> compressed_image::serialize_ktx2() {
+		constexpr size_t header_size = 80, level_record_size = 24;
+		auto vk_format = to_vulkan_format(format);
+		if(vk_format == 0 || levels.empty()) {
+			get_error_handler()(stylizer::error_severity::Error, "Image can't be written as KTX2!", 0);
+			return {};
+		}
+
+		auto descriptor = data_format_descriptor(format);
+		size_t descriptor_offset = header_size + levels.size() * level_record_size, descriptor_size = descriptor.size() * sizeof(uint32_t);
+		// Levels are stored smallest first, each aligned to the lcm of the block size and 4
+		size_t alignment = std::max<size_t>(format.bytes_per_block(), 4);
+		std::vector<size_t> offsets(levels.size());
+		size_t offset = descriptor_offset + descriptor_size;
+		for(size_t i = levels.size(); i-- > 0; ) {
+			offset = (offset + alignment - 1) / alignment * alignment;
+			offsets[i] = offset;
+			offset += levels[i].size;
+		}
+
+		std::vector<std::byte> out(offset);
+		auto write = [&](size_t at, auto value) { std::memcpy(out.data() + at, &value, sizeof(value)); };
+		std::memcpy(out.data(), ktx2_identifier.data(), ktx2_identifier.size());
+		write(12, vk_format);
+		write(16, uint32_t(1)); // Type size
+		write(20, width);
+		write(24, height);
+		write(28, depth > 1 ? depth : 0u);
+		write(32, uint32_t(0)); // Layers
+		write(36, uint32_t(1)); // Faces
+		write(40, uint32_t(levels.size()));
+		write(44, uint32_t(0)); // No supercompression
+		write(48, uint32_t(descriptor_offset));
+		write(52, uint32_t(descriptor_size));
+		// The key/value data and supercompression global data (at 56 and 64) are left empty
+		for(size_t i = 0; i < levels.size(); ++i) {
+			size_t record = header_size + i * level_record_size;
+			write(record, uint64_t(offsets[i]));
+			write(record + 8, uint64_t(levels[i].size));
+			write(record + 16, uint64_t(levels[i].size));
+			std::memcpy(out.data() + offsets[i], level_data(i).data(), levels[i].size);
+		}
+		std::memcpy(out.data() + descriptor_offset, descriptor.data(), descriptor_size);
+		return out;
+	}
+
+	bool compressed_image::write_ktx2(const std::filesystem::path& output) {
+		auto data = serialize_ktx2();
+		if(data.empty()) return false;
+		std::ofstream out(output, std::ios::binary | std::ios::trunc);
+		if(!out) {
+			get_error_handler()(stylizer::error_severity::Error, "Failed to open `" + output.string() + "` for writing!", 0);
+			return false;
+		}
+		out.write((const char*)data.data(), data.size());
+		return bool(out);
+	}
+}}
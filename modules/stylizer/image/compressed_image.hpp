@@ -0,0 +1,67 @@
+#pragma once
+
+#include "block_compression.hpp"
+
+namespace stylizer { inline namespace images {
+
+	// A block compressed (or plain RGBA8) image stored in a KTX2 or DDS file, its blocks are views straight into the mapped file
+	// Uploading creates the texture in the stored format and writes every stored mip level, nothing is decoded on the CPU
+	// NOTE: extent(0/1/2) are the size in pixels while the byte grid is the first level's blocks (blocks wide x blocks high x depth x bytes per block)
+	// NOTE: Cube maps and texture arrays aren't supported
+	struct compressed_image : public image { STYLIZER_MOVE_AND_MAKE_OWNED_DERIVED_METHODS(compressed_image, image)
+		// What a container holds, found without touching the GPU
+		struct layout {
+			block_format format;
+			uint32_t width = 0, height = 0, depth = 1;
+			std::vector<block_level> levels; // The first level is the image itself, offsets are from the start of the file
+			uint32_t supercompression = 0; // KTX2 only, 0 (none) or 2 (zstd, levels are then the compressed ranges and sizes)
+			std::vector<size_t> uncompressed_sizes; // Of every level, only filled in when supercompressed
+		};
+
+		static bool is_ktx2(std::span<const std::byte> data);
+		static bool is_dds(std::span<const std::byte> data);
+		// Report an error and return nullopt if the file is malformed or holds something unsupported
+		static std::optional<layout> parse_ktx2(std::span<const std::byte> data);
+		static std::optional<layout> parse_dds(std::span<const std::byte> data);
+
+		file_cache::handle file; // Keeps the mapping alive
+		block_format format;
+		uint32_t width = 0, height = 0, depth = 1;
+		std::vector<block_level> levels;
+
+		texture::format get_format() override { return texture_format_of(format); }
+		byte_grid get_byte_grid() override { return {level_data(0).data(), format.blocks_wide(width), format.blocks_high(height), depth, format.bytes_per_block()}; }
+		size_t extent(size_t dimension) override {
+			switch(dimension) {
+				case 0: return width;
+				case 1: return height;
+				case 2: return depth;
+				default: return format.bytes_per_block();
+			}
+		}
+
+		std::span<std::byte> level_data(size_t level) { return file.span().subspan(levels[level].offset, levels[level].size); }
+		// RGBA8 copy of a level, for when the graphics API can't sample the stored format (only BC1-5 can be decoded)
+		maybe_owned<image> decompress(size_t level = 0);
+
+		// The stored levels are uploaded as is, nothing is generated
+		std::vector<maybe_owned<image>> get_mip_levels(thread_pool& pool = thread_pool::get_default()) override { return {}; }
+		// NOTE: mip_levels are ignored in favor of the stored levels
+		// NOTE: Falls back to uploading the decoded first level (and mips generated from it) if the graphics API doesn't support the format
+		texture& upload(context& ctx, texture& texture, std::span<image* const> mip_levels, texture::create_config config_template = {}, const std::optional<texture::sampler_config>& sampler_config = {}) override;
+		using image::upload;
+
+		// Parses either container (detected by its magic number), supercompressed levels are inflated into memory
+		static maybe_owned<image> load(file_cache::handle file);
+
+		// Block compresses an RGBA8 image (and the mip chain generate_mipmaps makes from it) on the CPU, levels and rows of blocks are spread across pool
+		// NOTE: Whether the blocks are sRGB follows the source's format (BC4/BC5 never are), returns nullopt if the image or format can't be encoded
+		static std::optional<compressed_image> compress(image& source, block_format::family format, bool mipmaps = true, thread_pool& pool = thread_pool::get_default());
+
+		// KTX2 container (without supercompression) holding every level, which load reads back in
+		std::vector<std::byte> serialize_ktx2();
+		bool write_ktx2(const std::filesystem::path& output);
+	};
+
+	maybe_owned<image> load_compressed_image_generic(context& ctx, std::span<std::byte> memory, std::string_view extension);
+}}
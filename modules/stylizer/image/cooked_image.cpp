@@ -0,0 +1,130 @@
+#include "cooked_image.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+namespace stylizer { inline namespace images {
+
+	std::vector<maybe_owned<image>> mapped_image::get_mip_levels(thread_pool& pool /* = thread_pool::get_default() */) {
+		if(levels.size() == 1) return image::get_mip_levels(pool); // Cooked without them
+		std::vector<maybe_owned<image>> out;
+		for(size_t i = 1; i < levels.size(); ++i) {
+			mapped_image level;
+			level.file = file;
+			level.format = format;
+			level.levels = {levels[i]};
+			out.emplace_back(level.move_to_owned());
+		}
+		return out;
+	}
+
+	std::vector<std::byte> cooked_image::serialize(std::span<image* const> levels) {
+		auto align = [](uint64_t offset) { return (offset + alignment - 1) & ~uint64_t(alignment - 1); };
+		if(levels.empty()) return {};
+
+		header header;
+		header.format = uint32_t(levels.front()->get_format());
+		header.level_count = levels.size();
+		header.levels_offset = sizeof(header);
+
+		std::vector<level_record> records(levels.size());
+		uint64_t offset = align(header.levels_offset + records.size() * sizeof(level_record));
+		for(size_t i = 0; i < levels.size(); ++i) {
+			auto& level = *levels[i];
+			if(level.get_format() != levels.front()->get_format())
+				get_error_handler()(stylizer::error_severity::Error, "Every level of a cooked image must have the same format!", 0);
+
+			auto& record = records[i];
+			record.width = level.extent(0);
+			record.height = level.extent(1);
+			record.depth = level.extent(2);
+			record.bytes_per_pixel = level.extent(3);
+			record.size = level.bytes_size();
+			record.offset = offset;
+			offset = align(offset + record.size);
+		}
+
+		std::vector<std::byte> out(offset);
+		std::memcpy(out.data(), &header, sizeof(header));
+		std::memcpy(out.data() + header.levels_offset, records.data(), records.size() * sizeof(level_record));
+		for(size_t i = 0; i < levels.size(); ++i)
+			std::memcpy(out.data() + records[i].offset, levels[i]->get_byte_grid().data_handle(), records[i].size);
+		return out;
+	}
+
+	bool cooked_image::write(const std::filesystem::path& output, std::span<image* const> levels) {
+		auto data = serialize(levels);
+		std::ofstream out(output, std::ios::binary | std::ios::trunc);
+		if(!out) {
+			get_error_handler()(stylizer::error_severity::Error, "Failed to open `" + output.string() + "` for writing!", 0);
+			return false;
+		}
+		out.write((const char*)data.data(), data.size());
+		return bool(out);
+	}
+
+	maybe_owned<image> cooked_image::load(file_cache::handle file) {
+		auto data = file.span();
+		auto fail = [](std::string_view message) {
+			get_error_handler()(stylizer::error_severity::Error, message, 0);
+			return maybe_owned<image>{};
+		};
+
+		if(data.size() < sizeof(header)) return fail("Not a cooked image, file is too small!");
+		auto& header = *(const struct header*)data.data();
+		if(header.magic != magic) return fail("Not a cooked image, magic number doesn't match!");
+		if(header.version != version) return fail("Unsupported cooked image version!");
+		if(header.level_count == 0 || header.levels_offset > data.size() || header.level_count > (data.size() - header.levels_offset) / sizeof(level_record))
+			return fail("Cooked image is truncated!");
+
+		mapped_image out;
+		out.file = file;
+		out.format = (texture::format)header.format;
+		std::span<const level_record> records((const level_record*)(data.data() + header.levels_offset), header.level_count);
+		for(auto& record: records) {
+			if(uint64_t(record.width) * record.height * record.depth * record.bytes_per_pixel != record.size || record.offset > data.size() || record.size > data.size() - record.offset)
+				return fail("Cooked image has an invalid level!");
+			out.levels.emplace_back(data.data() + record.offset, record.width, record.height, record.depth, record.bytes_per_pixel);
+		}
+		return out.move_to_owned();
+	}
+
+	maybe_owned<image> load_cooked_image_generic(context& ctx, std::span<std::byte> memory, std::string_view extension) {
+		auto file = get_file_cache().pin(memory);
+		if(!file) {
+			// Not backed by a cached mapping (eg a compressed asset pack entry), so the image gets its own copy
+			auto copy = std::make_shared<std::vector<std::byte>>(memory.begin(), memory.end());
+			file = {copy, *copy};
+		}
+		return cooked_image::load(std::move(file));
+	}
+
+	std::filesystem::path decoded_image_cache::default_directory() {
+		if(auto xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg)
+			return std::filesystem::path(xdg) / "stylizer" / "images";
+		if(auto home = std::getenv("HOME"); home && *home)
+			return std::filesystem::path(home) / ".cache" / "stylizer" / "images";
+		return std::filesystem::temp_directory_path() / "stylizer" / "images";
+	}
+
+	static std::mutex decoded_image_cache_mutex;
+	static std::shared_ptr<decoded_image_cache> enabled_decoded_image_cache;
+
+	decoded_image_cache& enable_decoded_image_cache(std::filesystem::path directory /* = decoded_image_cache::default_directory() */, bool mipmaps /* = false */) {
+		auto cache = std::make_shared<decoded_image_cache>(std::move(directory), mipmaps);
+		std::scoped_lock lock(decoded_image_cache_mutex);
+		enabled_decoded_image_cache = cache;
+		return *cache;
+	}
+
+	void disable_decoded_image_cache() {
+		std::scoped_lock lock(decoded_image_cache_mutex);
+		enabled_decoded_image_cache = nullptr;
+	}
+
+	std::shared_ptr<decoded_image_cache> get_decoded_image_cache() {
+		std::scoped_lock lock(decoded_image_cache_mutex);
+		return enabled_decoded_image_cache;
+	}
+}}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "api.hpp"
+
+#include <stylizer/core/util/shared_asset_cache.hpp>
+
+namespace stylizer { inline namespace images {
+
+	// An image whose pixels (and mip levels) are views straight into a mapped (cooked) file
+	// NOTE: The mapping is read only, copy the image before modifying it
+	struct mapped_image : public image { STYLIZER_MOVE_AND_MAKE_OWNED_DERIVED_METHODS(mapped_image, image)
+		file_cache::handle file; // Keeps the mapping alive
+		texture::format format;
+		std::vector<byte_grid> levels; // The first level is the image itself
+
+		texture::format get_format() override { return format; }
+		byte_grid get_byte_grid() override { return levels.front(); }
+		// The stored levels (sharing the mapping) rather than generated ones, if there are any
+		std::vector<maybe_owned<image>> get_mip_levels(thread_pool& pool = thread_pool::get_default()) override;
+	};
+
+	// Binary image format (.simg) holding already decoded pixels and their mip levels
+	// Layout (little endian):
+	//   header
+	//   level records
+	//   pixels of every level (rows stored one after another), each aligned to cooked_image::alignment
+	struct cooked_image {
+		constexpr static uint32_t magic = 0x474D4953; // "SIMG"
+		constexpr static uint32_t version = 1;
+		constexpr static uint32_t alignment = 64;
+
+		struct header {
+			uint32_t magic = cooked_image::magic;
+			uint32_t version = cooked_image::version;
+			uint32_t format = 0; // texture::format
+			uint32_t level_count = 0;
+			uint64_t levels_offset = 0;
+		};
+
+		struct level_record {
+			uint64_t offset = 0;
+			uint64_t size = 0;
+			uint32_t width = 0, height = 0, depth = 0;
+			uint32_t bytes_per_pixel = 0;
+		};
+
+		// NOTE: Every level must share the first level's format
+		static std::vector<std::byte> serialize(std::span<image* const> levels);
+		static bool write(const std::filesystem::path& output, std::span<image* const> levels);
+
+		static maybe_owned<image> load(file_cache::handle file);
+	};
+
+	// Persistent on disk cache of decoded images (as cooked images), keyed by the source file's bytes and whether mip levels are included
+	// Once enabled, image::load (and load_shared/load_shared_texture) map cache hits instead of decoding them, so only the first launch pays for decoding
+	// NOTE: When the shared asset cache is also enabled this one takes precedence, mappings of it are shared between processes through the page cache anyway
+	struct decoded_image_cache : public shared_asset_cache {
+		bool mipmaps = false; // Also generate (and store) every mip level
+
+		decoded_image_cache(std::filesystem::path directory = default_directory(), bool mipmaps = false) : shared_asset_cache(std::move(directory)), mipmaps(mipmaps) {}
+
+		// $XDG_CACHE_HOME/stylizer/images (falling back to ~/.cache and then the temp directory)
+		static std::filesystem::path default_directory();
+	};
+
+	decoded_image_cache& enable_decoded_image_cache(std::filesystem::path directory = decoded_image_cache::default_directory(), bool mipmaps = false);
+	void disable_decoded_image_cache();
+	std::shared_ptr<decoded_image_cache> get_decoded_image_cache();
+
+	maybe_owned<image> load_cooked_image_generic(context& ctx, std::span<std::byte> memory, std::string_view extension);
+}}
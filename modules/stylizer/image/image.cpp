@@ -1,39 +1,396 @@
 #include "api.hpp"
 
+#include "compressed_image.hpp"
+#include "cooked_image.hpp"
 #include "memory_image.hpp"
+#include "mipmap.hpp"
+
+#include <stylizer/core/util/asset_telemetry.hpp>
+#include <stylizer/core/util/hash.hpp>
+#include <stylizer/core/util/shared_asset_cache.hpp>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "thirdparty/stb_image.hpp"
 
+#include <cstdlib>
+#include <cstring>
+#include <unordered_set>
+#if defined(__SSSE3__)
+	#include <immintrin.h>
+#elif defined(__ARM_NEON)
+	#include <arm_neon.h>
+#endif
+
 namespace stylizer { inline namespace images {
-	std::unordered_map<std::string, std::function<maybe_owned<image>(context&, std::span<std::byte>, std::string_view)>>& image::get_loader_set() {
-		static std::unordered_map<std::string, std::function<maybe_owned<image>(context&, std::span<std::byte>, std::string_view)>> loaders = []{
-			std::unordered_map<std::string, std::function<maybe_owned<image>(context&, std::span<std::byte>, std::string_view)>> out;
-			out[".png"] = out[".jpg"] = out[".jpeg"] = out[".tga"] 
-				= out[".bmp"] = out[".psd"] = out[".pic"] = out[".pnm"] = load_stb_image_generic;
-			return out;
-		}();
+	loader_registry<image>& image::get_loader_set() {
+		static loader_registry<image> loaders = {
+			{".png", load_stb_image_generic},
+			{".jpg", load_stb_image_generic},
+			{".jpeg", load_stb_image_generic},
+			{".tga", load_stb_image_generic},
+			{".bmp", load_stb_image_generic},
+			{".psd", load_stb_image_generic},
+			{".pic", load_stb_image_generic},
+			{".pnm", load_stb_image_generic},
+			{".simg", load_cooked_image_generic},
+			{".ktx2", load_compressed_image_generic},
+			{".dds", load_compressed_image_generic},
+		};
 		return loaders;
 	}
+	// Formats which are mapped as is, caching them would only make a (worse) copy
+	static bool is_mapped_format(std::string_view extension) {
+		return extension == ".simg" || extension == ".ktx2" || extension == ".dds";
+	}
+
+	// Decodes memory with the registered loaders, going through the decoded image or shared asset cache (when enabled) so that later loads (in this or other processes) can map the result instead of decoding it again
+	static maybe_owned<image> decode_image(context& ctx, std::span<std::byte> memory, std::string_view extension) {
+		return asset_telemetry::measure_decode(memory, [&]() -> maybe_owned<image> {
+			std::shared_ptr<shared_asset_cache> cache = get_decoded_image_cache();
+			bool mipmaps = cache && static_cast<decoded_image_cache&>(*cache).mipmaps;
+			if(!cache) cache = get_shared_asset_cache();
+			if(!cache || is_mapped_format(extension)) return image::get_loader_set()(ctx, memory, extension);
+
+			auto key = shared_asset_cache::make_key(memory, mipmaps ? "image+linear-mipmaps" : "image", cooked_image::version);
+			if(auto found = cache->find(key))
+				return cooked_image::load(std::move(found));
+
+			auto decoded = image::get_loader_set()(ctx, memory, extension);
+			if(!decoded.value) return decoded;
+			std::vector<maybe_owned<image>> mips;
+			if(mipmaps) mips = generate_mipmaps(*decoded, mip_filter::Box, ctx.jobs());
+			std::vector<image*> levels = {&*decoded};
+			for(auto& mip: mips)
+				levels.push_back(&*mip);
+			auto published = cache->publish(key, cooked_image::serialize(levels));
+			for(auto& mip: mips)
+				mip.release();
+			if(!published) return decoded;
+
+			// Swap our private copy for the mapping
+			decoded.release();
+			return cooked_image::load(std::move(published));
+		});
+	}
+
+	std::vector<maybe_owned<image>> image::get_mip_levels(thread_pool& pool /* = thread_pool::get_default() */) {
+		return generate_mipmaps(*this, mip_filter::Box, pool);
+	}
+
+	// The mip levels upload writes for config, none unless it asks for more than one level
+	static std::vector<maybe_owned<image>> requested_mip_levels(context& ctx, image& image, const texture::create_config& config) {
+		size_t requested = config.mip_level_count;
+		if(requested <= 1) return {};
+
+		auto out = image.get_mip_levels(ctx.jobs());
+		for(; out.size() >= requested; out.pop_back())
+			out.back().release();
+		return out;
+	}
+
+	texture& image::upload(context& ctx, texture& texture, texture::create_config config_template /* = with_mip_levels() */, const std::optional<texture::sampler_config>& sampler_config /* = {} */) {
+		// NOTE: Generated before handing off to the context's owner, so the owner only has to copy them
+		auto mips = requested_mip_levels(ctx, *this, config_template);
+		std::vector<image*> levels;
+		for(auto& mip: mips)
+			levels.push_back(&*mip);
+
+		upload(ctx, texture, levels, config_template, sampler_config);
+		for(auto& mip: mips)
+			mip.release();
+		return texture;
+	}
+
+	texture& image::upload(context& ctx, texture& texture, std::span<image* const> mip_levels, texture::create_config config_template /* = {} */, const std::optional<texture::sampler_config>& sampler_config /* = {} */) {
+		if(get_format() == texture::format::Undefined) {
+			get_error_handler()(stylizer::error_severity::Error, "Can't upload an image whose format the graphics API doesn't have!", 0);
+			return texture;
+		}
+		if(!ctx.is_owner_thread()) { // GPU objects are only created by the context's owner
+			auto uploaded = ctx.run_on_owner([&] { upload(ctx, texture, mip_levels, config_template, sampler_config); });
+			ctx.wait(uploaded);
+			return texture;
+		}
+
+		stdmath::uint3 extents = {extent(0), extent(1), extent(2)};
+		config_template.mip_level_count = mip_levels.size() + 1;
+
+		auto current_size = texture ? texture.size() : stdmath::uint3{};
+		bool resized = current_size.x != extents.x || current_size.y != extents.y || current_size.z != extents.z;
+		if(!texture || texture.texture_format() != get_format() || resized || texture.mip_level_count() != config_template.mip_level_count) {
+			if(texture) texture.release();
+			config_template.format = get_format();
+			config_template.size = extents;
+			config_template.usage |= api::usage::CopyDestination;
+			texture = texture::create(ctx, config_template, sampler_config);
+		}
+
+		for(size_t i = 0; i <= mip_levels.size(); ++i) {
+			auto& level = i == 0 ? *this : *mip_levels[i - 1];
+			stdmath::uint3 level_extents = {level.extent(0), level.extent(1), level.extent(2)};
+			auto bytes_per_row = level_extents.x * level_extents.z * level.extent(3);
+			auto rows_per_image = level_extents.y;
+			texture.write(ctx, {level.get_byte_grid().data_handle(), bytes_per_row * rows_per_image}, {
+				.offset = 0,
+				.bytes_per_row = bytes_per_row,
+				.rows_per_image = rows_per_image
+			}, level_extents, stdmath::uint3{0, 0, 0}, i);
+		}
+		return texture;
+	}
+
 	maybe_owned<image> image::load(context& ctx, std::filesystem::path file) {
-		return load_file(ctx, file, get_loader_set()[file.extension().string()]);
+		asset_telemetry::scope measure(asset_telemetry::phase::Load, file);
+		return load_file(ctx, file, decode_image);
 	}
 
-	stylizer::dynamic_memory_image<stdmath::byte4> load_stb_image(context&, std::span<std::byte> memory, std::string_view extension /* = {} */) {
+	struct shared_image_cache {
+		std::mutex mutex;
+		std::unordered_map<uint64_t, maybe_owned<image>> images; // Only the ones asked for through load_shared
+		std::unordered_map<uint64_t, texture> textures; // Keyed on texture_key
+
+		static shared_image_cache& get() {
+			static shared_image_cache cache;
+			return cache;
+		}
+
+		// Reuses the shared decoded image if there is one, otherwise decodes memory (sharing the result if keep is set)
+		// NOTE: Shared images are returned unowned, the caller owns (and must release) images which aren't kept
+		// NOTE: Returns nullptr if the file couldn't be decoded, failures aren't cached so that fixing the file fixes the next load
+		maybe_owned<image> decode(context& ctx, std::span<std::byte> memory, const std::filesystem::path& file, uint64_t hash, bool keep) {
+			{
+				std::scoped_lock lock(mutex);
+				if(auto found = images.find(hash); found != images.end())
+					return found->second.value;
+			}
+
+			auto decoded = decode_image(ctx, memory, file.extension().string());
+			if(!decoded.value || decoded->bytes_size() == 0) { // Loaders report failures with an empty image (or none at all)
+				decoded.release();
+				return {};
+			}
+			if(!keep) return decoded;
+
+			std::scoped_lock lock(mutex);
+			auto [found, inserted] = images.try_emplace(hash, std::move(decoded));
+			if(!inserted) decoded.release(); // Someone else decoded the same image meanwhile, theirs wins
+			return found->second.value;
+		}
+
+		// The same image sampled differently needs its own texture
+		// NOTE: The sampler config is hashed bytewise, so at worst equal configs (with different padding) upload twice
+		static uint64_t texture_key(uint64_t hash, const std::optional<texture::sampler_config>& sampler_config) {
+			if(!sampler_config) return hash_combine(hash, 0);
+			return content_hash(std::as_bytes(std::span(&*sampler_config, 1)), hash);
+		}
+
+		texture* find_texture(uint64_t key) {
+			std::scoped_lock lock(mutex);
+			auto found = textures.find(key);
+			return found != textures.end() ? &found->second : nullptr;
+		}
+	};
+
+	image* image::load_shared(context& ctx, std::filesystem::path file) {
+		asset_telemetry::scope measure(asset_telemetry::phase::Load, file);
+		auto handle = load_file_handle(file, ctx.jobs());
+		return shared_image_cache::get().decode(ctx, handle.span(), file, content_hash(handle.span()), true).value;
+	}
+
+	texture& image::load_shared_texture(context& ctx, std::filesystem::path file, const std::optional<texture::sampler_config>& sampler_config /* = texture::sampler_config{} */) {
+		asset_telemetry::scope measure(asset_telemetry::phase::Load, file);
+		auto& cache = shared_image_cache::get();
+		auto handle = load_file_handle(file, ctx.jobs());
+		auto hash = content_hash(handle.span());
+		auto key = shared_image_cache::texture_key(hash, sampler_config);
+		if(auto found = cache.find_texture(key)) return *found;
+
+		// NOTE: The decoded image is dropped once its texture exists, so shared textures don't keep a second copy of themselves in memory
+		auto image = cache.decode(ctx, handle.span(), file, hash, false);
+		if(!image.value) { // Already reported, fall back to the default texture
+			auto fallback = ctx.run_on_owner([&] { return &texture::get_default_texture(ctx); });
+			return *ctx.wait(fallback);
+		}
+
+		// NOTE: Uploaded outside the lock, the upload may have to wait for the context's owner which could itself be waiting on the lock
+		auto uploaded = [&] {
+			asset_telemetry::scope measure(asset_telemetry::phase::Upload);
+			get_asset_telemetry().record_upload(image->bytes_size());
+			return image->upload(ctx, with_mip_levels(), sampler_config); // Shared textures are sampled by materials, so they get every level
+		}();
+		image.release();
+		std::scoped_lock lock(cache.mutex);
+		auto [found, inserted] = cache.textures.try_emplace(key, std::move(uploaded));
+		if(!inserted) uploaded.release(); // Someone else uploaded the same image meanwhile, theirs wins
+		return found->second;
+	}
+
+	std::vector<maybe_owned<image>> image::load_many(context& ctx, std::span<const std::filesystem::path> files) {
+		std::vector<maybe_owned<image>> out(files.size());
+		std::vector<std::exception_ptr> errors(files.size());
+		ctx.jobs().parallel_for(files.size(), [&](size_t i) {
+			try {
+				out[i] = load(ctx, files[i]);
+			} catch(...) { errors[i] = std::current_exception(); }
+		});
+
+		for(auto& error: errors)
+			if(error) {
+				for(auto& image: out)
+					image.release();
+				std::rethrow_exception(error);
+			}
+		return out;
+	}
+
+	std::vector<texture> image::upload_many(context& ctx, std::span<image* const> images, texture::create_config config_template /* = with_mip_levels() */, const std::optional<texture::sampler_config>& sampler_config /* = {} */) {
+		std::vector<texture> out(images.size());
+		// Mip levels are generated concurrently up front, leaving only the copies for the owner
+		std::vector<std::vector<maybe_owned<image>>> mips(images.size());
+		std::vector<std::vector<image*>> levels(images.size());
+		if(config_template.mip_level_count > 1)
+			ctx.jobs().parallel_for(images.size(), [&](size_t i) {
+				if(!images[i]) return;
+				mips[i] = requested_mip_levels(ctx, *images[i], config_template);
+				for(auto& mip: mips[i])
+					levels[i].push_back(&*mip);
+			});
+
+		auto upload_all = [&] {
+			for(size_t i = 0; i < images.size(); ++i)
+				if(images[i]) images[i]->upload(ctx, out[i], levels[i], config_template, sampler_config);
+		};
+
+		if(ctx.is_owner_thread()) upload_all();
+		else {
+			auto uploaded = ctx.run_on_owner(upload_all);
+			ctx.wait(uploaded);
+		}
+		for(auto& image_mips: mips)
+			for(auto& mip: image_mips)
+				mip.release();
+		return out;
+	}
+
+	std::vector<texture*> image::load_shared_textures(context& ctx, std::span<const std::filesystem::path> files, const std::optional<texture::sampler_config>& sampler_config /* = texture::sampler_config{} */) {
+		auto& cache = shared_image_cache::get();
+		std::vector<uint64_t> keys(files.size());
+		std::vector<maybe_owned<image>> images(files.size());
+		// Only the textures which aren't shared yet are decoded, once each
+		std::mutex claimed_mutex;
+		std::unordered_set<uint64_t> claimed;
+		ctx.jobs().parallel_for(files.size(), [&](size_t i) {
+			asset_telemetry::scope measure(asset_telemetry::phase::Load, files[i]);
+			auto handle = load_file_handle(files[i], ctx.jobs());
+			auto hash = content_hash(handle.span());
+			keys[i] = shared_image_cache::texture_key(hash, sampler_config);
+			if(cache.find_texture(keys[i])) return;
+			{
+				std::scoped_lock lock(claimed_mutex);
+				if(!claimed.insert(keys[i]).second) return;
+			}
+			images[i] = cache.decode(ctx, handle.span(), files[i], hash, false);
+		});
+
+		std::vector<image*> missing;
+		std::vector<uint64_t> missing_keys;
+		for(size_t i = 0; i < files.size(); ++i)
+			if(images[i].value) {
+				missing.push_back(images[i].value);
+				missing_keys.push_back(keys[i]);
+			}
+
+		// NOTE: Uploaded outside the lock, the upload may have to wait for the context's owner which could itself be waiting on the lock
+		auto uploaded = upload_many(ctx, missing, with_mip_levels(), sampler_config);
+		for(auto& image: images) // Not needed once their textures exist
+			image.release();
+		std::scoped_lock lock(cache.mutex);
+		for(size_t i = 0; i < uploaded.size(); ++i) {
+			auto [found, inserted] = cache.textures.try_emplace(missing_keys[i], std::move(uploaded[i]));
+			if(!inserted) uploaded[i].release(); // Someone else uploaded the same image meanwhile, theirs wins
+		}
+
+		// Files which failed to decode never got a texture
+		std::vector<texture*> out(files.size());
+		for(size_t i = 0; i < files.size(); ++i)
+			if(auto found = cache.textures.find(keys[i]); found != cache.textures.end())
+				out[i] = &found->second;
+		return out;
+	}
+
+	void image::clear_shared_cache() {
+		auto& cache = shared_image_cache::get();
+		std::scoped_lock lock(cache.mutex);
+		for(auto& [hash, image]: cache.images)
+			image.release();
+		for(auto& [hash, texture]: cache.textures)
+			texture.release();
+		cache.images.clear();
+		cache.textures.clear();
+	}
+
+	file_watcher::token image::watch_for_changes(context& ctx, std::filesystem::path file, texture& target, std::function<void(texture&)> on_reloaded /* = {} */) {
+		return file_watcher::get_default().poll_on_update(ctx).watch(file, [&ctx, &target, on_reloaded](const std::filesystem::path& file) {
+			auto reloaded = load(ctx, file);
+			if(!reloaded.value) return;
+			reloaded->upload(ctx, target, with_mip_levels()); // Keeps (and refreshes) the full chain the texture may have been created with
+			reloaded.release();
+			if(on_reloaded) on_reloaded(target);
+		});
+	}
+
+	// Expands count tightly packed grey, grey+alpha or RGB pixels into RGBA (alpha defaults to opaque)
+	static void expand_to_rgba(const uint8_t* in, uint8_t* out, size_t count, int channels) {
+		size_t i = 0;
+		if(channels == 3) {
+#if defined(__SSSE3__)
+			// Four pixels per step, the 16 byte loads read one pixel past the four being converted so the last few are left to the scalar loop
+			const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+			const __m128i alpha = _mm_set1_epi32(0xFF000000);
+			for(; i + 6 <= count; i += 4) {
+				__m128i rgb = _mm_loadu_si128((const __m128i*)(in + i * 3));
+				_mm_storeu_si128((__m128i*)(out + i * 4), _mm_or_si128(_mm_shuffle_epi8(rgb, shuffle), alpha));
+			}
+#elif defined(__ARM_NEON)
+			for(; i + 16 <= count; i += 16) {
+				uint8x16x3_t rgb = vld3q_u8(in + i * 3);
+				vst4q_u8(out + i * 4, uint8x16x4_t{{rgb.val[0], rgb.val[1], rgb.val[2], vdupq_n_u8(255)}});
+			}
+#endif
+			for(; i < count; ++i) {
+				out[i * 4 + 0] = in[i * 3 + 0];
+				out[i * 4 + 1] = in[i * 3 + 1];
+				out[i * 4 + 2] = in[i * 3 + 2];
+				out[i * 4 + 3] = 255;
+			}
+		} else for(; i < count; ++i) {
+			uint8_t grey = in[i * channels];
+			out[i * 4 + 0] = out[i * 4 + 1] = out[i * 4 + 2] = grey;
+			out[i * 4 + 3] = channels == 2 ? in[i * 2 + 1] : 255;
+		}
+	}
+
+	stylizer::adopted_memory_image<stdmath::byte4> load_stb_image(context&, std::span<std::byte> memory, std::string_view extension /* = {} */) {
+		using rgba8 = stylizer::adopted_memory_image<stdmath::byte4>;
+		// NOTE: Decoded in the file's own channel count, so there is only ever one full size RGBA buffer
 		int x, y, n;
-		auto data = stbi_load_from_memory((uint8_t*)memory.data(), memory.size(), &x, &y, &n, 4);
-		std::span<stdmath::byte4> span; std::vector<stdmath::byte4> tmp;
-		if(n == 4)
-			span = {(stdmath::byte4*)data, static_cast<size_t>(x * y)};
-		else if(n == 3) {
-			std::span<stdmath::byte3> span3 = {(stdmath::byte3*)data, static_cast<size_t>(x * y)};
-			tmp.reserve(span3.size());
-			for(auto& vec: span3)
-				tmp.emplace_back(vec, 1); // If there is no alpha data we set alpha to 1
-			span = tmp;
-		}
-
-		return {span, stylizer::dynamic_memory_image<uint8_t>::extents_t(x, y, 1)};
+		std::unique_ptr<std::byte, void(*)(void*)> data((std::byte*)stbi_load_from_memory((uint8_t*)memory.data(), memory.size(), &x, &y, &n, 0), stbi_image_free);
+		if(!data) {
+			get_error_handler()(stylizer::error_severity::Error, std::string("Failed to decode image: ") + stbi_failure_reason(), 0);
+			return {rgba8::extents_t(0, 0, 1)};
+		}
+
+		// RGBA is already laid out the way the image wants it, so stb's buffer is adopted as is
+		if(n == 4) return {std::move(data), rgba8::extents_t(x, y, 1)};
+
+		size_t pixels = size_t(x) * size_t(y);
+		std::unique_ptr<std::byte, void(*)(void*)> expanded((std::byte*)std::malloc(pixels * 4), std::free); // NOTE: Not zero filled, every byte is written below
+		if(!expanded) {
+			get_error_handler()(stylizer::error_severity::Error, "Failed to allocate memory for a decoded image!", 0);
+			return {rgba8::extents_t(0, 0, 1)};
+		}
+		expand_to_rgba((const uint8_t*)data.get(), (uint8_t*)expanded.get(), pixels, n);
+		return {std::move(expanded), rgba8::extents_t(x, y, 1)};
 	}
 
 	stylizer::maybe_owned<stylizer::image> load_stb_image_generic(context& ctx, std::span<std::byte> memory, std::string_view extension /* = {} */) {
@@ -3,6 +3,8 @@
 #include "api.hpp"
 #include <stylizer/core/api.hpp>
 
+#include <memory>
+
 namespace stylizer { inline namespace images {
 
 	template<typename Tcolor, size_t X, size_t Y, size_t Z = 1>
@@ -25,7 +27,7 @@ namespace stylizer { inline namespace images {
 		using pixel_grid = image::pixel_grid<Tcolor>;
 		texture::format format = default_texture_format_v<Tcolor>;
 
-		dynamic_memory_image(extents_t extents) : extents(extents) { data.resize(extents.extent(0) * extents.extent(1) * extents.extent(2)); }
+		dynamic_memory_image(extents_t extents) : extents(extents) { data.resize(extents.extent(0) * extents.extent(1) * extents.extent(2) * sizeof(Tcolor)); }
 		dynamic_memory_image(std::span<Tcolor> data, extents_t extents) : data((std::byte*)data.data(), ((std::byte*)data.data()) + data.size() * sizeof(Tcolor)), extents(extents) {
 			assert(data.size() * sizeof(data[0]) == bytes_size());
 		}
@@ -36,5 +38,25 @@ namespace stylizer { inline namespace images {
 		Tcolor& get_pixel(size_t x, size_t y, size_t z = 0) { return *(Tcolor*)get_pixel_bytes(x, y, z).data(); }
 	};
 
-	stylizer::dynamic_memory_image<stdmath::byte4> load_stb_image(context&, std::span<std::byte> memory, std::string_view extension = {});
+	// Pixels in a buffer allocated elsewhere (eg by a decoder), which is adopted as is (rather than copied) and freed through its deleter
+	template<typename Tcolor>
+	struct adopted_memory_image : public image { STYLIZER_MOVE_AND_MAKE_OWNED_DERIVED_METHODS(adopted_memory_image, image)
+		std::unique_ptr<std::byte, void(*)(void*)> data = {nullptr, nullptr};
+		using extents_t = typename dynamic_memory_image<Tcolor>::extents_t;
+		extents_t extents;
+		using pixel_grid = image::pixel_grid<Tcolor>;
+		texture::format format = default_texture_format_v<Tcolor>;
+
+		adopted_memory_image(extents_t extents) : extents(extents) {}
+		// NOTE: data must hold every pixel of extents
+		adopted_memory_image(std::unique_ptr<std::byte, void(*)(void*)> data, extents_t extents) : data(std::move(data)), extents(extents) {}
+
+		texture::format get_format() override { return format; }
+		byte_grid get_byte_grid() override { return byte_grid{data.get(), extents.extent(0), extents.extent(1), extents.extent(2), sizeof(Tcolor)}; }
+		pixel_grid get_pixel_grid() { return pixel_grid{(Tcolor*)data.get(), extents.extent(0), extents.extent(1), extents.extent(2)}; }
+		Tcolor& get_pixel(size_t x, size_t y, size_t z = 0) { return *(Tcolor*)get_pixel_bytes(x, y, z).data(); }
+	};
+
+	// NOTE: RGBA files keep the buffer stb decoded them into, anything else is expanded into a single RGBA buffer
+	stylizer::adopted_memory_image<stdmath::byte4> load_stb_image(context&, std::span<std::byte> memory, std::string_view extension = {});
 }}
\ No newline at end of file
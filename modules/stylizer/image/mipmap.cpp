@@ -0,0 +1,250 @@
+#include "mipmap.hpp"
+#include "block_compression.hpp"
+
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <numbers>
+#if defined(__AVX2__) || defined(__SSE2__)
+	#include <immintrin.h>
+#elif defined(__ARM_NEON)
+	#include <arm_neon.h>
+#endif
+
+namespace stylizer { inline namespace images {
+
+	// An image's pixels as linear RGBA floats, which is what the filters work in
+	struct linear_pixels {
+		std::vector<float> data;
+		size_t width = 0, height = 0, depth = 0;
+
+		float* row(size_t y, size_t z) { return data.data() + (z * height + y) * width * 4; }
+	};
+
+	static const std::array<float, 256>& srgb_to_linear_table() {
+		static const auto table = [] {
+			std::array<float, 256> out;
+			for(size_t i = 0; i < out.size(); ++i) {
+				float value = i / 255.f;
+				out[i] = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+			}
+			return out;
+		}();
+		return table;
+	}
+
+	// Indexed by linear values scaled to 16 bits, which is fine enough to round trip every sRGB byte
+	static const std::vector<uint8_t>& linear_to_srgb_table() {
+		static const auto table = [] {
+			std::vector<uint8_t> out(65536);
+			for(size_t i = 0; i < out.size(); ++i) {
+				float value = i / 65535.f;
+				value = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1 / 2.4f) - 0.055f;
+				out[i] = uint8_t(std::lround(std::clamp(value, 0.f, 1.f) * 255));
+			}
+			return out;
+		}();
+		return table;
+	}
+
+	// How the filters read (and write) an image's pixels, decided by its format (the pixel size alone can't tell RGBA8 from eg RG16 or R32F)
+	enum class pixel_layout { Unsupported, RGBA8, RGBA32 };
+	static pixel_layout layout_of(image& image) {
+		auto format = image.get_format();
+		if(format == texture::format::RGBA32 && image.extent(3) == sizeof(stdmath::float4))
+			return pixel_layout::RGBA32;
+		if((format == texture::format::RGBA8srgb || format == texture::format::RGBA8) && image.extent(3) == sizeof(stdmath::byte4))
+			return pixel_layout::RGBA8;
+		return pixel_layout::Unsupported;
+	}
+
+	static bool to_linear(image& source, linear_pixels& out) {
+		auto layout = layout_of(source);
+		if(layout == pixel_layout::Unsupported) {
+			get_error_handler()(stylizer::error_severity::Error, "Only RGBA8 and RGBA32 images can be downsampled!", 0);
+			return false;
+		}
+
+		out = {{}, source.extent(0), source.extent(1), source.extent(2)};
+		size_t count = out.width * out.height * out.depth;
+		out.data.resize(count * 4);
+		auto bytes = source.get_byte_grid().data_handle();
+		switch(layout) {
+		case pixel_layout::RGBA8: {
+			auto in = (const uint8_t*)bytes;
+			bool srgb = api::is_srgb(source.get_format());
+			auto& table = srgb_to_linear_table();
+			for(size_t i = 0; i < count * 4; ++i)
+				out.data[i] = srgb && i % 4 != 3 ? table[in[i]] : in[i] / 255.f; // Alpha is always linear
+			return true;
+		}
+		case pixel_layout::RGBA32:
+			std::memcpy(out.data.data(), bytes, count * sizeof(stdmath::float4));
+			return true;
+		default: return false;
+		}
+	}
+
+	// Back into the source's format (and color space)
+	static maybe_owned<image> from_linear(linear_pixels& pixels, image& like, thread_pool& pool) {
+		dynamic_memory_image<stdmath::byte4>::extents_t extents(pixels.width, pixels.height, pixels.depth);
+		if(layout_of(like) == pixel_layout::RGBA32) {
+			dynamic_memory_image<stdmath::float4> out(extents);
+			out.format = like.get_format();
+			std::memcpy(out.data.data(), pixels.data.data(), out.data.size());
+			return out.move_to_owned();
+		}
+
+		dynamic_memory_image<stdmath::byte4> out(extents);
+		out.format = like.get_format();
+		bool srgb = api::is_srgb(out.format);
+		auto& table = linear_to_srgb_table();
+		auto to = (uint8_t*)out.data.data();
+		size_t row_size = pixels.width * 4;
+		pool.parallel_for(pixels.height * pixels.depth, [&](size_t row) {
+			for(size_t i = row * row_size, end = i + row_size; i < end; ++i) {
+				float value = std::clamp(pixels.data[i], 0.f, 1.f); // The Kaiser filter's negative lobes can overshoot
+				to[i] = srgb && i % 4 != 3 ? table[size_t(value * 65535 + .5f)] : uint8_t(value * 255 + .5f);
+			}
+		});
+		return out.move_to_owned();
+	}
+
+	// Output pixel x is the weighted sum of input pixels 2x + offsets[tap] (clamped to the edges)
+	// NOTE: The box's taps only cover even sizes, see get_axis_taps
+	struct filter_taps {
+		std::vector<int> offsets;
+		std::vector<float> weights;
+	};
+
+	static const filter_taps& get_taps(mip_filter filter) {
+		static const filter_taps box = {{0, 1}, {.5f, .5f}};
+		static const filter_taps kaiser = [] {
+			// Windowed sinc at half the sampling rate, the window (alpha = 4) spans the 8 taps around the output pixel's center (2x + 1)
+			constexpr float alpha = 4, radius = 4;
+			auto bessel_i0 = [](float x) { // Series expansion of the zeroth order modified Bessel function
+				float sum = 1, term = 1;
+				for(int k = 1; k < 16; ++k) {
+					term *= (x / (2 * k)) * (x / (2 * k));
+					sum += term;
+				}
+				return sum;
+			};
+			filter_taps out;
+			float total = 0;
+			for(int offset = -3; offset <= 4; ++offset) {
+				float distance = offset + .5f - 1; // From the center of pixel 2x + offset to the output pixel's center
+				float x = std::numbers::pi_v<float> * distance / 2;
+				float sinc = distance == 0 ? 1 : std::sin(x) / x;
+				float window = bessel_i0(alpha * std::sqrt(std::max(1 - (distance / radius) * (distance / radius), 0.f))) / bessel_i0(alpha);
+				out.offsets.push_back(offset);
+				out.weights.push_back(sinc * window);
+				total += sinc * window;
+			}
+			for(auto& weight: out.weights)
+				weight /= total;
+			return out;
+		}();
+		return filter == mip_filter::Kaiser ? kaiser : box;
+	}
+
+	// out[i] += weight * in[i]
+	// NOTE: Whole rows go through the 8 wide path, single pixels (4 floats) through the 4 wide one
+	static void accumulate_row(float* out, const float* in, float weight, size_t count) {
+		size_t i = 0;
+#if defined(__AVX2__)
+		__m256 wide_scale = _mm256_set1_ps(weight);
+		for(; i + 8 <= count; i += 8)
+	#if defined(__FMA__)
+			_mm256_storeu_ps(out + i, _mm256_fmadd_ps(_mm256_loadu_ps(in + i), wide_scale, _mm256_loadu_ps(out + i)));
+	#else
+			_mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(out + i), _mm256_mul_ps(_mm256_loadu_ps(in + i), wide_scale)));
+	#endif
+#endif
+#if defined(__SSE2__)
+		__m128 scale = _mm_set1_ps(weight);
+		for(; i + 4 <= count; i += 4)
+			_mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(_mm_loadu_ps(in + i), scale)));
+#elif defined(__ARM_NEON)
+		float32x4_t scale = vdupq_n_f32(weight);
+		for(; i + 4 <= count; i += 4)
+			vst1q_f32(out + i, vmlaq_f32(vld1q_f32(out + i), vld1q_f32(in + i), scale));
+#endif
+		for(; i < count; ++i)
+			out[i] += weight * in[i];
+	}
+
+	// The input pixels (clamped to the edges) and weights that each output pixel along one axis is filtered from
+	struct axis_taps {
+		size_t per_pixel = 0;
+		std::vector<size_t> at; // per_pixel entries for each output pixel
+		std::vector<float> weights;
+	};
+
+	static axis_taps get_axis_taps(mip_filter filter, size_t in_size, size_t out_size) {
+		axis_taps out;
+		// NOTE: Odd sizes don't halve evenly, rather than dropping the last pixel the box spreads each output pixel over 3 inputs weighted by how much of each it covers
+		if(filter == mip_filter::Box && in_size > 1 && in_size % 2 == 1) {
+			out.per_pixel = 3;
+			float span = in_size;
+			for(size_t x = 0; x < out_size; ++x) {
+				out.at.insert(out.at.end(), {x * 2, x * 2 + 1, x * 2 + 2});
+				out.weights.insert(out.weights.end(), {(out_size - x) / span, out_size / span, (x + 1) / span});
+			}
+			return out;
+		}
+
+		auto& taps = get_taps(filter);
+		out.per_pixel = taps.offsets.size();
+		for(size_t x = 0; x < out_size; ++x)
+			for(size_t tap = 0; tap < taps.offsets.size(); ++tap) {
+				out.at.push_back(size_t(std::clamp<ptrdiff_t>(ptrdiff_t(x * 2) + taps.offsets[tap], 0, in_size - 1)));
+				out.weights.push_back(taps.weights[tap]);
+			}
+		return out;
+	}
+
+	// Filters horizontally then vertically, each pass with the rows spread across pool
+	static linear_pixels downsample(linear_pixels& in, mip_filter filter, thread_pool& pool) {
+		size_t width = std::max<size_t>(in.width / 2, 1), height = std::max<size_t>(in.height / 2, 1);
+		auto columns = get_axis_taps(filter, in.width, width), rows = get_axis_taps(filter, in.height, height);
+
+		linear_pixels horizontal{std::vector<float>(width * in.height * in.depth * 4), width, in.height, in.depth};
+		pool.parallel_for(in.height * in.depth, [&](size_t row) {
+			auto from = in.data.data() + row * in.width * 4;
+			auto to = horizontal.data.data() + row * width * 4;
+			for(size_t x = 0; x < width; ++x) {
+				float* pixel = to + x * 4;
+				for(size_t tap = x * columns.per_pixel, end = tap + columns.per_pixel; tap < end; ++tap)
+					accumulate_row(pixel, from + columns.at[tap] * 4, columns.weights[tap], 4);
+			}
+		});
+
+		linear_pixels out{std::vector<float>(width * height * in.depth * 4), width, height, in.depth};
+		pool.parallel_for(height * in.depth, [&](size_t row) {
+			size_t y = row % height, z = row / height;
+			for(size_t tap = y * rows.per_pixel, end = tap + rows.per_pixel; tap < end; ++tap)
+				accumulate_row(out.row(y, z), horizontal.row(rows.at[tap], z), rows.weights[tap], width * 4);
+		});
+		return out;
+	}
+
+	maybe_owned<image> downsample(image& source, mip_filter filter /* = mip_filter::Box */, thread_pool& pool /* = thread_pool::get_default() */) {
+		linear_pixels pixels;
+		if(!to_linear(source, pixels)) return {};
+		auto half = downsample(pixels, filter, pool);
+		return from_linear(half, source, pool);
+	}
+
+	std::vector<maybe_owned<image>> generate_mipmaps(image& source, mip_filter filter /* = mip_filter::Box */, thread_pool& pool /* = thread_pool::get_default() */) {
+		std::vector<maybe_owned<image>> out;
+		linear_pixels level;
+		if((source.extent(0) <= 1 && source.extent(1) <= 1) || !to_linear(source, level)) return out;
+
+		while(level.width > 1 || level.height > 1) {
+			level = downsample(level, filter, pool);
+			out.emplace_back(from_linear(level, source, pool));
+		}
+		return out;
+	}
+}}
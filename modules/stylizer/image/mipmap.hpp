@@ -0,0 +1,28 @@
+#pragma once
+
+#include "memory_image.hpp"
+
+#include <stylizer/core/util/thread_pool.hpp>
+
+#include <bit>
+
+namespace stylizer { inline namespace images {
+
+	enum class mip_filter {
+		Box, // Averages each 2x2 block (3 pixels weighted by coverage along odd sized axes), cheap but slightly blurry and prone to aliasing
+		Kaiser, // Kaiser windowed sinc (8 taps per axis), keeps the levels sharper
+	};
+
+	// Filters an RGBA8 or RGBA32 (float) image down to half its width and height (never going below 1), rows are spread across pool
+	// NOTE: Any other format (eg R32F or RG16) is reported as an error and returns null
+	// NOTE: sRGB images are filtered in linear space, and depth slices are filtered independently
+	maybe_owned<image> downsample(image& source, mip_filter filter = mip_filter::Box, thread_pool& pool = thread_pool::get_default());
+
+	// Returns every mip level below the image itself, down to 1x1
+	// NOTE: Levels are filtered from the (unquantized, linear) level above them rather than from their rounded bytes
+	std::vector<maybe_owned<image>> generate_mipmaps(image& source, mip_filter filter = mip_filter::Box, thread_pool& pool = thread_pool::get_default());
+
+	inline size_t mip_level_count(size_t width, size_t height) {
+		return std::bit_width(std::max(std::max<size_t>(width, height), size_t{1}));
+	}
+}}
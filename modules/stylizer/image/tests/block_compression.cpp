@@ -0,0 +1,154 @@
+#include <stylizer/core/tests/check.hpp>
+
+#include <stylizer/image/block_compression.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <optional>
+
+using namespace stylizer;
+using rgba8 = dynamic_memory_image<stdmath::byte4>;
+
+// Smooth gradients with some detail, alpha ramps unless opaque
+static rgba8 make_source(size_t width, size_t height, bool opaque) {
+	rgba8 out(rgba8::extents_t(width, height, 1));
+	out.format = texture::format::RGBA8srgb;
+	auto pixels = (uint8_t*)out.data.data();
+	for(size_t y = 0; y < height; ++y)
+		for(size_t x = 0; x < width; ++x) {
+			auto pixel = pixels + (y * width + x) * 4;
+			pixel[0] = uint8_t(std::lround(128 + 100 * std::sin(x * .2) * std::cos(y * .15)));
+			pixel[1] = uint8_t(x * 255 / width);
+			pixel[2] = uint8_t(y * 255 / height);
+			pixel[3] = opaque ? 255 : uint8_t((x + y) * 255 / (width + height));
+		}
+	return out;
+}
+
+// Peak signal to noise ratio (in dB) over the first channel_count channels
+static double psnr(rgba8& original, rgba8& decoded, size_t channel_count) {
+	auto a = (const uint8_t*)original.data.data(), b = (const uint8_t*)decoded.data.data();
+	double squared_error = 0;
+	size_t count = 0;
+	for(size_t i = 0; i < original.data.size(); ++i)
+		if(i % 4 < channel_count) {
+			double difference = double(a[i]) - double(b[i]);
+			squared_error += difference * difference;
+			++count;
+		}
+	if(squared_error == 0) return 100;
+	return 10 * std::log10(255.0 * 255.0 / (squared_error / count));
+}
+
+// Reads a BC7 block's fields, least significant bit first
+struct bit_reader {
+	const uint8_t* in;
+	size_t at = 0;
+
+	uint32_t read(size_t bits) {
+		uint32_t out = 0;
+		for(size_t i = 0; i < bits; ++i, ++at)
+			out |= uint32_t(in[at / 8] >> (at % 8) & 1) << i;
+		return out;
+	}
+};
+
+// Written from the BC7 spec independently of the encoder, fails on blocks in any other mode (the encoder only emits mode 6)
+static std::optional<rgba8> decode_bc7_mode6(std::span<const std::byte> blocks, size_t width, size_t height) {
+	constexpr uint8_t weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+	rgba8 out(rgba8::extents_t(width, height, 1));
+	auto pixels = (uint8_t*)out.data.data();
+	size_t blocks_wide = (width + 3) / 4, blocks_high = (height + 3) / 4;
+	if(blocks.size() < blocks_wide * blocks_high * 16) return {};
+	for(size_t by = 0; by < blocks_high; ++by)
+		for(size_t bx = 0; bx < blocks_wide; ++bx) {
+			bit_reader reader{(const uint8_t*)blocks.data() + (by * blocks_wide + bx) * 16};
+			size_t mode = 0; // Unary, the number of zeros before the first set bit
+			while(mode < 8 && reader.read(1) == 0) ++mode;
+			if(mode != 6) return {};
+
+			uint8_t endpoints[2][4];
+			for(size_t c = 0; c < 4; ++c)
+				for(size_t e = 0; e < 2; ++e)
+					endpoints[e][c] = reader.read(7);
+			uint8_t p_bits[2];
+			p_bits[0] = reader.read(1);
+			p_bits[1] = reader.read(1);
+			for(size_t i = 0; i < 16; ++i) {
+				auto index = reader.read(i == 0 ? 3 : 4); // The anchor index's top bit is implied zero
+				size_t x = bx * 4 + i % 4, y = by * 4 + i / 4;
+				if(x >= width || y >= height) continue;
+				for(size_t c = 0; c < 4; ++c) {
+					int e0 = endpoints[0][c] << 1 | p_bits[0], e1 = endpoints[1][c] << 1 | p_bits[1];
+					pixels[(y * width + x) * 4 + c] = ((64 - weights[index]) * e0 + weights[index] * e1 + 32) >> 6;
+				}
+			}
+			if(reader.at != 128) return {};
+		}
+	return out;
+}
+
+static double round_trip(block_format format, rgba8& source, size_t channel_count) {
+	size_t width = source.extent(0), height = source.extent(1);
+	std::vector<std::byte> blocks(format.level_size(width, height));
+	STYLIZER_CHECK(compress_blocks(format, source, blocks));
+	auto decoded = decompress_blocks(format, blocks, width, height);
+	STYLIZER_CHECK(decoded.has_value());
+	if(!decoded) return 0;
+	STYLIZER_CHECK(decoded->extent(0) == width && decoded->extent(1) == height);
+	return psnr(source, *decoded, channel_count);
+}
+
+int main() {
+	using family = block_format::family;
+	auto opaque = make_source(64, 64, true), translucent = make_source(64, 64, false);
+	// Odd sizes are padded out to whole blocks
+	auto odd = make_source(30, 18, false);
+
+	struct expectation { family type; rgba8& source; size_t channels; double minimum_psnr; };
+	expectation expectations[] = {
+		{family::BC1, opaque, 3, 30},
+		{family::BC3, translucent, 4, 32},
+		{family::BC3, odd, 4, 30}, // Steeper gradients
+		{family::BC4, translucent, 1, 40},
+		{family::BC5, translucent, 2, 40},
+	};
+	for(auto& [type, source, channels, minimum_psnr]: expectations) {
+		STYLIZER_CHECK(can_compress(block_format{type}) && can_decompress(block_format{type}));
+		auto measured = round_trip(block_format{type}, source, channels);
+		std::printf("BC%d %zux%zu: %.1f dB\n", int(type) - int(family::BC1) + 1, source.extent(0), source.extent(1), measured);
+		STYLIZER_CHECK(measured >= minimum_psnr);
+	}
+
+	{ // BC1 punches out pixels with alpha below half
+		auto source = make_source(8, 8, true);
+		auto pixels = (uint8_t*)source.data.data();
+		pixels[3] = 0;
+		std::vector<std::byte> blocks(block_format{family::BC1}.level_size(8, 8));
+		STYLIZER_CHECK(compress_blocks(block_format{family::BC1}, source, blocks));
+		auto decoded = decompress_blocks(block_format{family::BC1}, blocks, 8, 8);
+		STYLIZER_CHECK(decoded && ((uint8_t*)decoded->data.data())[3] == 0 && ((uint8_t*)decoded->data.data())[7] == 255);
+	}
+
+	{ // BC7 can't be decoded on the CPU, so its blocks are checked with the mode 6 decoder above
+		STYLIZER_CHECK(can_compress(block_format{family::BC7}) && !can_decompress(block_format{family::BC7}));
+		for(auto source: {&opaque, &translucent}) {
+			size_t width = source->extent(0), height = source->extent(1);
+			std::vector<std::byte> blocks(block_format{family::BC7}.level_size(width, height));
+			STYLIZER_CHECK(compress_blocks(block_format{family::BC7}, *source, blocks));
+			auto decoded = decode_bc7_mode6(blocks, width, height);
+			STYLIZER_CHECK(decoded.has_value());
+			if(!decoded) continue;
+			auto measured = psnr(*source, *decoded, 4);
+			std::printf("BC7 %zux%zu: %.1f dB\n", width, height, measured);
+			STYLIZER_CHECK(measured >= 38);
+		}
+	}
+
+	// Signed formats (and BC6H) can't be encoded
+	STYLIZER_CHECK(!can_compress(block_format{family::BC4, 4, 4, false, true}));
+	STYLIZER_CHECK(!can_compress(block_format{family::BC6H}));
+
+	return tests::result();
+}
@@ -0,0 +1,176 @@
+#include <stylizer/core/tests/check.hpp>
+
+#include <stylizer/image/compressed_image.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+
+using namespace stylizer;
+
+// Writes value at offset (growing data as needed)
+template<typename T>
+static void put(std::vector<std::byte>& data, size_t offset, T value) {
+	if(data.size() < offset + sizeof(value)) data.resize(offset + sizeof(value));
+	std::memcpy(data.data() + offset, &value, sizeof(value));
+}
+
+static std::vector<std::byte> make_ktx2(uint32_t vk_format, uint32_t width, uint32_t height, std::span<const std::pair<uint64_t, uint64_t>> levels, uint32_t faces = 1) {
+	std::vector<std::byte> out;
+	const uint8_t identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+	for(size_t i = 0; i < 12; ++i)
+		put(out, i, identifier[i]);
+	put(out, 12, vk_format);
+	put(out, 20, width);
+	put(out, 24, height);
+	put(out, 36, faces);
+	put(out, 40, uint32_t(levels.size()));
+	for(size_t i = 0; i < levels.size(); ++i) {
+		put(out, 80 + i * 24, levels[i].first);
+		put(out, 80 + i * 24 + 8, levels[i].second);
+		put(out, 80 + i * 24 + 16, levels[i].second);
+		out.resize(std::max<size_t>(out.size(), levels[i].first + levels[i].second));
+	}
+	return out;
+}
+
+static std::vector<std::byte> make_dds(uint32_t width, uint32_t height, uint32_t level_count, uint32_t pixel_flags, uint32_t four_cc, size_t data_size) {
+	std::vector<std::byte> out;
+	put(out, 0, uint32_t(0x20534444)); // "DDS "
+	put(out, 4, uint32_t(124));
+	put(out, 8, uint32_t(0x1007 | (level_count > 1 ? 0x20000 : 0)));
+	put(out, 12, height);
+	put(out, 16, width);
+	put(out, 28, level_count);
+	put(out, 76, uint32_t(32));
+	put(out, 80, pixel_flags);
+	put(out, 84, four_cc);
+	out.resize(4 + 124 + data_size);
+	return out;
+}
+
+int main() {
+	int errors = 0;
+	auto connection = get_error_handler().connect([&](auto, auto, auto) { ++errors; });
+	using family = block_format::family;
+
+	{ // Mip chains halve down to 1, padded out to whole blocks
+		auto levels = mip_layout({family::BC1}, 13, 7, 1, 4, 128);
+		STYLIZER_CHECK(levels.size() == 4);
+		STYLIZER_CHECK(levels[0].size == 4 * 2 * 8 && levels[0].offset == 128);
+		STYLIZER_CHECK(levels[1].width == 6 && levels[1].height == 3 && levels[1].size == 2 * 1 * 8 && levels[1].offset == 192);
+		STYLIZER_CHECK(levels[2].width == 3 && levels[2].height == 1 && levels[2].size == 8 && levels[2].offset == 208);
+		STYLIZER_CHECK(levels[3].width == 1 && levels[3].height == 1 && levels[3].offset == 216);
+		STYLIZER_CHECK((block_format{family::RGBA8, 1, 1}.level_size(5, 3)) == 5 * 3 * 4);
+	}
+
+	{ // KTX2, levels stored smallest first
+		std::pair<uint64_t, uint64_t> levels[] = {{144, 64}, {128, 16}};
+		auto data = make_ktx2(138, 8, 8, levels); // VK_FORMAT_BC3_SRGB_BLOCK
+		STYLIZER_CHECK(compressed_image::is_ktx2(data) && !compressed_image::is_dds(data));
+		auto parsed = compressed_image::parse_ktx2(data);
+		STYLIZER_CHECK(parsed.has_value());
+		if(parsed) {
+			STYLIZER_CHECK(parsed->format == (block_format{family::BC3, 4, 4, true}));
+			STYLIZER_CHECK(parsed->width == 8 && parsed->height == 8 && parsed->depth == 1);
+			STYLIZER_CHECK(parsed->levels.size() == 2);
+			STYLIZER_CHECK(parsed->levels[0].offset == 144 && parsed->levels[0].size == 64);
+			STYLIZER_CHECK(parsed->levels[1].offset == 128 && parsed->levels[1].size == 16 && parsed->levels[1].width == 4);
+		}
+
+		errors = 0;
+		auto truncated = data;
+		truncated.pop_back();
+		STYLIZER_CHECK(!compressed_image::parse_ktx2(truncated) && errors == 1);
+		std::pair<uint64_t, uint64_t> wrong_size[] = {{144, 48}, {128, 16}};
+		STYLIZER_CHECK(!compressed_image::parse_ktx2(make_ktx2(138, 8, 8, wrong_size)) && errors == 2);
+		STYLIZER_CHECK(!compressed_image::parse_ktx2(make_ktx2(138, 8, 8, levels, 6)) && errors == 3); // Cube map
+		STYLIZER_CHECK(!compressed_image::parse_ktx2(make_ktx2(1000, 8, 8, levels)) && errors == 4); // Unknown format
+	}
+
+	{ // DDS with a legacy four character code and a mip chain
+		auto data = make_dds(16, 8, 3, 0x4, 0x31545844, 64 + 16 + 8); // "DXT1"
+		STYLIZER_CHECK(compressed_image::is_dds(data) && !compressed_image::is_ktx2(data));
+		auto parsed = compressed_image::parse_dds(data);
+		STYLIZER_CHECK(parsed.has_value());
+		if(parsed) {
+			STYLIZER_CHECK(parsed->format == block_format{family::BC1});
+			STYLIZER_CHECK(parsed->width == 16 && parsed->height == 8);
+			STYLIZER_CHECK(parsed->levels.size() == 3);
+			STYLIZER_CHECK(parsed->levels[0].offset == 128 && parsed->levels[0].size == 64);
+			STYLIZER_CHECK(parsed->levels[2].offset == 208 && parsed->levels[2].size == 8);
+		}
+
+		errors = 0;
+		data.pop_back();
+		STYLIZER_CHECK(!compressed_image::parse_dds(data) && errors == 1);
+	}
+
+	{ // DDS with a DX10 header
+		auto data = make_dds(4, 4, 1, 0x4, 0x30315844, 20 + 16); // "DX10"
+		put(data, 128, uint32_t(99)); // DXGI_FORMAT_BC7_UNORM_SRGB
+		auto parsed = compressed_image::parse_dds(data);
+		STYLIZER_CHECK(parsed && parsed->format == (block_format{family::BC7, 4, 4, true}));
+		STYLIZER_CHECK(parsed && parsed->levels.size() == 1 && parsed->levels[0].offset == 148 && parsed->levels[0].size == 16);
+	}
+
+	{ // Uncompressed RGBA8 DDS
+		auto data = make_dds(3, 2, 1, 0x41, 0, 3 * 2 * 4);
+		put(data, 88, uint32_t(32));
+		put(data, 92, uint32_t(0xFF));
+		put(data, 96, uint32_t(0xFF00));
+		put(data, 100, uint32_t(0xFF0000));
+		auto parsed = compressed_image::parse_dds(data);
+		STYLIZER_CHECK(parsed && parsed->format == (block_format{family::RGBA8, 1, 1}));
+		STYLIZER_CHECK(parsed && parsed->levels[0].size == 3 * 2 * 4);
+	}
+
+	{ // A DDS written back out as KTX2 keeps its levels
+		auto dds = std::make_shared<std::vector<std::byte>>(make_dds(16, 8, 3, 0x4, 0x31545844, 64 + 16 + 8));
+		for(size_t i = 128; i < dds->size(); ++i)
+			(*dds)[i] = std::byte(i * 7);
+		auto loaded = compressed_image::load({dds, *dds});
+		STYLIZER_CHECK(loaded.value != nullptr);
+		if(loaded.value) {
+			auto& image = static_cast<compressed_image&>(*loaded);
+			auto ktx2 = image.serialize_ktx2();
+			auto parsed = compressed_image::parse_ktx2(ktx2);
+			STYLIZER_CHECK(parsed && parsed->levels.size() == 3 && parsed->format == block_format{family::BC1});
+			if(parsed)
+				for(size_t i = 0; i < parsed->levels.size(); ++i) {
+					auto original = image.level_data(i);
+					auto written = std::span(ktx2).subspan(parsed->levels[i].offset, parsed->levels[i].size);
+					STYLIZER_CHECK(std::equal(original.begin(), original.end(), written.begin(), written.end()));
+				}
+			loaded.release();
+		}
+	}
+
+	{ // Channel formats the GPU might not sample fall back to a CPU decode tagged with the API's unorm RGBA8
+		dynamic_memory_image<stdmath::byte4> source(dynamic_memory_image<stdmath::byte4>::extents_t(8, 8, 1));
+		source.format = texture::format::RGBA8;
+		for(auto& pixel: source.data)
+			pixel = {200, 60, 0, 255};
+		auto near = [](stdmath::byte4 a, stdmath::byte4 b) {
+			for(size_t i = 0; i < 4; ++i)
+				if(std::abs(int(a[i]) - int(b[i])) > 1) return false;
+			return true;
+		};
+		for(auto [format, expected]: {std::pair{family::BC4, stdmath::byte4{200, 200, 200, 255}}, std::pair{family::BC5, stdmath::byte4{200, 60, 0, 255}}}) {
+			errors = 0;
+			auto compressed = compressed_image::compress(source, format, false);
+			STYLIZER_CHECK(compressed && compressed->format.type == format);
+			if(!compressed) continue;
+			auto decoded = compressed->decompress(0);
+			STYLIZER_CHECK(decoded.value != nullptr && errors == 0);
+			if(!decoded.value) continue;
+			STYLIZER_CHECK(decoded->get_format() == texture::format::RGBA8);
+			auto& pixels = static_cast<dynamic_memory_image<stdmath::byte4>&>(*decoded);
+			STYLIZER_CHECK(pixels.data.size() == 64 && std::all_of(pixels.data.begin(), pixels.data.end(), [&](auto pixel) { return near(pixel, expected); }));
+			decoded.release();
+		}
+	}
+
+	return tests::result();
+}
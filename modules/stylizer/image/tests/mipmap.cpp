@@ -0,0 +1,113 @@
+#include <stylizer/core/tests/check.hpp>
+
+#include <stylizer/image/mipmap.hpp>
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+using namespace stylizer;
+using rgba8 = dynamic_memory_image<stdmath::byte4>;
+
+static const uint8_t* pixels(image& image) { return (const uint8_t*)image.get_byte_grid().data_handle(); }
+
+int main() {
+	int errors = 0;
+	auto connection = get_error_handler().connect([&](auto, auto, auto) { ++errors; });
+	thread_pool pool(4);
+
+	{ // Every level halves (never going below 1) down to 1x1
+		STYLIZER_CHECK(mip_level_count(18, 2) == 5 && mip_level_count(1, 1) == 1 && mip_level_count(256, 3) == 9);
+		rgba8 source(rgba8::extents_t(18, 2, 1));
+		auto chain = generate_mipmaps(source, mip_filter::Box, pool);
+		size_t expected[][2] = {{9, 1}, {4, 1}, {2, 1}, {1, 1}};
+		STYLIZER_CHECK(chain.size() == 4);
+		for(size_t i = 0; i < std::min<size_t>(chain.size(), 4); ++i) {
+			STYLIZER_CHECK(chain[i]->extent(0) == expected[i][0] && chain[i]->extent(1) == expected[i][1]);
+			STYLIZER_CHECK(chain[i]->get_format() == source.get_format());
+		}
+		for(auto& level: chain)
+			level.release();
+	}
+
+	{ // A black and white checker averages to half the light, which is 188 in sRGB (and 128 when linear)
+		rgba8 checker(rgba8::extents_t(2, 2, 1));
+		const uint8_t values[16] = {0, 0, 0, 0, 255, 255, 255, 255, 255, 255, 255, 255, 0, 0, 0, 0};
+		std::memcpy(checker.data.data(), values, sizeof(values));
+
+		checker.format = texture::format::RGBA8srgb;
+		auto srgb = downsample(checker, mip_filter::Box, pool);
+		STYLIZER_CHECK(srgb.value && pixels(*srgb)[0] == 188 && pixels(*srgb)[3] == 128); // Alpha is always linear
+		srgb.release();
+
+		checker.format = texture::format::RGBA8;
+		auto linear = downsample(checker, mip_filter::Box, pool);
+		STYLIZER_CHECK(linear.value && pixels(*linear)[0] == 128);
+		linear.release();
+	}
+
+	{ // sRGB bytes survive the trip through linear space
+		rgba8 flat(rgba8::extents_t(2, 2, 1));
+		bool exact = true;
+		for(int value = 0; value < 256; ++value) {
+			std::memset(flat.data.data(), value, flat.data.size());
+			auto half = downsample(flat, mip_filter::Box, pool);
+			exact &= half.value && pixels(*half)[0] == value;
+			half.release();
+		}
+		STYLIZER_CHECK(exact);
+	}
+
+	{ // The Kaiser filter keeps constant images constant, even with odd sizes
+		rgba8 constant(rgba8::extents_t(37, 5, 1));
+		std::memset(constant.data.data(), 77, constant.data.size());
+		auto chain = generate_mipmaps(constant, mip_filter::Kaiser, pool);
+		bool unchanged = !chain.empty();
+		for(auto& level: chain) {
+			for(size_t i = 0; i < level->bytes_size(); ++i)
+				unchanged &= pixels(*level)[i] == 77;
+			level.release();
+		}
+		STYLIZER_CHECK(unchanged);
+	}
+
+	{ // Floats are averaged as is
+		dynamic_memory_image<stdmath::float4> floats(dynamic_memory_image<stdmath::float4>::extents_t(4, 2, 1));
+		auto data = (float*)floats.data.data();
+		for(int i = 0; i < 32; ++i) data[i] = i;
+		auto half = downsample(floats, mip_filter::Box, pool);
+		STYLIZER_CHECK(half.value && half->extent(0) == 2 && half->extent(1) == 1);
+		if(half.value) {
+			auto out = (const float*)pixels(*half);
+			STYLIZER_CHECK(out[0] == (0 + 4 + 16 + 20) / 4.f && out[4] == (8 + 12 + 24 + 28) / 4.f);
+		}
+		half.release();
+	}
+
+	{ // The box covers odd sizes with 3 taps, so the last column (and row) isn't dropped
+		dynamic_memory_image<stdmath::float4> floats(dynamic_memory_image<stdmath::float4>::extents_t(5, 3, 1));
+		auto data = (float*)floats.data.data();
+		for(size_t y = 0; y < 3; ++y)
+			for(size_t x = 0; x < 5; ++x)
+				for(size_t c = 0; c < 4; ++c)
+					data[(y * 5 + x) * 4 + c] = x + y * 10;
+		auto half = downsample(floats, mip_filter::Box, pool);
+		STYLIZER_CHECK(half.value && half->extent(0) == 2 && half->extent(1) == 1);
+		if(half.value) {
+			auto out = (const float*)pixels(*half);
+			// Columns are weighted 2/5, 2/5, 1/5 then 1/5, 2/5, 2/5 and the 3 rows evenly
+			STYLIZER_CHECK(std::abs(out[0] - (.8f + 10)) < 1e-4f && std::abs(out[4] - (3.2f + 10)) < 1e-4f);
+		}
+		half.release();
+	}
+
+	{ // Formats the filters don't understand are reported rather than filtered as if they were RGBA8
+		rgba8 depth(rgba8::extents_t(4, 4, 1));
+		depth.format = texture::format::Depth_u24;
+		errors = 0;
+		auto half = downsample(depth, mip_filter::Box, pool);
+		STYLIZER_CHECK(!half.value && errors == 1);
+	}
+
+	return tests::result();
+}
@@ -4,7 +4,9 @@
 
 #include <stylizer/core/api.hpp>
 #include <stylizer/core/flat_material.hpp>
+#include <stylizer/core/util/file_watcher.hpp>
 #include <stylizer/core/util/load_file.hpp>
+#include <stylizer/core/util/loader_registry.hpp>
 #include <stylizer/core/util/maybe_owned.hpp>
 
 #include <unordered_map>
@@ -77,6 +79,8 @@ namespace stylizer { inline namespace models {
 			std::span<uint32_t> indicies;
 		};
 		virtual std::optional<std::span<meshlet>> meshlets_view() = 0;
+		// Whether the mesh is split into meshlets (rather than just the single implicit one covering all of its index data)
+		bool has_explicit_meshlets();
 
 		api::current_backend::buffer index_buffer = {};
         virtual api::current_backend::buffer* get_index_buffer(context& ctx, bool rebuild = false);
@@ -84,6 +88,17 @@ namespace stylizer { inline namespace models {
 		std::unordered_map<size_t, std::vector<api::current_backend::buffer>> vertex_buffer_cache;
 		virtual std::span<api::current_backend::buffer> get_vertex_buffers(context& ctx, std::span<const size_t> attribute_indicies, bool rebuild = false);
 
+		virtual ~mesh() = default;
+
+		// Frees the GPU buffers (called by maybe_owned::release before an owned mesh is deleted)
+		virtual void release() {
+			index_buffer.release();
+			for(auto& [attributes, buffers]: vertex_buffer_cache)
+				for(auto& buffer: buffers)
+					buffer.release();
+			vertex_buffer_cache.clear();
+		}
+
 		virtual void rebuild_gpu_caches(context& ctx) {
 			get_index_buffer(ctx, true);
 			vertex_buffer_cache.clear();
@@ -105,12 +120,36 @@ namespace stylizer { inline namespace models {
 
     struct model : public std::vector<std::pair<maybe_owned<mesh>, maybe_owned<material>>> { STYLIZER_MOVE_AND_MAKE_OWNED_METHODS(model)
 
-		static std::unordered_map<std::string, std::function<maybe_owned<model>(context&, std::span<std::byte>, std::string_view)>>& get_loader_set();
+		static loader_registry<model>& get_loader_set();
 		static maybe_owned<model> load(context& ctx, std::filesystem::path file);
+		// Content addressed: files with identical bytes are loaded and uploaded once, the returned model refers to the shared meshes and materials
+		// NOTE: The shared meshes and materials stay alive until clear_shared_cache is called
+		// NOTE: Materials are created for fb's attachment formats, so frame buffers with the same formats share a copy of the model
+		static model load_shared(context& ctx, std::filesystem::path file, const frame_buffer& fb);
+		static void clear_shared_cache();
 
 		model& override_materials(material& override_material);
 		model& upload(context& ctx, const frame_buffer& fb);
 
+		// Textures loaded on behalf of a material, filled in by loaders so that hot reloading can update just the material
+		struct texture_dependency {
+			std::filesystem::path file;
+			flat_material* material;
+		};
+		std::vector<texture_dependency> texture_dependencies;
+		std::vector<file_watcher::token> hot_reload_tokens;
+
+		// Reloads (and reuploads) the model whenever file changes and just the affected material when one of its textures changes
+		// NOTE: The model should not be moved after calling this, and ctx and fb must outlive it
+		model& watch_for_changes(context& ctx, std::filesystem::path file, const frame_buffer& fb);
+
+		// What draw_instanced asks the render pass to draw for a mesh
+		struct draw_call {
+			bool indexed;
+			size_t count, instance_count;
+		};
+		static draw_call draw_call_for(mesh& mesh, size_t instance_count);
+
 		api::current_backend::render::pass& draw_instanced(
 			context& ctx, api::current_backend::render::pass& render_pass,
 			instance_data::buffer_base& instance_data, std::optional<utility_buffer> util = {}
@@ -121,4 +160,9 @@ namespace stylizer { inline namespace models {
     };
 
 	maybe_owned<model> load_tinyobj_model_generic(stylizer::context& ctx, std::span<std::byte> memory, std::string_view extension);
+	// Handles both .gltf (with external or embedded buffers) and .glb files, float attributes stay views into the (mapped) buffers
+	maybe_owned<model> load_gltf_model_generic(stylizer::context& ctx, std::span<std::byte> memory, std::string_view extension);
+	// Binary only, PLYs without faces become point clouds and STL vertices are welded while loading
+	maybe_owned<model> load_ply_model_generic(stylizer::context& ctx, std::span<std::byte> memory, std::string_view extension);
+	maybe_owned<model> load_stl_model_generic(stylizer::context& ctx, std::span<std::byte> memory, std::string_view extension);
 }}
\ No newline at end of file
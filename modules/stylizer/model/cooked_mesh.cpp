@@ -0,0 +1,368 @@
+#include "cooked_mesh.hpp"
+
+#include <stylizer/image/api.hpp>
+
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <numeric>
+
+namespace stylizer { inline namespace models {
+
+	template<size_t... I>
+	static mesh::vertex_storage make_storage(size_t format, std::index_sequence<I...>) {
+		mesh::vertex_storage out;
+		((format == I ? (out = mesh::vertex_storage(std::in_place_index<I>), true) : false) || ...);
+		return out;
+	}
+	// Creates an empty storage of the type at format in vertex_storage_variant
+	static mesh::vertex_storage make_storage(size_t format) {
+		return make_storage(format, std::make_index_sequence<std::variant_size_v<mesh::vertex_storage_variant>>{});
+	}
+
+	template<typename T> struct storage_element;
+	template<typename T> struct storage_element<storage<T>> { using type = T; };
+
+	template<size_t... I>
+	static size_t element_alignment(size_t format, std::index_sequence<I...>) {
+		size_t out = 1;
+		((format == I ? (out = alignof(typename storage_element<std::variant_alternative_t<I, mesh::vertex_storage_variant>>::type), true) : false) || ...);
+		return out;
+	}
+	// The alignment of the element type at format in vertex_storage_variant
+	static size_t element_alignment(size_t format) {
+		return element_alignment(format, std::make_index_sequence<std::variant_size_v<mesh::vertex_storage_variant>>{});
+	}
+
+	template<typename T, size_t I = 0>
+	constexpr size_t format_of() {
+		if constexpr(std::is_same_v<std::variant_alternative_t<I, mesh::vertex_storage_variant>, storage<T>>)
+			return I;
+		else return format_of<T, I + 1>();
+	}
+
+	std::optional<size_t> mapped_mesh::lookup_attribute(std::string_view name) {
+		for(size_t i = 0; i < attributes.size(); ++i)
+			if(attributes[i].name == name)
+				return i;
+		return {};
+	}
+
+	std::span<std::string_view> mapped_mesh::available_attributes() {
+		names_cache.clear();
+		for(auto& attribute: attributes)
+			names_cache.push_back(attribute.name);
+		return names_cache;
+	}
+
+	std::span<size_t> mapped_mesh::attribute_indicies() {
+		indicies_cache.resize(attributes.size());
+		std::iota(indicies_cache.begin(), indicies_cache.end(), 0);
+		return indicies_cache;
+	}
+
+	mesh::vertex_storage& mapped_mesh::attribute_storage(size_t index) {
+		auto& attribute = attributes[index];
+		if(!attribute.copy) {
+			attribute.copy = std::make_unique<vertex_storage>(make_storage(attribute.format));
+			auto& bytes = attribute.copy->as_bytes();
+			bytes.assign(attribute.view.begin(), attribute.view.end());
+			if(attribute.format == format_of<std::byte>() && vertices)
+				bytes.element_size = attribute.view.size() / vertices;
+		}
+		return *attribute.copy;
+	}
+
+	std::span<std::byte> mapped_mesh::attribute_bytes(size_t index) {
+		auto& attribute = attributes[index];
+		return attribute.copy ? attribute.copy->byte_span() : attribute.view;
+	}
+
+	std::optional<std::span<uint32_t>> mapped_mesh::indicies_view() {
+		return index_view.size() ? std::optional<std::span<uint32_t>>(index_view) : std::nullopt;
+	}
+
+	std::optional<std::span<mesh::meshlet>> mapped_mesh::meshlets_view() {
+		if(meshlets.size()) return meshlets;
+		if(index_view.size()) {
+			meshlets = {meshlet{index_view}};
+			return meshlets;
+		}
+		return {};
+	}
+
+	mesh::vertex_storage& mapped_mesh::add_vertex_attribute(std::string_view name, vertex_storage&& storage) {
+		if(attributes.empty()) vertices = storage.size();
+		auto format = storage.index();
+		auto& added = attributes.emplace_back(std::string(name), format, std::span<std::byte>{}, std::make_unique<vertex_storage>(std::move(storage)));
+		return *added.copy;
+	}
+
+	std::span<uint32_t> mapped_mesh::set_index_data(std::span<const uint32_t> indicies) {
+		meshlets = {};
+		index_copy.assign(indicies.begin(), indicies.end());
+		return index_view = index_copy;
+	}
+
+	mesh& mapped_mesh::clear_index_data() {
+		meshlets = {};
+		index_copy.clear();
+		index_view = {};
+		return *this;
+	}
+
+	bool mapped_mesh::verify() {
+		for(size_t i = 0; i < attributes.size(); ++i) {
+			auto& attribute = attributes[i];
+			if(attribute.format == format_of<std::byte>()) continue; // Opaque bytes, no way to know how big a vertex is
+
+			auto element_size = make_storage(attribute.format).as_bytes().element_size;
+			if(attribute_bytes(i).size() != vertices * element_size)
+				return false;
+		}
+		if(index_view.size() && *std::max_element(index_view.begin(), index_view.end()) >= vertices)
+			return false;
+		return true;
+	}
+
+	std::vector<std::byte> cooked_mesh::serialize(model& model, const std::filesystem::path& directory /* = {} */) {
+		auto align = [](uint64_t offset) { return (offset + alignment - 1) & ~uint64_t(alignment - 1); };
+
+		std::vector<mesh_record> meshes;
+		std::vector<attribute_record> attributes;
+		std::vector<meshlet_record> meshlets;
+		std::string strings;
+		std::vector<std::byte> blobs; // Offsets are made absolute once the size of everything before the blobs is known
+
+		auto add_string = [&](std::string_view string) {
+			auto offset = strings.size();
+			strings += string;
+			return offset;
+		};
+		auto add_blob = [&](std::span<const std::byte> data) {
+			blobs.resize(align(blobs.size()));
+			auto offset = blobs.size();
+			blobs.insert(blobs.end(), data.begin(), data.end());
+			return offset;
+		};
+
+		for(auto& [mesh_, material_]: model) {
+			auto& mesh = *mesh_;
+			auto& record = meshes.emplace_back();
+			record.type = uint32_t(mesh.type);
+			record.vertex_count = mesh.vertex_count();
+
+			// NOTE: Attributes are written in index order so that the output doesn't depend on hash map ordering
+			std::vector<std::pair<size_t, std::string>> named;
+			for(auto name: mesh.available_attributes())
+				named.emplace_back(*mesh.lookup_attribute(name), name);
+			std::sort(named.begin(), named.end());
+
+			record.attribute_count = named.size();
+			record.attributes_offset = attributes.size(); // Made absolute below
+			auto mapped = dynamic_cast<mapped_mesh*>(&mesh);
+			for(auto& [index, name]: named) {
+				auto& attribute = attributes.emplace_back();
+				attribute.name_offset = add_string(name);
+				attribute.name_size = name.size();
+				attribute.format = mapped ? mapped->attributes[index].format : mesh.attribute_storage(index).index();
+				auto bytes = mesh.attribute_bytes(index);
+				attribute.offset = add_blob(bytes);
+				attribute.size = bytes.size();
+
+				if(name == common_mesh_attributes::positions && attribute.format == format_of<stdmath::float4>() && bytes.size()) {
+					std::span<const float> positions((const float*)bytes.data(), bytes.size() / sizeof(float));
+					for(size_t axis = 0; axis < 3; ++axis) {
+						record.bounds_min[axis] = record.bounds_max[axis] = positions[axis];
+						for(size_t i = axis; i < positions.size(); i += 4) {
+							record.bounds_min[axis] = std::min(record.bounds_min[axis], positions[i]);
+							record.bounds_max[axis] = std::max(record.bounds_max[axis], positions[i]);
+						}
+					}
+				}
+			}
+
+			// Meshlets which are just slices of the index data refer to it, anything else gets appended after it
+			std::vector<uint32_t> indices;
+			if(auto view = mesh.indicies_view(); view)
+				indices.assign(view->begin(), view->end());
+			record.index_count = indices.size();
+			if(auto view = mesh.meshlets_view(); view) {
+				auto index_view = mesh.indicies_view();
+				bool implicit = index_view && view->size() == 1 && view->front().indicies.data() == index_view->data() && view->front().indicies.size() == index_view->size();
+				if(!implicit) {
+					record.meshlet_count = view->size();
+					record.meshlets_offset = meshlets.size(); // Made absolute below
+					for(auto& meshlet: *view) {
+						auto& out = meshlets.emplace_back();
+						out.count = meshlet.indicies.size();
+						if(index_view && meshlet.indicies.data() >= index_view->data() && meshlet.indicies.data() + meshlet.indicies.size() <= index_view->data() + index_view->size())
+							out.offset = meshlet.indicies.data() - index_view->data();
+						else {
+							out.offset = indices.size();
+							indices.insert(indices.end(), meshlet.indicies.begin(), meshlet.indicies.end());
+						}
+					}
+				}
+			}
+			record.extra_index_count = indices.size() - record.index_count;
+			if(indices.size()) record.index_offset = add_blob(std::as_bytes(std::span(indices)));
+
+			if(auto material = material_.value ? dynamic_cast<flat_material*>(&*material_) : nullptr; material) {
+				if(auto color = std::get_if<stdmath::float4>(&material->color))
+					for(size_t i = 0; i < 4; ++i) record.color[i] = (*color)[i];
+				for(auto& dependency: model.texture_dependencies)
+					if(dependency.material == material) {
+						auto file = std::filesystem::absolute(dependency.file);
+						if(!directory.empty())
+							if(auto relative = file.lexically_relative(std::filesystem::absolute(directory)); !relative.empty())
+								file = relative;
+						auto path = file.generic_string();
+						record.texture_offset = add_string(path);
+						record.texture_size = path.size();
+						break;
+					}
+			}
+		}
+
+		header header;
+		header.mesh_count = meshes.size();
+		header.meshes_offset = sizeof(header);
+		uint64_t attributes_offset = header.meshes_offset + meshes.size() * sizeof(mesh_record);
+		uint64_t meshlets_offset = attributes_offset + attributes.size() * sizeof(attribute_record);
+		header.strings_offset = meshlets_offset + meshlets.size() * sizeof(meshlet_record);
+		header.strings_size = strings.size();
+		uint64_t blobs_offset = align(header.strings_offset + strings.size());
+
+		for(auto& record: meshes) {
+			record.attributes_offset = attributes_offset + record.attributes_offset * sizeof(attribute_record);
+			record.meshlets_offset = meshlets_offset + record.meshlets_offset * sizeof(meshlet_record);
+			if(record.index_count + record.extra_index_count) record.index_offset += blobs_offset;
+		}
+		for(auto& attribute: attributes)
+			attribute.offset += blobs_offset;
+
+		std::vector<std::byte> out(blobs_offset + blobs.size());
+		std::memcpy(out.data(), &header, sizeof(header));
+		std::memcpy(out.data() + header.meshes_offset, meshes.data(), meshes.size() * sizeof(mesh_record));
+		std::memcpy(out.data() + attributes_offset, attributes.data(), attributes.size() * sizeof(attribute_record));
+		std::memcpy(out.data() + meshlets_offset, meshlets.data(), meshlets.size() * sizeof(meshlet_record));
+		std::memcpy(out.data() + header.strings_offset, strings.data(), strings.size());
+		std::memcpy(out.data() + blobs_offset, blobs.data(), blobs.size());
+		return out;
+	}
+
+	bool cooked_mesh::write(const std::filesystem::path& output, model& model) {
+		auto data = serialize(model, std::filesystem::absolute(output).parent_path());
+		std::ofstream out(output, std::ios::binary | std::ios::trunc);
+		if(!out) {
+			get_error_handler()(stylizer::error_severity::Error, "Failed to open `" + output.string() + "` for writing!", 0);
+			return false;
+		}
+		out.write((const char*)data.data(), data.size());
+		return bool(out);
+	}
+
+	model cooked_mesh::load(context& ctx, file_cache::handle file) { return load(&ctx, std::move(file)); }
+	model cooked_mesh::load(file_cache::handle file) { return load(nullptr, std::move(file)); }
+
+	model cooked_mesh::load(context* ctx, file_cache::handle file) {
+		// Meshes hand out writable spans, so they view a private copy-on-write mapping rather than the shared read only one
+		if(auto writable = get_file_cache().pin_private(file.span())) file = std::move(writable);
+		auto data = file.span();
+		auto fail = [](std::string_view message) {
+			get_error_handler()(stylizer::error_severity::Error, message, 0);
+			return model{};
+		};
+		// Checks that count elements of size bytes starting at offset lie within the file
+		auto in_bounds = [&](uint64_t offset, uint64_t count, uint64_t size) {
+			return offset <= data.size() && count <= (data.size() - offset) / size;
+		};
+
+		if(data.size() < sizeof(header)) return fail("Not a cooked mesh, file is too small!");
+		auto& header = *(const struct header*)data.data();
+		if(header.magic != magic) return fail("Not a cooked mesh, magic number doesn't match!");
+		if(header.version != version) return fail("Unsupported cooked mesh version!");
+		if(!in_bounds(header.meshes_offset, header.mesh_count, sizeof(mesh_record)) || !in_bounds(header.strings_offset, header.strings_size, 1))
+			return fail("Cooked mesh is truncated!");
+
+		std::string_view strings((const char*)data.data() + header.strings_offset, header.strings_size);
+		auto string = [&](uint64_t offset, uint64_t size) -> std::optional<std::string_view> {
+			if(offset > strings.size() || size > strings.size() - offset) return {};
+			return strings.substr(offset, size);
+		};
+
+		// Texture paths are stored relative to the cooked file
+		auto directory = current_load_path().parent_path();
+
+		model out;
+		std::map<std::pair<std::string, std::array<float, 4>>, flat_material*> material_map;
+		std::span<const mesh_record> records((const mesh_record*)(data.data() + header.meshes_offset), header.mesh_count);
+		for(auto& record: records) {
+			mapped_mesh mesh;
+			mesh.file = file;
+			mesh.type = (mesh::Type)record.type;
+			mesh.vertices = record.vertex_count;
+			mesh.bounds_min = {record.bounds_min[0], record.bounds_min[1], record.bounds_min[2], 0};
+			mesh.bounds_max = {record.bounds_max[0], record.bounds_max[1], record.bounds_max[2], 0};
+
+			if(!in_bounds(record.attributes_offset, record.attribute_count, sizeof(attribute_record)))
+				return fail("Cooked mesh is truncated!");
+			std::span<const attribute_record> attributes((const attribute_record*)(data.data() + record.attributes_offset), record.attribute_count);
+			for(auto& attribute: attributes) {
+				auto name = string(attribute.name_offset, attribute.name_size);
+				if(!name || !in_bounds(attribute.offset, attribute.size, 1) || attribute.format >= std::variant_size_v<mesh::vertex_storage_variant>
+					|| attribute.offset % element_alignment(attribute.format) // NOTE: The mapping is page aligned, so aligned offsets are aligned in memory
+				) return fail("Cooked mesh has an invalid attribute!");
+				mesh.attributes.emplace_back(std::string(*name), attribute.format, data.subspan(attribute.offset, attribute.size), nullptr);
+			}
+
+			auto index_count = record.index_count + record.extra_index_count;
+			if(index_count && (record.index_offset % alignof(uint32_t) || !in_bounds(record.index_offset, index_count, sizeof(uint32_t))))
+				return fail("Cooked mesh has invalid index data!");
+			std::span<uint32_t> indices = index_count ? std::span<uint32_t>((uint32_t*)(data.data() + record.index_offset), index_count) : std::span<uint32_t>{};
+			mesh.index_view = indices.first(record.index_count);
+
+			if(!in_bounds(record.meshlets_offset, record.meshlet_count, sizeof(meshlet_record)))
+				return fail("Cooked mesh is truncated!");
+			std::span<const meshlet_record> meshlets((const meshlet_record*)(data.data() + record.meshlets_offset), record.meshlet_count);
+			for(auto& meshlet: meshlets) {
+				if(meshlet.offset > indices.size() || meshlet.count > indices.size() - meshlet.offset)
+					return fail("Cooked mesh has an invalid meshlet!");
+				mesh.meshlets.push_back({indices.subspan(meshlet.offset, meshlet.count)});
+			}
+
+			auto texture = string(record.texture_offset, record.texture_size);
+			if(!texture) return fail("Cooked mesh has an invalid texture path!");
+			std::filesystem::path texture_path(*texture);
+			if(!texture->empty() && texture_path.is_relative()) texture_path = directory / texture_path;
+			std::pair<std::string, std::array<float, 4>> key = {texture_path.string(), {record.color[0], record.color[1], record.color[2], record.color[3]}};
+			if(auto found = material_map.find(key); found != material_map.end()) {
+				out.emplace_back(mesh.move_to_owned(), found->second);
+				continue;
+			}
+
+			stylizer::flat_material material;
+			material.color = stdmath::float4(record.color[0], record.color[1], record.color[2], record.color[3]);
+			if(!texture->empty() && ctx)
+				// NOTE: Shared so that every material (in every model) using the same texture shares a single upload
+				material.color = stylizer::maybe_owned<stylizer::texture>(&stylizer::image::load_shared_texture(*ctx, key.first));
+
+			auto& real = out.emplace_back(mesh.move_to_owned(), material.move_to_owned());
+			material_map[key] = (stylizer::flat_material*)&*real.second;
+			if(!texture->empty()) out.texture_dependencies.push_back({key.first, material_map[key]});
+		}
+		return out;
+	}
+
+	maybe_owned<model> load_cooked_mesh_model_generic(stylizer::context& ctx, std::span<std::byte> memory, std::string_view extension) {
+		auto file = get_file_cache().pin(memory);
+		if(!file) {
+			// Not backed by a cached mapping (eg a compressed asset pack entry), so the meshes get their own copy
+			auto copy = std::make_shared<std::vector<std::byte>>(memory.begin(), memory.end());
+			file = {copy, *copy};
+		}
+		return cooked_mesh::load(ctx, std::move(file)).move_to_owned();
+	}
+}}
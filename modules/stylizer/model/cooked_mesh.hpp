@@ -0,0 +1,118 @@
+#pragma once
+
+#include "api.hpp"
+
+#include <memory>
+
+namespace stylizer { inline namespace models {
+
+	// A mesh whose attributes and indices are views straight into a mapped (cooked) file
+	// NOTE: The mapping is private and copy-on-write, so writing through the views only copies the touched pages (never changing the file)
+	// NOTE: Attributes are only copied out of the file once they are requested as storage (eg to be resized)
+	struct mapped_mesh : public mesh { STYLIZER_MOVE_AND_MAKE_OWNED_DERIVED_METHODS(mapped_mesh, mesh)
+		struct attribute {
+			std::string name;
+			size_t format; // Index of the attribute's type in vertex_storage_variant
+			std::span<std::byte> view;
+			std::unique_ptr<vertex_storage> copy;
+		};
+
+		file_cache::handle file; // Keeps the mapping alive
+		std::vector<attribute> attributes;
+		std::span<uint32_t> index_view = {};
+		std::vector<uint32_t> index_copy = {}; // Only used once set_index_data is called
+		std::vector<meshlet> meshlets = {};
+		size_t vertices = 0;
+		stdmath::float4 bounds_min = {}, bounds_max = {};
+
+		std::optional<size_t> lookup_attribute(std::string_view name) override;
+		std::span<std::string_view> available_attributes() override;
+		std::span<size_t> attribute_indicies() override;
+		vertex_storage& attribute_storage(size_t index) override;
+		std::span<std::byte> attribute_bytes(size_t index) override;
+
+		std::optional<std::span<uint32_t>> indicies_view() override;
+		std::optional<std::span<meshlet>> meshlets_view() override;
+
+		size_t vertex_count() override { return vertices; }
+
+		vertex_storage& add_vertex_attribute(std::string_view name, vertex_storage&& storage) override;
+		std::span<uint32_t> set_index_data(std::span<const uint32_t> indicies) override;
+		mesh& clear_index_data() override;
+
+		bool verify() override;
+
+	protected:
+		std::vector<std::string_view> names_cache;
+		std::vector<size_t> indicies_cache;
+	};
+
+	// Binary mesh format (.smesh) laid out so that it can be mapped and used without parsing
+	// Layout (little endian):
+	//   header
+	//   mesh records, attribute records, meshlet records
+	//   strings: attribute names and texture paths
+	//   blobs: attribute data and index data, each aligned to cooked_mesh::alignment
+	// A mesh's index blob holds its index data followed by any indices only referenced by its meshlets
+	struct cooked_mesh {
+		constexpr static uint32_t magic = 0x48534D53; // "SMSH"
+		constexpr static uint32_t version = 1;
+		constexpr static uint32_t alignment = 64;
+
+		struct header {
+			uint32_t magic = cooked_mesh::magic;
+			uint32_t version = cooked_mesh::version;
+			uint64_t mesh_count = 0;
+			uint64_t meshes_offset = 0;
+			uint64_t strings_offset = 0;
+			uint64_t strings_size = 0;
+		};
+
+		struct mesh_record {
+			uint32_t type = 0; // mesh::Type
+			uint32_t flags = 0; // Reserved
+			uint64_t attribute_count = 0;
+			uint64_t attributes_offset = 0;
+			uint64_t vertex_count = 0;
+			uint64_t index_offset = 0;
+			uint64_t index_count = 0;
+			uint64_t extra_index_count = 0; // Meshlet only indices following the index data
+			uint64_t meshlet_count = 0;
+			uint64_t meshlets_offset = 0;
+			float bounds_min[4] = {}, bounds_max[4] = {};
+
+			// Flat material
+			float color[4] = {.5, .5, .5, 1};
+			uint64_t texture_offset = 0; // Into the strings, a texture overrides the color
+			uint64_t texture_size = 0;
+		};
+
+		struct attribute_record {
+			uint64_t name_offset = 0; // Into the strings
+			uint64_t name_size = 0;
+			uint64_t format = 0; // Index of the attribute's type in mesh::vertex_storage_variant
+			uint64_t offset = 0;
+			uint64_t size = 0;
+		};
+
+		struct meshlet_record {
+			uint64_t offset = 0; // In indices from the start of the mesh's index blob
+			uint64_t count = 0;
+		};
+
+		// Only flat materials are recorded (anything else becomes the default grey), textures are looked up in the model's texture_dependencies
+		// NOTE: Texture paths are stored relative to directory (absolute when it is empty), and resolved against the directory of the cooked file when it is loaded (see current_load_path)
+		static std::vector<std::byte> serialize(model& model, const std::filesystem::path& directory = {});
+		static bool write(const std::filesystem::path& output, model& model);
+
+		// The returned meshes are mapped_meshes which keep file alive
+		static model load(context& ctx, file_cache::handle file);
+		// NOTE: Without a context textures aren't loaded, their materials keep the recorded color but are still listed in texture_dependencies
+		static model load(file_cache::handle file);
+
+	protected:
+		static model load(context* ctx, file_cache::handle file);
+	};
+
+	maybe_owned<model> load_cooked_mesh_model_generic(stylizer::context& ctx, std::span<std::byte> memory, std::string_view extension);
+}}
@@ -1,9 +1,13 @@
 #include "dynamic_mesh.hpp"
 
-#include <stylizer/image/api.hpp>
+#include <stylizer/core/util/hash.hpp>
 
-#define TINYOBJLOADER_IMPLEMENTATION
-#include "thirdparty/tinyobjloader.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <numeric>
 
 namespace stylizer { inline namespace models {
 
@@ -14,18 +18,16 @@ namespace stylizer { inline namespace models {
 	}
 
 	std::span<std::string_view> dynamic_mesh::available_attributes() {
-		static std::vector<std::string_view> out;
-		out.clear();
+		names_cache.clear();
 		for(auto& [name, index] : names2index)
-			out.push_back(name);
-		return out;
+			names_cache.push_back(name);
+		return names_cache;
 	}
 
 	std::span<size_t> dynamic_mesh::attribute_indicies() {
-		static std::vector<size_t> out;
-		out.resize(attribute_data.size());
-		std::iota(out.begin(), out.end(), 0);
-		return out;
+		indicies_cache.resize(attribute_data.size());
+		std::iota(indicies_cache.begin(), indicies_cache.end(), 0);
+		return indicies_cache;
 	}
 
 	size_t dynamic_mesh::attribute_offset(size_t index) {
@@ -70,117 +72,145 @@ namespace stylizer { inline namespace models {
 		return *this;
 	}
 
-	bool dynamic_mesh::verify() {
-		if(cached_vertex_count && *cached_vertex_count != mesh::vertex_count())
-			return false;
+	dynamic_mesh& dynamic_mesh::weld(thread_pool& pool /* = thread_pool::get_default() */) {
+		if(attribute_data.empty()) return *this;
+		size_t count = attribute_data[0].size();
+		if(count == 0) return *this;
+		if(count > std::numeric_limits<uint32_t>::max()) {
+			stylizer::get_error_handler()(stylizer::error_severity::Warning, "Mesh has too many vertices to weld!", 0);
+			return *this;
+		}
 
-		return mesh::verify();
-	}
+		if(std::any_of(index_data.begin(), index_data.end(), [count](uint32_t index) { return index >= count; })) {
+			stylizer::get_error_handler()(stylizer::error_severity::Error, "Can't weld a mesh whose index data references vertices which don't exist!", 0);
+			return *this;
+		}
 
-	model load_tinyobj_model_with_material(stylizer::context& ctx, std::span<std::byte> memory, std::span<std::byte> mtl) {
-		tinyobj::ObjReader reader;
-
-		tinyobj::ObjReaderConfig reader_config;
-		reader_config.mtl_search_path = std::filesystem::current_path().c_str(); // Path to material files
-		reader_config.vertex_color = true;
-
-		if (!reader.ParseFromString(std::string((char*)memory.data(), (char*)(memory.data() + memory.size())), std::string((char*)mtl.data(), (char*)(mtl.data() + mtl.size())), reader_config))
-			if (!reader.Error().empty())
-				stylizer::get_error_handler()(stylizer::error_severity::Error, reader.Error(), 0);
-
-		if (!reader.Warning().empty())
-			stylizer::get_error_handler()(stylizer::error_severity::Warning, reader.Warning(), 0);
-
-		auto& attrib = reader.GetAttrib();
-		auto& shapes = reader.GetShapes();
-		auto& materials = reader.GetMaterials();
-
-		stylizer::model out;
-		struct attributes {
-			stylizer::storage<stdmath::float4> positions;
-			stylizer::storage<stdmath::float4> colors;
-			stylizer::storage<stdmath::float4> normals;
-			stylizer::storage<stdmath::float2> uvs;
-
-			stylizer::dynamic_mesh make_mesh() {
-				stylizer::dynamic_mesh mesh;
-				mesh.add_vertex_attribute(stylizer::common_mesh_attributes::positions, std::move(positions));
-				mesh.add_vertex_attribute(stylizer::common_mesh_attributes::colors, std::move(colors));
-				if(normals.size()) mesh.add_vertex_attribute(stylizer::common_mesh_attributes::normals, std::move(normals));
-				if(uvs.size()) mesh.add_vertex_attribute(stylizer::common_mesh_attributes::uvs, std::move(uvs));
-				return mesh;
+		// NOTE: The index data is remapped in place, so explicit meshlets viewing it stay valid (and remapped), ones viewing any other memory can't be kept
+		bool explicit_meshlets = has_explicit_meshlets();
+		auto views_index_data = [&](const meshlet& meshlet) {
+			auto begin = index_data.data(), end = index_data.data() + index_data.size();
+			return !std::less{}(meshlet.indicies.data(), begin) && !std::less{}(end, meshlet.indicies.data() + meshlet.indicies.size());
+		};
+		if(explicit_meshlets && !std::all_of(meshlets.begin(), meshlets.end(), views_index_data)) {
+			stylizer::get_error_handler()(stylizer::error_severity::Error, "Can't weld a mesh whose meshlets reference indices outside of its index data!", 0);
+			return *this;
+		}
+
+		std::vector<std::span<std::byte>> attributes;
+		std::vector<size_t> sizes;
+		for(auto& data: attribute_data) {
+			if(data.size() != count) {
+				stylizer::get_error_handler()(stylizer::error_severity::Error, "Can't weld a mesh whose attributes have different vertex counts!", 0);
+				return *this;
 			}
+			attributes.push_back(data.byte_span());
+			sizes.push_back(attributes.back().size() / count);
+		}
+
+		// Hashing is the expensive part, so every vertex is hashed up front in parallel
+		// NOTE: The temporaries live in this thread's scratch arena and are released when the scope ends (large ones are handed back to the system, see scratch_arena::max_retained_bytes)
+		auto& scratch = thread_pool::scratch();
+		auto scope = scratch.make_scope();
+		auto hashes = scratch.allocate<uint64_t>(count);
+		constexpr size_t batch_size = 16 * 1024;
+		pool.parallel_for((count + batch_size - 1) / batch_size, [&](size_t batch) {
+			for(size_t vertex = batch * batch_size, end = std::min(vertex + batch_size, count); vertex < end; ++vertex) {
+				uint64_t out = 0;
+				for(size_t i = 0; i < attributes.size(); ++i)
+					out = content_hash(attributes[i].subspan(vertex * sizes[i], sizes[i]), out);
+				hashes[vertex] = out;
+			}
+		});
+		auto equal = [&](size_t a, size_t b) {
+			for(size_t i = 0; i < attributes.size(); ++i)
+				if(std::memcmp(attributes[i].data() + a * sizes[i], attributes[i].data() + b * sizes[i], sizes[i]) != 0)
+					return false;
+			return true;
 		};
 
-		std::unordered_map<int, stylizer::flat_material*> material_map;
-
-		// Loop over shapes
-		for (size_t s = 0; s < shapes.size(); s++) {
-			std::unordered_map<int, attributes> material_meshes;
-
-			// Loop over faces(polygon)
-			size_t index_offset = 0;
-			for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++) {
-				size_t fv = size_t(shapes[s].mesh.num_face_vertices[f]);
-				auto mat = shapes[s].mesh.material_ids[f];
-
-				// Loop over vertices in the face.
-				for (size_t v = 0; v < fv; v++) {
-					// access to vertex
-					tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
-					tinyobj::real_t vx = attrib.vertices[3*size_t(idx.vertex_index)+0];
-					tinyobj::real_t vy = attrib.vertices[3*size_t(idx.vertex_index)+1];
-					tinyobj::real_t vz = attrib.vertices[3*size_t(idx.vertex_index)+2];
-					material_meshes[mat].positions.emplace_back(vx, vy, vz, 0);
-
-					// Check if `normal_index` is zero or positive. negative = no normal data
-					if (idx.normal_index >= 0) {
-						tinyobj::real_t nx = attrib.normals[3*size_t(idx.normal_index)+0];
-						tinyobj::real_t ny = attrib.normals[3*size_t(idx.normal_index)+1];
-						tinyobj::real_t nz = attrib.normals[3*size_t(idx.normal_index)+2];
-						material_meshes[mat].normals.emplace_back(nx, ny, nz, 0);
-					}
-
-					// Check if `texcoord_index` is zero or positive. negative = no texcoord data
-					if (idx.texcoord_index >= 0) {
-						tinyobj::real_t tx = attrib.texcoords[2*size_t(idx.texcoord_index)+0];
-						tinyobj::real_t ty = attrib.texcoords[2*size_t(idx.texcoord_index)+1];
-						material_meshes[mat].uvs.emplace_back(tx, ty); // TODO: Why is the v axis inverted!?!?
-					}
-
-					// Optional: vertex colors
-					tinyobj::real_t red   = attrib.colors[3*size_t(idx.vertex_index)+0];
-					tinyobj::real_t green = attrib.colors[3*size_t(idx.vertex_index)+1];
-					tinyobj::real_t blue  = attrib.colors[3*size_t(idx.vertex_index)+2];
-					material_meshes[mat].colors.emplace_back(red, green, blue, 1);
+		// Open addressing table of welded vertices, survivors are compacted to the front of each attribute as they are found
+		constexpr uint32_t empty = std::numeric_limits<uint32_t>::max();
+		auto table = scratch.allocate<uint32_t>(std::bit_ceil(count * 2));
+		std::fill(table.begin(), table.end(), empty);
+		std::vector<uint32_t> remap(count);
+		uint32_t unique = 0;
+		for(size_t vertex = 0; vertex < count; ++vertex) {
+			for(size_t slot = hashes[vertex] & (table.size() - 1); ; slot = (slot + 1) & (table.size() - 1)) {
+				if(table[slot] == empty) {
+					if(vertex != unique)
+						for(size_t i = 0; i < attributes.size(); ++i)
+							std::memcpy(attributes[i].data() + unique * sizes[i], attributes[i].data() + vertex * sizes[i], sizes[i]);
+					table[slot] = remap[vertex] = unique++;
+					break;
+				}
+				// NOTE: Survivors always live before the vertex being welded, so it hasn't been overwritten yet
+				if(equal(table[slot], vertex)) {
+					remap[vertex] = table[slot];
+					break;
 				}
-				index_offset += fv;
 			}
+		}
 
-			for(auto& [mat, attrs]: material_meshes) {
-				if(!material_map.contains(mat)) {
-					stylizer::flat_material material;
-					if(mat >= 0) material.color = stdmath::float4(materials[mat].diffuse[0], materials[mat].diffuse[1], materials[mat].diffuse[2], 1);
-					else material.color = stdmath::float4(.5, .5, .5, 1);
-
-					if(mat >= 0 && !materials[mat].diffuse_texname.empty()) {
-						std::filesystem::path path = materials[mat].diffuse_texname;
-						material.color = stylizer::image::load(ctx, path)->upload(ctx).configure_sampler(ctx).move_to_owned();
-					}
+		// Vertices which the existing index data never referenced can be left over past its largest index, those are dropped
+		uint32_t vertices = unique;
+		if(index_data.empty()) index_data = std::move(remap);
+		else {
+			for(auto& index: index_data)
+				index = remap[index];
+			vertices = *std::max_element(index_data.begin(), index_data.end()) + 1;
+		}
 
-					auto& real = out.emplace_back(attrs.make_mesh().move_to_owned(), material.move_to_owned());
-					material_map[mat] = (stylizer::flat_material*)&*real.second;
-					continue;
-				}
+		for(size_t i = 0; i < attribute_data.size(); ++i) {
+			auto& bytes = attribute_data[i].as_bytes();
+			bytes.resize(vertices * sizes[i]);
+			bytes.shrink_to_fit();
+		}
+		if(!explicit_meshlets) meshlets = {};
+		cached_vertex_count = vertices;
+		return *this;
+	}
 
-				out.emplace_back(attrs.make_mesh().move_to_owned(), material_map[mat]);
+	dynamic_mesh& dynamic_mesh::optimize_vertex_order(thread_pool& pool /* = thread_pool::get_default() */) {
+		if(attribute_data.empty() || index_data.empty()) return *this;
+		size_t count = attribute_data[0].size();
+		for(auto& data: attribute_data)
+			if(data.size() != count) {
+				stylizer::get_error_handler()(stylizer::error_severity::Error, "Can't reorder a mesh whose attributes have different vertex counts!", 0);
+				return *this;
 			}
-		}
 
-		return out;
+		constexpr uint32_t unassigned = std::numeric_limits<uint32_t>::max();
+		std::vector<uint32_t> remap(count, unassigned);
+		uint32_t next = 0;
+		for(auto index: index_data)
+			if(index < count && remap[index] == unassigned)
+				remap[index] = next++;
+		for(auto& index: remap) // Unreferenced vertices go at the end
+			if(index == unassigned) index = next++;
+
+		// Attributes are independent of each other, so each is reordered as its own job (through the scratch arena of whichever thread runs it)
+		pool.parallel_for(attribute_data.size(), [&](size_t i) {
+			auto bytes = attribute_data[i].byte_span();
+			size_t size = bytes.size() / count;
+			auto& scratch = thread_pool::scratch();
+			auto scope = scratch.make_scope();
+			auto reordered = scratch.allocate<std::byte>(bytes.size());
+			for(size_t vertex = 0; vertex < count; ++vertex)
+				std::memcpy(reordered.data() + remap[vertex] * size, bytes.data() + vertex * size, size);
+			std::copy(reordered.begin(), reordered.end(), bytes.begin());
+		});
+
+		for(auto& index: index_data)
+			if(index < count) index = remap[index];
+		meshlets = {};
+		return *this;
 	}
 
-	model load_tinyobj_model(stylizer::context& ctx, std::span<std::byte> memory, std::string_view extension /* = {} */) {
-		return load_tinyobj_model_with_material(ctx, memory, {});
+	bool dynamic_mesh::verify() {
+		if(cached_vertex_count && *cached_vertex_count != mesh::vertex_count())
+			return false;
+
+		return mesh::verify();
 	}
 }}
\ No newline at end of file
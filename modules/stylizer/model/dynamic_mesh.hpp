@@ -1,6 +1,7 @@
 #pragma once
 
 #include "api.hpp"
+#include <map>
 #include <optional>
 
 namespace stylizer { inline namespace models { 
@@ -46,9 +47,32 @@ namespace stylizer { inline namespace models {
 
 		mesh& clear_index_data() override;
 
+		// Merges vertices whose attributes are all bitwise identical and indexes the survivors (remapping any existing index data and the meshlets viewing it)
+		// NOTE: Meshes with meshlets viewing indices outside of their index data are reported and left alone
+		dynamic_mesh& weld(thread_pool& pool = thread_pool::get_default());
+		// Reorders vertices into the order the index data first references them, so that vertex fetches walk memory linearly
+		dynamic_mesh& optimize_vertex_order(thread_pool& pool = thread_pool::get_default());
+
 		bool verify() override;
+
+	protected:
+		// NOTE: Per mesh (rather than function local statics) so that meshes on different threads don't share them
+		std::vector<std::string_view> names_cache;
+		std::vector<size_t> indicies_cache;
+	};
+
+	// The geometry of an OBJ, every (shape, material) pair with faces becomes its own welded mesh (in the order they first appear)
+	struct obj_geometry {
+		std::vector<dynamic_mesh> meshes;
+		std::vector<size_t> shapes; // Counts the `o` and `g` statements (which were followed by faces) before each mesh
+		std::vector<int> materials; // Index into the material ids, or -1
 	};
+	// NOTE: The text is split into at most max_chunks chunks of at least min_chunk_size bytes which are parsed in parallel
+	std::optional<obj_geometry> parse_obj_geometry(thread_pool& pool, std::string_view text, const std::map<std::string, int>& materials, size_t max_chunks, size_t min_chunk_size = 4 * 1024 * 1024);
 
 	model load_tinyobj_model_with_material(stylizer::context& ctx, std::span<std::byte> memory, std::span<std::byte> mtl);
 	model load_tinyobj_model(stylizer::context& ctx, std::span<std::byte> memory, std::string_view extension = {});
+	// NOTE: Neither needs a context, the geometry is all that is loaded
+	model load_ply_model(std::span<std::byte> memory, thread_pool& pool = thread_pool::get_default());
+	model load_stl_model(std::span<std::byte> memory);
 }}
\ No newline at end of file
@@ -0,0 +1,759 @@
+#include "cooked_mesh.hpp"
+
+#include <stylizer/image/api.hpp>
+
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+namespace stylizer { inline namespace models {
+
+	namespace gltf {
+		constexpr uint32_t glb_magic = 0x46546C67; // "glTF"
+		constexpr uint32_t json_chunk = 0x4E4F534A; // "JSON"
+		constexpr uint32_t binary_chunk = 0x004E4942; // "BIN\0"
+		constexpr size_t none = std::numeric_limits<size_t>::max();
+
+		// Minimal JSON document, just enough to walk a glTF's description
+		struct json {
+			enum class kind { Null, Boolean, Number, String, Array, Object } kind = kind::Null;
+			bool boolean = false;
+			double number = 0;
+			std::string string;
+			std::vector<json> array;
+			std::vector<std::pair<std::string, json>> object;
+
+			static const json& null() {
+				static json out;
+				return out;
+			}
+
+			const json& operator[](std::string_view key) const {
+				for(auto& [name, value]: object)
+					if(name == key) return value;
+				return null();
+			}
+			const json& operator[](size_t index) const { return index < array.size() ? array[index] : null(); }
+			explicit operator bool() const { return kind != kind::Null; }
+
+			double number_or(double fallback) const { return kind == kind::Number ? number : fallback; }
+			size_t index_or(size_t fallback = none) const { return kind == kind::Number && number >= 0 ? size_t(number) : fallback; }
+			std::string_view string_or(std::string_view fallback = {}) const { return kind == kind::String ? std::string_view(string) : fallback; }
+		};
+
+		struct json_parser {
+			std::string_view text;
+			size_t at = 0;
+
+			void skip_space() {
+				while(at < text.size() && (text[at] == ' ' || text[at] == '\t' || text[at] == '\n' || text[at] == '\r')) ++at;
+			}
+			bool consume(char c) {
+				skip_space();
+				if(at >= text.size() || text[at] != c) return false;
+				++at;
+				return true;
+			}
+			bool consume(std::string_view word) {
+				if(!text.substr(at).starts_with(word)) return false;
+				at += word.size();
+				return true;
+			}
+
+			bool parse_hex(uint32_t& out) {
+				if(text.size() - at < 4) return false;
+				auto result = std::from_chars(text.data() + at, text.data() + at + 4, out, 16);
+				if(result.ptr != text.data() + at + 4) return false;
+				at += 4;
+				return true;
+			}
+
+			bool parse_string(std::string& out) {
+				if(!consume('"')) return false;
+				while(at < text.size()) {
+					char c = text[at++];
+					if(c == '"') return true;
+					if(c != '\\') {
+						out += c;
+						continue;
+					}
+
+					if(at >= text.size()) return false;
+					switch(text[at++]) {
+					case '"': out += '"'; break;
+					case '\\': out += '\\'; break;
+					case '/': out += '/'; break;
+					case 'b': out += '\b'; break;
+					case 'f': out += '\f'; break;
+					case 'n': out += '\n'; break;
+					case 'r': out += '\r'; break;
+					case 't': out += '\t'; break;
+					case 'u': {
+						uint32_t code;
+						if(!parse_hex(code)) return false;
+						if(code >= 0xD800 && code < 0xDC00) { // Surrogate pair
+							uint32_t low;
+							if(!consume("\\u") || !parse_hex(low) || low < 0xDC00 || low >= 0xE000) return false;
+							code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+						}
+						// Encode as UTF-8
+						if(code < 0x80) out += char(code);
+						else if(code < 0x800) {
+							out += char(0xC0 | (code >> 6));
+							out += char(0x80 | (code & 0x3F));
+						} else if(code < 0x10000) {
+							out += char(0xE0 | (code >> 12));
+							out += char(0x80 | ((code >> 6) & 0x3F));
+							out += char(0x80 | (code & 0x3F));
+						} else {
+							out += char(0xF0 | (code >> 18));
+							out += char(0x80 | ((code >> 12) & 0x3F));
+							out += char(0x80 | ((code >> 6) & 0x3F));
+							out += char(0x80 | (code & 0x3F));
+						}
+						break;
+					}
+					default: return false;
+					}
+				}
+				return false;
+			}
+
+			bool parse(json& out, size_t depth = 0) {
+				if(depth > 256) return false;
+				skip_space();
+				if(at >= text.size()) return false;
+
+				if(consume('{')) {
+					out.kind = json::kind::Object;
+					if(consume('}')) return true;
+					do {
+						auto& [name, value] = out.object.emplace_back();
+						if(!parse_string(name) || !consume(':') || !parse(value, depth + 1)) return false;
+					} while(consume(','));
+					return consume('}');
+				}
+				if(consume('[')) {
+					out.kind = json::kind::Array;
+					if(consume(']')) return true;
+					do {
+						if(!parse(out.array.emplace_back(), depth + 1)) return false;
+					} while(consume(','));
+					return consume(']');
+				}
+				if(text[at] == '"') {
+					out.kind = json::kind::String;
+					return parse_string(out.string);
+				}
+				if(consume("true")) {
+					out.kind = json::kind::Boolean;
+					out.boolean = true;
+					return true;
+				}
+				if(consume("false")) {
+					out.kind = json::kind::Boolean;
+					return true;
+				}
+				if(consume("null")) return true;
+
+				out.kind = json::kind::Number;
+				auto result = std::from_chars(text.data() + at, text.data() + text.size(), out.number);
+				if(result.ec != std::errc{}) return false;
+				at = result.ptr - text.data();
+				return true;
+			}
+		};
+
+		inline std::optional<json> parse_json(std::string_view text) {
+			json_parser parser{text};
+			json out;
+			if(!parser.parse(out)) return {};
+			parser.skip_space();
+			if(parser.at != text.size() && text[parser.at] != '\0') return {};
+			return out;
+		}
+
+		inline std::optional<std::vector<std::byte>> decode_base64(std::string_view text) {
+			auto value = [](char c) -> int {
+				if(c >= 'A' && c <= 'Z') return c - 'A';
+				if(c >= 'a' && c <= 'z') return c - 'a' + 26;
+				if(c >= '0' && c <= '9') return c - '0' + 52;
+				if(c == '+' || c == '-') return 62;
+				if(c == '/' || c == '_') return 63;
+				return -1;
+			};
+
+			std::vector<std::byte> out;
+			out.reserve(text.size() / 4 * 3);
+			uint32_t bits = 0, count = 0;
+			for(char c: text) {
+				if(c == '=') break;
+				auto v = value(c);
+				if(v < 0) return {};
+				bits = (bits << 6) | v;
+				if(++count == 4) {
+					out.push_back(std::byte(bits >> 16));
+					out.push_back(std::byte(bits >> 8));
+					out.push_back(std::byte(bits));
+					bits = count = 0;
+				}
+			}
+			if(count == 2) out.push_back(std::byte(bits >> 4));
+			else if(count == 3) {
+				out.push_back(std::byte(bits >> 10));
+				out.push_back(std::byte(bits >> 2));
+			} else if(count == 1) return {};
+			return out;
+		}
+
+		inline std::string decode_percent(std::string_view uri) {
+			std::string out;
+			for(size_t i = 0; i < uri.size(); ++i) {
+				uint8_t c;
+				if(uri[i] == '%' && i + 2 < uri.size() && std::from_chars(uri.data() + i + 1, uri.data() + i + 3, c, 16).ptr == uri.data() + i + 3) {
+					out += char(c);
+					i += 2;
+				} else out += uri[i];
+			}
+			return out;
+		}
+
+		// Relative paths are relative to directory (the glTF file's) rather than the working directory
+		inline std::filesystem::path uri_path(std::string_view uri, const std::filesystem::path& directory) {
+			std::filesystem::path path = decode_percent(uri);
+			return path.is_relative() ? directory / path : path;
+		}
+		// Either a base64 data uri or a file path
+		inline file_cache::handle load_uri(std::string_view uri, const std::filesystem::path& directory, thread_pool& pool) {
+			if(uri.starts_with("data:")) {
+				auto comma = uri.find(',');
+				if(comma == uri.npos || uri.substr(0, comma).find(";base64") == uri.npos) return {};
+				auto decoded = decode_base64(uri.substr(comma + 1));
+				if(!decoded) return {};
+				auto owner = std::make_shared<std::vector<std::byte>>(std::move(*decoded));
+				return {owner, *owner};
+			}
+			return load_file_handle(uri_path(uri, directory), pool);
+		}
+
+		struct document {
+			json root;
+			std::filesystem::path directory; // External URIs are relative to the glTF file (see current_load_path)
+			std::shared_ptr<std::vector<file_cache::handle>> buffers = std::make_shared<std::vector<file_cache::handle>>();
+
+			// Views of a buffer view (empty if invalid)
+			std::span<std::byte> buffer_view(size_t index) const {
+				auto& view = root["bufferViews"][index];
+				auto buffer = view["buffer"].index_or();
+				if(!view || buffer >= buffers->size()) return {};
+
+				auto data = (*buffers)[buffer].span();
+				size_t offset = view["byteOffset"].index_or(0), size = view["byteLength"].index_or(0);
+				if(offset > data.size() || size > data.size() - offset) return {};
+				return data.subspan(offset, size);
+			}
+		};
+
+		struct accessor {
+			std::span<std::byte> data = {}; // Starts at the first element, empty if the accessor is all zeros
+			size_t count = 0, components = 0, component_size = 0, stride = 0;
+			uint32_t component_type = 0;
+			bool normalized = false;
+			const json* sparse = nullptr;
+
+			size_t element_size() const { return components * component_size; }
+			bool tightly_packed() const { return stride == element_size(); }
+			const std::byte* element(size_t i) const { return data.data() + i * stride; }
+		};
+
+		inline size_t component_size(uint32_t type) {
+			if(type == 5120 || type == 5121) return 1; // (unsigned) byte
+			if(type == 5122 || type == 5123) return 2; // (unsigned) short
+			if(type == 5125 || type == 5126) return 4; // unsigned int, float
+			return 0;
+		}
+
+		inline size_t component_count(std::string_view type) {
+			if(type == "SCALAR") return 1;
+			if(type == "VEC2") return 2;
+			if(type == "VEC3") return 3;
+			if(type == "VEC4") return 4;
+			return 0; // Matrices can't be vertex attributes
+		}
+
+		// Makes sure every element of the accessor lies inside its buffer view
+		inline std::optional<accessor> make_accessor(std::span<std::byte> view, size_t offset, size_t stride, accessor out) {
+			if(out.components == 0 || out.component_size == 0) return {};
+			out.stride = stride ? stride : out.element_size();
+			if(view.empty()) return out;
+
+			if(out.count && (offset > view.size() || (out.count - 1) * out.stride + out.element_size() > view.size() - offset)) return {};
+			out.data = view.subspan(offset);
+			return out;
+		}
+
+		inline std::optional<accessor> get_accessor(const document& doc, size_t index) {
+			auto& description = doc.root["accessors"][index];
+			if(!description) return {};
+
+			accessor out;
+			out.count = description["count"].index_or(0);
+			out.component_type = description["componentType"].index_or(0);
+			out.component_size = component_size(out.component_type);
+			out.components = component_count(description["type"].string_or());
+			out.normalized = description["normalized"].boolean;
+			if(description["sparse"]) out.sparse = &description["sparse"];
+
+			std::span<std::byte> view;
+			size_t stride = 0;
+			if(auto view_index = description["bufferView"].index_or(); view_index != none) {
+				view = doc.buffer_view(view_index);
+				if(view.empty()) return {};
+				stride = doc.root["bufferViews"][view_index]["byteStride"].index_or(0);
+			}
+			return make_accessor(view, description["byteOffset"].index_or(0), stride, out);
+		}
+
+		template<typename T>
+		inline T read(const std::byte* at) {
+			T out;
+			std::memcpy(&out, at, sizeof(T));
+			return out;
+		}
+
+		inline float read_float(const accessor& accessor, const std::byte* at) {
+			bool normalized = accessor.normalized;
+			switch(accessor.component_type) {
+			case 5120: return normalized ? std::max(read<int8_t>(at) / 127.f, -1.f) : read<int8_t>(at);
+			case 5121: return normalized ? read<uint8_t>(at) / 255.f : read<uint8_t>(at);
+			case 5122: return normalized ? std::max(read<int16_t>(at) / 32767.f, -1.f) : read<int16_t>(at);
+			case 5123: return normalized ? read<uint16_t>(at) / 65535.f : read<uint16_t>(at);
+			case 5125: return float(read<uint32_t>(at));
+			default: return read<float>(at);
+			}
+		}
+
+		inline uint32_t read_integer(const accessor& accessor, const std::byte* at) {
+			switch(accessor.component_type) {
+			case 5120: return read<int8_t>(at);
+			case 5121: return read<uint8_t>(at);
+			case 5122: return read<int16_t>(at);
+			case 5123: return read<uint16_t>(at);
+			case 5126: return uint32_t(read<float>(at));
+			default: return read<uint32_t>(at);
+			}
+		}
+
+		// Reads element i of the accessor, missing components are left as they were
+		template<typename Tscalar>
+		inline void read_element(const accessor& accessor, size_t i, Tscalar* out, size_t max_components) {
+			if(accessor.data.empty()) return;
+			auto element = accessor.element(i);
+			for(size_t c = 0, count = std::min(accessor.components, max_components); c < count; ++c, element += accessor.component_size)
+				if constexpr(std::is_floating_point_v<Tscalar>)
+					out[c] = read_float(accessor, element);
+				else out[c] = Tscalar(read_integer(accessor, element));
+		}
+
+		// Calls func(index, values accessor, element in values) for every sparse substitution
+		template<typename Tfunc>
+		inline bool for_each_sparse(const document& doc, const accessor& target, const Tfunc& func) {
+			if(!target.sparse) return true;
+			auto& sparse = *target.sparse;
+			auto& indices_description = sparse["indices"];
+			auto& values_description = sparse["values"];
+
+			accessor indices_template{.count = sparse["count"].index_or(0), .components = 1};
+			indices_template.component_type = indices_description["componentType"].index_or(0);
+			indices_template.component_size = component_size(indices_template.component_type);
+			auto indices = make_accessor(doc.buffer_view(indices_description["bufferView"].index_or()), indices_description["byteOffset"].index_or(0), 0, indices_template);
+
+			auto values_template = target;
+			values_template.sparse = nullptr;
+			auto values = make_accessor(doc.buffer_view(values_description["bufferView"].index_or()), values_description["byteOffset"].index_or(0), 0, values_template);
+			if(!indices || !values || indices->data.empty() || values->data.empty()) return false;
+
+			for(size_t i = 0; i < indices->count; ++i) {
+				auto index = read_integer(*indices, indices->element(i));
+				if(index < target.count) func(index, *values, i);
+			}
+			return true;
+		}
+
+		// Copies an accessor into storage of T (vec3s become vec4s with the given w), applying any sparse substitutions
+		template<typename T, typename Tscalar>
+		inline std::optional<storage<T>> copy_accessor(const document& doc, const accessor& accessor, Tscalar w = 0) {
+			constexpr size_t components = sizeof(T) / sizeof(Tscalar);
+			storage<T> out;
+			out.resize(accessor.count);
+			auto data = (Tscalar*)out.data();
+			for(size_t i = 0; i < accessor.count; ++i) {
+				if(components == 4 && accessor.components < 4) data[i * components + 3] = w;
+				read_element(accessor, i, data + i * components, components);
+			}
+
+			bool valid = for_each_sparse(doc, accessor, [&](size_t index, const gltf::accessor& values, size_t i) {
+				read_element(values, i, data + index * components, components);
+			});
+			if(!valid) return {};
+			return out;
+		}
+
+		using matrix = std::array<float, 16>; // Column major
+		constexpr matrix identity = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+
+		inline matrix multiply(const matrix& a, const matrix& b) {
+			matrix out{};
+			for(size_t column = 0; column < 4; ++column)
+				for(size_t row = 0; row < 4; ++row)
+					for(size_t k = 0; k < 4; ++k)
+						out[column * 4 + row] += a[k * 4 + row] * b[column * 4 + k];
+			return out;
+		}
+
+		inline matrix node_matrix(const json& node) {
+			matrix out = identity;
+			if(auto& m = node["matrix"]; m.array.size() == 16) {
+				for(size_t i = 0; i < 16; ++i)
+					out[i] = m[i].number_or(out[i]);
+				return out;
+			}
+
+			auto& t = node["translation"], & r = node["rotation"], & s = node["scale"];
+			float x = r[0].number_or(0), y = r[1].number_or(0), z = r[2].number_or(0), w = r[3].number_or(1);
+			float sx = s[0].number_or(1), sy = s[1].number_or(1), sz = s[2].number_or(1);
+			// translation * rotation * scale
+			out = {
+				(1 - 2 * (y * y + z * z)) * sx, (2 * (x * y + z * w)) * sx, (2 * (x * z - y * w)) * sx, 0,
+				(2 * (x * y - z * w)) * sy, (1 - 2 * (x * x + z * z)) * sy, (2 * (y * z + x * w)) * sy, 0,
+				(2 * (x * z + y * w)) * sz, (2 * (y * z - x * w)) * sz, (1 - 2 * (x * x + y * y)) * sz, 0,
+				float(t[0].number_or(0)), float(t[1].number_or(0)), float(t[2].number_or(0)), 1
+			};
+			return out;
+		}
+
+		// Converts strips, fans and loops into the plain lists mesh::Type describes
+		inline std::vector<uint32_t> to_list(const std::vector<uint32_t>& in, size_t mode) {
+			std::vector<uint32_t> out;
+			size_t n = in.size();
+			if(mode == 2 && n >= 2) // Line loop
+				for(size_t i = 0; i < n; ++i)
+					out.insert(out.end(), {in[i], in[(i + 1) % n]});
+			else if(mode == 3) // Line strip
+				for(size_t i = 0; i + 1 < n; ++i)
+					out.insert(out.end(), {in[i], in[i + 1]});
+			else if(mode == 5) // Triangle strip
+				for(size_t i = 0; i + 2 < n; ++i)
+					out.insert(out.end(), {in[i], in[i + 1 + i % 2], in[i + 2 - i % 2]});
+			else if(mode == 6) // Triangle fan
+				for(size_t i = 0; i + 2 < n; ++i)
+					out.insert(out.end(), {in[i + 1], in[i + 2], in[0]});
+			else return in;
+			return out;
+		}
+
+		inline std::string attribute_name(std::string_view name) {
+			if(name == "POSITION") return std::string(common_mesh_attributes::positions);
+			if(name == "NORMAL") return std::string(common_mesh_attributes::normals);
+			if(name == "COLOR_0") return std::string(common_mesh_attributes::colors);
+			if(name == "TEXCOORD_0") return std::string(common_mesh_attributes::uvs);
+			return std::string(name);
+		}
+
+		template<typename T>
+		inline size_t format_of() { return mesh::vertex_storage(storage<T>{}).index(); }
+
+		struct loader {
+			context& ctx;
+			document& doc;
+			model out = {};
+			std::unordered_map<size_t, flat_material*> materials = {};
+			bool valid = true;
+
+			void fail(std::string_view message) {
+				get_error_handler()(stylizer::error_severity::Error, message, 0);
+				valid = false;
+			}
+
+			// Embedded images are decoded and uploaded directly, external ones go through the shared cache (and their path is returned)
+			maybe_owned<texture> load_texture(size_t index, std::filesystem::path& path) {
+				auto& description = doc.root["images"][doc.root["textures"][index]["source"].index_or()];
+				if(!description) return {};
+
+				auto uri = description["uri"].string_or();
+				if(!uri.empty() && !uri.starts_with("data:")) {
+					path = uri_path(uri, doc.directory);
+					// NOTE: Shared so that every material (in every model) using the same texture shares a single upload
+					return &image::load_shared_texture(ctx, path);
+				}
+
+				file_cache::handle bytes;
+				std::string_view mime = description["mimeType"].string_or();
+				if(!uri.empty()) {
+					bytes = load_uri(uri, doc.directory, ctx.jobs());
+					mime = uri.substr(5, uri.find_first_of(";,") - 5);
+				} else if(auto view = doc.buffer_view(description["bufferView"].index_or()); !view.empty())
+					bytes = {doc.buffers, view};
+
+				std::string extension = mime == "image/png" ? ".png" : mime == "image/jpeg" ? ".jpg" : "";
+				auto& loaders = image::get_loader_set();
+				if(!bytes || !loaders.contains(extension)) {
+					get_error_handler()(stylizer::error_severity::Warning, "Skipping glTF image with an unsupported type: " + std::string(mime), 0);
+					return {};
+				}
+
+				auto decoded = loaders(ctx, bytes.span(), extension);
+				if(!decoded.value || decoded->bytes_size() == 0) { // NOTE: stb reports failure as an empty image
+					get_error_handler()(stylizer::error_severity::Warning, "Skipping glTF image which failed to decode", 0);
+					decoded.release();
+					return {};
+				}
+				auto uploaded = decoded->upload(ctx, with_mip_levels());
+				decoded.release();
+				return uploaded.move_to_owned();
+			}
+
+			maybe_owned<material> get_material(size_t index) {
+				if(auto found = materials.find(index); found != materials.end())
+					return found->second;
+
+				auto& description = doc.root["materials"][index]["pbrMetallicRoughness"];
+				flat_material material;
+				material.color = stdmath::float4(.5, .5, .5, 1);
+				if(auto& factor = description["baseColorFactor"]; factor.array.size() == 4)
+					material.color = stdmath::float4(factor[0].number, factor[1].number, factor[2].number, factor[3].number);
+
+				std::filesystem::path texture_path;
+				if(auto texture = description["baseColorTexture"]["index"].index_or(); texture != none)
+					if(auto loaded = load_texture(texture, texture_path); loaded.value)
+						material.color = std::move(loaded);
+
+				auto owned = material.move_to_owned();
+				materials[index] = (flat_material*)&*owned;
+				if(!texture_path.empty()) out.texture_dependencies.push_back({texture_path, materials[index]});
+				return owned;
+			}
+
+			// Builds a mesh for the primitive, float attributes which the GPU can consume as is stay views into the buffers
+			void load_primitive(const json& primitive, const matrix& transform) {
+				size_t mode = primitive["mode"].index_or(4);
+				if(mode > 6) return fail("glTF primitive has an invalid mode!");
+
+				mapped_mesh mesh;
+				mesh.file = {doc.buffers, {}};
+				mesh.type = mode == 0 ? mesh::Type::Point : mode <= 3 ? mesh::Type::Line : mesh::Type::Triangle;
+
+				bool transformed = transform != identity;
+				// Normals transform by the cofactor matrix (the inverse transpose scaled by the determinant), stored column major like transform
+				auto& m = transform;
+				std::array<float, 9> cofactor = {
+					m[5] * m[10] - m[6] * m[9], m[6] * m[8] - m[4] * m[10], m[4] * m[9] - m[5] * m[8],
+					m[2] * m[9] - m[1] * m[10], m[0] * m[10] - m[2] * m[8], m[1] * m[8] - m[0] * m[9],
+					m[1] * m[6] - m[2] * m[5], m[2] * m[4] - m[0] * m[6], m[0] * m[5] - m[1] * m[4],
+				};
+				float determinant = m[0] * cofactor[0] + m[4] * cofactor[3] + m[8] * cofactor[6];
+				auto rotate = [](const float* m, size_t column_stride, float* v) { // Applies the upper 3x3 of m and renormalizes
+					float x = v[0], y = v[1], z = v[2];
+					for(size_t row = 0; row < 3; ++row)
+						v[row] = m[row] * x + m[column_stride + row] * y + m[column_stride * 2 + row] * z;
+					float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+					if(length > 0) for(size_t i = 0; i < 3; ++i) v[i] /= length;
+				};
+
+				bool has_positions = false, has_colors = false;
+				for(auto& [semantic, index]: primitive["attributes"].object) {
+					auto accessor = get_accessor(doc, index.index_or());
+					if(!accessor) return fail("glTF attribute `" + semantic + "` has an invalid accessor!");
+					if(accessor->components == 0) continue;
+					if(mesh.attributes.empty()) mesh.vertices = accessor->count;
+					else if(accessor->count != mesh.vertices) return fail("glTF primitive's attributes have differing vertex counts!");
+
+					mapped_mesh::attribute attribute{attribute_name(semantic)};
+					bool is_position = semantic == "POSITION", is_normal = semantic == "NORMAL", is_tangent = semantic == "TANGENT";
+					has_positions |= is_position;
+					has_colors |= semantic == "COLOR_0";
+
+					bool modified = transformed && (is_position || is_normal || is_tangent);
+					bool integer = (semantic.starts_with("JOINTS_") || accessor->component_type == 5125) && !accessor->normalized;
+					if(accessor->component_type == 5126 && accessor->components != 3 && accessor->tightly_packed() && !accessor->sparse && !accessor->data.empty() && !modified) {
+						// Zero copy
+						attribute.format = accessor->components == 1 ? format_of<float>() : accessor->components == 2 ? format_of<stdmath::float2>() : format_of<stdmath::float4>();
+						attribute.view = accessor->data.first(accessor->count * accessor->element_size());
+					} else {
+						std::optional<mesh::vertex_storage> copy;
+						auto assign = [&](auto storage) { if(storage) copy = std::move(*storage); };
+						if(integer) {
+							if(accessor->components == 1) assign(copy_accessor<int32_t, int32_t>(doc, *accessor));
+							else if(accessor->components == 2) assign(copy_accessor<stdmath::int2, int32_t>(doc, *accessor));
+							else assign(copy_accessor<stdmath::int4, int32_t>(doc, *accessor));
+						} else if(accessor->components == 1) assign(copy_accessor<float, float>(doc, *accessor));
+						else if(accessor->components == 2) assign(copy_accessor<stdmath::float2, float>(doc, *accessor));
+						else assign(copy_accessor<stdmath::float4, float>(doc, *accessor, semantic.starts_with("COLOR_") ? 1 : 0)); // RGB colors are opaque
+						if(!copy) return fail("glTF attribute `" + semantic + "` has an invalid sparse accessor!");
+
+						if(modified) {
+							auto data = (float*)copy->byte_span().data();
+							for(size_t i = 0; i < mesh.vertices; ++i, data += 4)
+								if(is_position) {
+									float x = data[0], y = data[1], z = data[2];
+									for(size_t row = 0; row < 3; ++row)
+										data[row] = m[row] * x + m[4 + row] * y + m[8 + row] * z + m[12 + row];
+								} else if(is_normal) rotate(cofactor.data(), 3, data);
+								else rotate(m.data(), 4, data); // Tangents keep their handedness in w
+						}
+						attribute.format = copy->index();
+						attribute.copy = std::make_unique<mesh::vertex_storage>(std::move(*copy));
+					}
+					mesh.attributes.emplace_back(std::move(attribute));
+				}
+				if(!has_positions) return; // Nothing to draw
+
+				// NOTE: Every other loader provides colors, so default to white for consistency with their shaders
+				if(!has_colors) {
+					storage<stdmath::float4> colors;
+					colors.resize(mesh.vertices);
+					std::fill(colors.data(), colors.data() + colors.size(), stdmath::float4{1, 1, 1, 1});
+					mesh.attributes.emplace_back(std::string(common_mesh_attributes::colors), format_of<stdmath::float4>(), std::span<std::byte>{}, std::make_unique<mesh::vertex_storage>(std::move(colors)));
+				}
+
+				auto position_index = *mesh.lookup_attribute(common_mesh_attributes::positions);
+				auto positions = (const float*)mesh.attribute_bytes(position_index).data();
+				if(mesh.attributes[position_index].format == format_of<stdmath::float4>() && mesh.vertices) {
+					mesh.bounds_min = mesh.bounds_max = {positions[0], positions[1], positions[2], 0};
+					for(size_t i = 0; i < mesh.vertices; ++i)
+						for(size_t axis = 0; axis < 3; ++axis) {
+							mesh.bounds_min[axis] = std::min(mesh.bounds_min[axis], positions[i * 4 + axis]);
+							mesh.bounds_max[axis] = std::max(mesh.bounds_max[axis], positions[i * 4 + axis]);
+						}
+				}
+
+				// Indices
+				bool mirrored = determinant < 0 && mesh.type == mesh::Type::Triangle; // Winding flips with the handedness
+				bool list = mode == 0 || mode == 1 || mode == 4;
+				std::vector<uint32_t> indices;
+				if(auto index = primitive["indices"].index_or(); index != none) {
+					auto accessor = get_accessor(doc, index);
+					if(!accessor || accessor->components != 1 || accessor->component_type == 5126) return fail("glTF primitive has an invalid index accessor!");
+
+					if(accessor->component_type == 5125 && accessor->tightly_packed() && !accessor->sparse && !accessor->data.empty() && list && !mirrored
+						&& (uintptr_t)accessor->data.data() % alignof(uint32_t) == 0
+					) mesh.index_view = {(uint32_t*)accessor->data.data(), accessor->count}; // Zero copy
+					else if(auto copied = copy_accessor<int32_t, int32_t>(doc, *accessor); copied)
+						indices.assign((const uint32_t*)copied->data(), (const uint32_t*)copied->data() + copied->size());
+					else return fail("glTF primitive has an invalid sparse index accessor!");
+				} else if(!list || mirrored) {
+					indices.resize(mesh.vertices);
+					std::iota(indices.begin(), indices.end(), 0);
+				}
+
+				if(!mesh.index_view.empty() || !indices.empty()) {
+					if(!list) indices = to_list(indices, mode);
+					if(mirrored)
+						for(size_t i = 0; i + 2 < indices.size(); i += 3)
+							std::swap(indices[i + 1], indices[i + 2]);
+					if(mesh.index_view.empty()) mesh.set_index_data(indices);
+				}
+				if(!mesh.verify()) return fail("glTF primitive references a vertex which doesn't exist!");
+
+				auto material = get_material(primitive["material"].index_or());
+				out.emplace_back(mesh.move_to_owned(), std::move(material));
+			}
+
+			void load_node(size_t index, const matrix& parent, size_t depth) {
+				auto& node = doc.root["nodes"][index];
+				if(!node || depth > doc.root["nodes"].array.size()) return fail("glTF node hierarchy is invalid!");
+
+				auto transform = multiply(parent, node_matrix(node));
+				if(auto mesh = node["mesh"].index_or(); mesh != none)
+					for(auto& primitive: doc.root["meshes"][mesh]["primitives"].array)
+						if(valid) load_primitive(primitive, transform);
+				for(auto& child: node["children"].array)
+					if(valid) load_node(child.index_or(), transform, depth + 1);
+			}
+
+			// Decodes every external base color texture concurrently and uploads them in one batch, so that materials find them already shared
+			void preload_textures() {
+				std::vector<std::filesystem::path> paths;
+				for(auto& material: doc.root["materials"].array) {
+					auto texture = material["pbrMetallicRoughness"]["baseColorTexture"]["index"].index_or();
+					if(texture == none) continue;
+					auto uri = doc.root["images"][doc.root["textures"][texture]["source"].index_or()]["uri"].string_or();
+					if(!uri.empty() && !uri.starts_with("data:")) paths.push_back(decode_percent(uri));
+				}
+				if(!paths.empty()) image::load_shared_textures(ctx, paths);
+			}
+
+			model load() {
+				preload_textures();
+				auto& scenes = doc.root["scenes"].array;
+				if(scenes.empty()) { // No scene to place the meshes, load each of them once as is
+					for(auto& mesh: doc.root["meshes"].array)
+						for(auto& primitive: mesh["primitives"].array)
+							if(valid) load_primitive(primitive, identity);
+				} else for(auto& node: doc.root["scenes"][doc.root["scene"].index_or(0)]["nodes"].array)
+					if(valid) load_node(node.index_or(), identity, 0);
+
+				if(!valid) {
+					for(auto& [mesh, material]: out) {
+						mesh.release();
+						material.release();
+					}
+					return {};
+				}
+				return std::move(out);
+			}
+		};
+	}
+
+	maybe_owned<model> load_gltf_model_generic(stylizer::context& ctx, std::span<std::byte> memory, std::string_view extension) {
+		auto fail = [](std::string_view message) {
+			get_error_handler()(stylizer::error_severity::Error, message, 0);
+			return maybe_owned<model>{};
+		};
+
+		// NOTE: Meshes keep views into the binary data, so make sure the file stays mapped (or copy it if it isn't mapped)
+		// NOTE: Those views are writable, so they view a private copy-on-write mapping rather than the shared read only one
+		auto file = get_file_cache().pin_private(memory);
+		if(!file) {
+			auto copy = std::make_shared<std::vector<std::byte>>(memory.begin(), memory.end());
+			file = {copy, *copy};
+		}
+		auto data = file.span();
+
+		std::string_view text((const char*)data.data(), data.size());
+		file_cache::handle binary;
+		if(data.size() >= 12 && gltf::read<uint32_t>(data.data()) == gltf::glb_magic) {
+			// GLB: header followed by a JSON chunk and an optional binary chunk
+			if(gltf::read<uint32_t>(data.data() + 4) != 2) return fail("Only glTF 2.0 binaries are supported!");
+			text = {};
+			for(size_t at = 12; at + 8 <= data.size(); ) {
+				uint32_t size = gltf::read<uint32_t>(data.data() + at), type = gltf::read<uint32_t>(data.data() + at + 4);
+				if(size > data.size() - at - 8) return fail("glTF binary is truncated!");
+				if(type == gltf::json_chunk && text.empty()) text = {(const char*)data.data() + at + 8, size};
+				else if(type == gltf::binary_chunk && !binary) binary = {file.owner, data.subspan(at + 8, size)};
+				at += 8 + ((size + 3) & ~size_t(3));
+			}
+		}
+
+		gltf::document doc;
+		doc.directory = current_load_path().parent_path();
+		if(auto root = gltf::parse_json(text); root) doc.root = std::move(*root);
+		else return fail("Failed to parse glTF JSON!");
+		if(doc.root["asset"]["version"].string_or() != "2.0") return fail("Only glTF 2.0 is supported!");
+		if(auto& required = doc.root["extensionsRequired"]; !required.array.empty()) // Eg Draco or meshopt compression
+			return fail("glTF requires an unsupported extension: " + required[0].string);
+
+		for(auto& buffer: doc.root["buffers"].array) {
+			auto uri = buffer["uri"].string_or();
+			auto& loaded = doc.buffers->emplace_back(uri.empty() ? binary : gltf::load_uri(uri, doc.directory, ctx.jobs()));
+			if(!uri.empty() && !uri.starts_with("data:")) // External buffers are viewed (writably) by the meshes too
+				if(auto writable = get_file_cache().pin_private(loaded.span())) loaded = std::move(writable);
+			if(!loaded || loaded.span().size() < buffer["byteLength"].index_or(0)) return fail("Failed to load glTF buffer!");
+		}
+
+		gltf::loader loader{ctx, doc};
+		return loader.load().move_to_owned();
+	}
+}}
@@ -18,6 +18,15 @@ namespace stylizer { inline namespace models {
 		return total;
 	}
 
+	bool mesh::has_explicit_meshlets() {
+		auto meshlets = meshlets_view();
+		if(!meshlets || meshlets->empty()) return false;
+		if(meshlets->size() > 1) return true;
+		auto indicies = indicies_view();
+		auto& only = meshlets->front().indicies;
+		return !indicies || only.data() != indicies->data() || only.size() != indicies->size();
+	}
+
 	api::current_backend::buffer* mesh::get_index_buffer(context& ctx, bool rebuild /* = false */) {
 		if(!indicies_view())
 			return nullptr;
@@ -55,12 +64,14 @@ namespace stylizer { inline namespace models {
 	}
 
 	size_t mesh::vertex_count() {
+		// NOTE: Indexed meshes need one more vertex than their largest index
 		uint32_t max = 0;
 		if(auto meshlets = meshlets_view(); meshlets) {
 			for(auto meshlet: *meshlets)
-				max = std::max(max, *std::max_element(meshlet.indicies.begin(), meshlet.indicies.end()));
+				if(meshlet.indicies.size())
+					max = std::max(max, *std::max_element(meshlet.indicies.begin(), meshlet.indicies.end()) + 1);
 		} else if(indicies_view())
-			max = std::max(max, *std::max_element(indicies_view()->begin(), indicies_view()->end()));
+			max = std::max(max, *std::max_element(indicies_view()->begin(), indicies_view()->end()) + 1);
 		else
 			max = attribute_storage(0).size();
 		return max;
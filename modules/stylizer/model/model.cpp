@@ -1,18 +1,147 @@
 #include "api.hpp"
 
+#include "cooked_mesh.hpp"
 #include "dynamic_mesh.hpp"
 
+#include <stylizer/core/util/asset_telemetry.hpp>
+#include <stylizer/core/util/hash.hpp>
+#include <stylizer/core/util/shared_asset_cache.hpp>
+#include <stylizer/image/api.hpp>
+
 namespace stylizer { inline namespace models {
-	std::unordered_map<std::string, std::function<maybe_owned<model>(context&, std::span<std::byte>, std::string_view)>>& model::get_loader_set() {
-		static std::unordered_map<std::string, std::function<maybe_owned<model>(context&, std::span<std::byte>, std::string_view)>> loaders = []{
-			std::unordered_map<std::string, std::function<maybe_owned<model>(context&, std::span<std::byte>, std::string_view)>> out;
-			out[".obj"] = load_tinyobj_model_generic;
-			return out;
-		}();
+	loader_registry<model>& model::get_loader_set() {
+		static loader_registry<model> loaders = {
+			{".obj", load_tinyobj_model_generic},
+			{".gltf", load_gltf_model_generic},
+			{".glb", load_gltf_model_generic},
+			{".ply", load_ply_model_generic},
+			{".stl", load_stl_model_generic},
+			{".smesh", load_cooked_mesh_model_generic},
+		};
 		return loaders;
 	}
+	// Bytes of vertex and index data uploading the model sends to the GPU
+	static size_t upload_size(model& model) {
+		size_t out = 0;
+		for(auto& [mesh, material]: model) {
+			for(auto index: mesh->attribute_indicies())
+				out += mesh->attribute_bytes(index).size();
+			if(auto indices = mesh->indicies_view(); indices)
+				out += indices->size_bytes();
+		}
+		return out;
+	}
+
+	// Whether cooking the model (and mapping it back) loses nothing, cooked meshes only record flat materials whose textures have a path
+	static bool survives_cooking(model& model) {
+		for(auto& [mesh, material]: model) {
+			auto flat = material.value ? dynamic_cast<flat_material*>(&*material) : nullptr;
+			if(!flat) return false;
+			if(std::holds_alternative<stdmath::float4>(flat->color)) continue;
+			if(std::none_of(model.texture_dependencies.begin(), model.texture_dependencies.end(), [flat](auto& dependency) { return dependency.material == flat; }))
+				return false; // Eg textures embedded in a GLB
+		}
+		return true;
+	}
+
+	// Decodes memory with the registered loaders, going through the shared asset cache (when enabled) so that other processes can map the cooked result instead of decoding it again
+	static maybe_owned<model> decode_model(context& ctx, std::span<std::byte> memory, std::string_view extension) {
+		return asset_telemetry::measure_decode(memory, [&]() -> maybe_owned<model> {
+			auto shared = get_shared_asset_cache();
+			if(!shared || extension == ".smesh") return model::get_loader_set()(ctx, memory, extension);
+
+			auto key = shared_asset_cache::make_key(memory, "model", cooked_mesh::version);
+			if(auto found = shared->find(key))
+				return cooked_mesh::load(ctx, std::move(found)).move_to_owned();
+
+			auto decoded = model::get_loader_set()(ctx, memory, extension);
+			if(!decoded.value || !survives_cooking(*decoded)) return decoded;
+			auto published = shared->publish(key, cooked_mesh::serialize(*decoded));
+			if(!published) return decoded;
+
+			// Swap our private copy for the shared mapping
+			for(auto& [mesh, material]: *decoded) {
+				mesh.release();
+				material.release();
+			}
+			decoded.release();
+			return cooked_mesh::load(ctx, std::move(published)).move_to_owned();
+		});
+	}
+
 	maybe_owned<model> model::load(context& ctx, std::filesystem::path file) {
-		return load_file(ctx, file, get_loader_set()[file.extension().string()]);
+		asset_telemetry::scope measure(asset_telemetry::phase::Load, file);
+		return load_file(ctx, file, decode_model);
+	}
+
+	struct shared_model_cache {
+		std::mutex mutex;
+		std::unordered_map<uint64_t, maybe_owned<model>> models;
+
+		static shared_model_cache& get() {
+			static shared_model_cache cache;
+			return cache;
+		}
+	};
+
+	// Materials are created for the frame buffer's attachment formats, so models are only shared between frame buffers with the same ones
+	// NOTE: Keyed on the formats rather than the frame buffer's address, which a later frame buffer could be allocated at
+	static uint64_t attachment_formats_hash(const frame_buffer& fb) {
+		uint64_t out = 0;
+		for(auto& attachment: fb.color_attachments())
+			out = hash_combine(out, attachment.texture ? uint64_t(attachment.texture->texture_format()) + 1 : 0);
+		auto depth = fb.depth_stencil_attachment();
+		return hash_combine(out, depth && depth->texture ? uint64_t(depth->texture->texture_format()) + 1 : 0);
+	}
+
+	model model::load_shared(context& ctx, std::filesystem::path file, const frame_buffer& fb) {
+		asset_telemetry::scope measure(asset_telemetry::phase::Load, file);
+		auto& cache = shared_model_cache::get();
+		auto handle = load_file_handle(file, ctx.jobs());
+		auto hash = hash_combine(content_hash(handle.span()), attachment_formats_hash(fb));
+
+		std::unique_lock lock(cache.mutex);
+		auto found = cache.models.find(hash);
+		if(found == cache.models.end()) {
+			lock.unlock();
+			current_load_path_scope scope(file);
+			auto loaded = decode_model(ctx, handle.span(), file.extension().string());
+			if(!loaded.value) return {};
+			{
+				asset_telemetry::scope measure(asset_telemetry::phase::Upload);
+				if(get_asset_telemetry().enabled()) get_asset_telemetry().record_upload(upload_size(*loaded));
+				loaded->upload(ctx, fb);
+			}
+			lock.lock();
+			bool inserted;
+			std::tie(found, inserted) = cache.models.try_emplace(hash, std::move(loaded));
+			if(!inserted) { // Someone else loaded the same model meanwhile, theirs wins
+				for(auto& [mesh, material]: *loaded) {
+					mesh.release();
+					material.release();
+				}
+				loaded.release();
+			}
+		}
+
+		model out;
+		for(auto& [mesh, material]: *found->second)
+			out.emplace_back(mesh.value, material.value); // NOTE: Not dereferenced, the material may be null
+		out.texture_dependencies = found->second->texture_dependencies;
+		return out;
+	}
+
+	void model::clear_shared_cache() {
+		auto& cache = shared_model_cache::get();
+		std::scoped_lock lock(cache.mutex);
+		for(auto& [hash, model]: cache.models) {
+			for(auto& [mesh, material]: *model) {
+				mesh.release();
+				material.release();
+			}
+			model.release();
+		}
+		cache.models.clear();
 	}
 
 	model& model::override_materials(material& override_material) {
@@ -22,6 +151,12 @@ namespace stylizer { inline namespace models {
 	}
 
 	model& model::upload(context& ctx, const frame_buffer& fb) {
+		if(!ctx.is_owner_thread()) { // GPU objects are only created by the context's owner
+			auto uploaded = ctx.run_on_owner([&] { upload(ctx, fb); });
+			ctx.wait(uploaded);
+			return *this;
+		}
+
 		for(auto& [mesh, material]: *this) {
 			if(mesh.owned) 
 				mesh->rebuild_gpu_caches(ctx);
@@ -36,6 +171,47 @@ namespace stylizer { inline namespace models {
 		return *this;
 	}
 
+	model& model::watch_for_changes(context& ctx, std::filesystem::path file, const frame_buffer& fb) {
+		auto& watcher = file_watcher::get_default().poll_on_update(ctx);
+		hot_reload_tokens.clear();
+
+		hot_reload_tokens.emplace_back(watcher.watch(file, [this, &ctx, file, &fb](const std::filesystem::path&) {
+			auto reloaded = load(ctx, file);
+			if(!reloaded.value) return;
+
+			// Assigning the vector would just drop the old meshes and materials (and their GPU objects)
+			for(auto& [mesh, material]: *this) {
+				mesh.release();
+				material.release();
+			}
+			// NOTE: This replaces (and thus releases) the token whose callback is currently running, the watcher keeps its own copy alive until we return
+			static_cast<std::vector<std::pair<maybe_owned<mesh>, maybe_owned<material>>>&>(*this) = std::move(*reloaded);
+			texture_dependencies = std::move(reloaded->texture_dependencies);
+			reloaded.release();
+			upload(ctx, fb);
+			watch_for_changes(ctx, file, fb);
+		}));
+
+		for(auto& dependency: texture_dependencies)
+			hot_reload_tokens.emplace_back(watcher.watch(dependency.file, [&ctx, material = dependency.material](const std::filesystem::path& file) {
+				auto color = std::get_if<maybe_owned<texture>>(&material->color);
+				if(!color) return;
+
+				auto reloaded = image::load(ctx, file);
+				if(!reloaded.value) return;
+				reloaded->upload(ctx, **color, with_mip_levels());
+				reloaded.release();
+				material->upload(ctx); // Rebinds the texture in case it had to be recreated
+			}));
+		return *this;
+	}
+
+	model::draw_call model::draw_call_for(mesh& mesh, size_t instance_count) {
+		if(mesh.indicies_view())
+			return {true, mesh.index_count(), instance_count};
+		return {false, mesh.vertex_count(), instance_count};
+	}
+
 	api::current_backend::render::pass& model::draw_instanced(
 		context& ctx, api::current_backend::render::pass& render_pass,
 		instance_data::buffer_base& instance_data, std::optional<utility_buffer> util /* = {} */
@@ -49,7 +225,8 @@ namespace stylizer { inline namespace models {
 				render_pass.bind_render_group(ctx, group);
 
 			// TODO: implement meshlets
-			if(mesh.meshlets_view())
+			// NOTE: Indexed meshes all report the implicit meshlet covering their index data, that one is just drawn as an indexed mesh
+			if(mesh.has_explicit_meshlets())
 				assert(false && "Meshlets are not currently supported!");
 			auto* index_buffer = mesh.get_index_buffer(ctx);
 			if(index_buffer) render_pass.bind_index_buffer(ctx, *index_buffer);
@@ -57,9 +234,10 @@ namespace stylizer { inline namespace models {
 			for(size_t i = 0; i < vertex_buffers.size(); ++i)
 				render_pass.bind_vertex_buffer(ctx, i, vertex_buffers[i]);
 
-			if(index_buffer)
-				render_pass.draw_indexed(ctx, mesh.index_count());
-			else render_pass.draw(ctx, mesh.vertex_count(), instance_data.count());
+			auto call = draw_call_for(mesh, instance_data.count());
+			if(call.indexed)
+				render_pass.draw_indexed(ctx, call.count, call.instance_count);
+			else render_pass.draw(ctx, call.count, call.instance_count);
 		}
 
 		return render_pass;
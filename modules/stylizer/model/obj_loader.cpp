@@ -0,0 +1,468 @@
+#include "dynamic_mesh.hpp"
+
+#include <stylizer/core/util/hash.hpp>
+#include <stylizer/core/util/thread_pool.hpp>
+#include <stylizer/image/api.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include <sstream>
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "thirdparty/tinyobjloader.h" // NOTE: Only used to parse MTL files, OBJ files are parsed in place below
+
+namespace stylizer { inline namespace models {
+
+	namespace obj {
+		inline bool is_space(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f'; }
+
+		inline void skip_space(std::string_view& s) {
+			size_t i = 0;
+			while(i < s.size() && is_space(s[i])) ++i;
+			s.remove_prefix(i);
+		}
+
+		inline std::string_view next_token(std::string_view& s) {
+			skip_space(s);
+			size_t i = 0;
+			while(i < s.size() && !is_space(s[i])) ++i;
+			auto out = s.substr(0, i);
+			s.remove_prefix(i);
+			return out;
+		}
+
+		// Splits off the next line (without its terminator or trailing comment)
+		inline bool next_line(std::string_view& rest, std::string_view& line) {
+			if(rest.empty()) return false;
+			auto end = (const char*)std::memchr(rest.data(), '\n', rest.size());
+			size_t size = end ? end - rest.data() : rest.size();
+			line = rest.substr(0, size);
+			rest.remove_prefix(std::min(size + 1, rest.size()));
+			if(auto comment = line.find('#'); comment != line.npos) line = line.substr(0, comment);
+			return true;
+		}
+
+		inline size_t count_tokens(std::string_view s) {
+			size_t count = 0;
+			while(!next_token(s).empty()) ++count;
+			return count;
+		}
+
+		// Parses up to max floats, returns how many were read
+		inline size_t parse_floats(std::string_view s, float* out, size_t max) {
+			size_t count = 0;
+			for(; count < max; ++count) {
+				skip_space(s);
+				if(s.empty()) break;
+
+				auto begin = s.data() + (s.front() == '+'), end = s.data() + s.size();
+				auto [ptr, ec] = std::from_chars(begin, end, out[count]);
+				if(ec == std::errc::invalid_argument) break;
+				if(ec == std::errc::result_out_of_range) out[count] = 0;
+				s.remove_prefix(ptr - s.data());
+			}
+			return count;
+		}
+
+		// OBJ indices are one based, 0 marks a missing index and negative indices are relative to the end
+		struct corner { int64_t position = 0, uv = 0, normal = 0; };
+		inline corner parse_corner(std::string_view token) {
+			corner out;
+			for(auto field: {&out.position, &out.uv, &out.normal}) {
+				auto slash = token.find('/');
+				auto part = token.substr(0, slash);
+				if(!part.empty())
+					std::from_chars(part.data() + (part.front() == '+'), part.data() + part.size(), *field);
+				if(slash == token.npos) break;
+				token.remove_prefix(slash + 1);
+			}
+			return out;
+		}
+
+		// Returns count (which is always out of range) for missing or invalid indices
+		inline size_t resolve(int64_t index, size_t count) {
+			if(index > 0) return std::min<size_t>(index - 1, count);
+			if(index < 0 && size_t(-index) <= count) return count + index;
+			return count;
+		}
+
+		// Every (shape, material) pair with faces becomes its own mesh
+		struct group {
+			size_t shape;
+			int material;
+			size_t corners = 0;
+			bool has_normals = false, has_uvs = false;
+		};
+
+		// Statements which change which group faces belong to, along with the runs of faces between them
+		struct event {
+			enum class kind { Shape, Material, Faces } kind;
+			int material = -1;
+			size_t corners = 0;
+			bool has_normals = false, has_uvs = false;
+			// Filled in when merging
+			size_t group = 0, offset = 0;
+		};
+
+		// Files are split at line boundaries into chunks which are each scanned and parsed on their own
+		struct chunk {
+			std::string_view text;
+			size_t positions = 0, normals = 0, uvs = 0;
+			bool has_colors = false;
+			std::vector<event> events;
+			// Filled in when merging, where this chunk's vertices start in the vertex pools
+			size_t position_base = 0, normal_base = 0, uv_base = 0;
+		};
+
+		inline std::vector<chunk> split(std::string_view text, size_t max_chunks, size_t min_chunk_size) {
+			size_t count = std::clamp<size_t>(text.size() / min_chunk_size, 1, std::max<size_t>(max_chunks, 1));
+			size_t target = text.size() / count + 1;
+
+			std::vector<chunk> out;
+			while(!text.empty()) {
+				auto end = text.size() <= target ? text.npos : text.find('\n', target);
+				size_t size = end == text.npos ? text.size() : end + 1;
+				out.push_back({text.substr(0, size)});
+				text.remove_prefix(size);
+			}
+			return out;
+		}
+
+		inline int lookup_material(std::string_view name, const std::map<std::string, int>& materials) {
+			auto found = materials.find(std::string(name));
+			return found == materials.end() ? -1 : found->second;
+		}
+
+		// First pass (run per chunk), counts everything so that later passes can write into exactly sized storage
+		inline void scan(chunk& chunk, const std::map<std::string, int>& materials) {
+			std::string_view text = chunk.text, line;
+			while(next_line(text, line)) {
+				auto keyword = next_token(line);
+				if(keyword == "v") {
+					++chunk.positions;
+					if(!chunk.has_colors) chunk.has_colors = count_tokens(line) >= 6;
+				} else if(keyword == "vn") ++chunk.normals;
+				else if(keyword == "vt") ++chunk.uvs;
+				else if(keyword == "f") {
+					auto first = parse_corner(next_token(line));
+					size_t count = 1 + count_tokens(line);
+					if(count < 3) continue;
+
+					if(chunk.events.empty() || chunk.events.back().kind != event::kind::Faces)
+						chunk.events.push_back({event::kind::Faces});
+					auto& faces = chunk.events.back();
+					faces.corners += 3 * (count - 2);
+					faces.has_uvs |= first.uv != 0;
+					faces.has_normals |= first.normal != 0;
+				} else if(keyword == "o" || keyword == "g") chunk.events.push_back({event::kind::Shape});
+				else if(keyword == "usemtl") chunk.events.push_back({event::kind::Material, lookup_material(next_token(line), materials)});
+			}
+		}
+
+		// Replays every chunk's events in file order, assigning each run of faces a group and a place within it
+		// NOTE: Groups are created in the order they first appear so the output doesn't depend on how the file was chunked
+		inline std::vector<group> merge(std::span<chunk> chunks, bool& has_colors) {
+			std::vector<group> groups;
+			std::unordered_map<int, size_t> shape_groups; // Material -> group in the current shape
+			size_t shape = 0;
+			int material = -1;
+			bool shape_has_faces = false;
+
+			size_t positions = 0, normals = 0, uvs = 0;
+			has_colors = false;
+			for(auto& chunk: chunks) {
+				chunk.position_base = std::exchange(positions, positions + chunk.positions);
+				chunk.normal_base = std::exchange(normals, normals + chunk.normals);
+				chunk.uv_base = std::exchange(uvs, uvs + chunk.uvs);
+				has_colors |= chunk.has_colors;
+
+				for(auto& event: chunk.events) {
+					if(event.kind == event::kind::Shape) {
+						if(shape_has_faces) ++shape;
+						shape_has_faces = false;
+					} else if(event.kind == event::kind::Material)
+						material = event.material;
+					else {
+						if(!shape_has_faces) shape_groups.clear();
+						shape_has_faces = true;
+
+						auto [found, created] = shape_groups.try_emplace(material, groups.size());
+						if(created) groups.push_back({shape, material});
+						auto& group = groups[found->second];
+						event.group = found->second;
+						event.offset = std::exchange(group.corners, group.corners + event.corners);
+						group.has_uvs |= event.has_uvs;
+						group.has_normals |= event.has_normals;
+					}
+				}
+			}
+			return groups;
+		}
+
+		struct vertex_pools {
+			std::vector<stdmath::float4> positions, colors, normals;
+			std::vector<stdmath::float2> uvs;
+		};
+
+		// Second pass (run per chunk), parses this chunk's vertex data into its slice of the pools
+		inline void parse_vertices(const chunk& chunk, bool has_colors, vertex_pools& pools) {
+			auto position = pools.positions.data() + chunk.position_base;
+			auto color = has_colors ? pools.colors.data() + chunk.position_base : nullptr;
+			auto normal = pools.normals.data() + chunk.normal_base;
+			auto uv = pools.uvs.data() + chunk.uv_base;
+
+			std::string_view text = chunk.text, line;
+			while(next_line(text, line)) {
+				auto keyword = next_token(line);
+				if(keyword == "v") {
+					float v[6] = {0, 0, 0, 1, 1, 1};
+					auto count = parse_floats(line, v, 6);
+					*position++ = {v[0], v[1], v[2], 0};
+					if(color) {
+						if(count < 6) v[3] = v[4] = v[5] = 1;
+						*color++ = {v[3], v[4], v[5], 1};
+					}
+				} else if(keyword == "vn") {
+					float v[3] = {0, 0, 0};
+					parse_floats(line, v, 3);
+					*normal++ = {v[0], v[1], v[2], 0};
+				} else if(keyword == "vt") {
+					float v[2] = {0, 0};
+					parse_floats(line, v, 2);
+					*uv++ = {v[0], v[1]}; // TODO: Why is the v axis inverted!?!?
+				}
+			}
+		}
+
+		// A face corner's (position, uv, normal) indices into the vertex pools, corners with the same ones become the same vertex
+		struct corner_key {
+			static constexpr uint32_t none = std::numeric_limits<uint32_t>::max();
+			uint32_t position = none, uv = none, normal = none;
+			bool operator==(const corner_key&) const = default;
+		};
+
+		// Third pass (run per chunk), writes the keys of (triangulated) face corners straight into each group's slice of corners
+		// NOTE: Returns false if a face references a vertex which doesn't exist
+		inline bool parse_faces(const chunk& chunk, std::span<const group> groups, std::span<std::vector<corner_key>> out) {
+			// Negative indices are relative to the vertices defined so far
+			size_t positions = chunk.position_base, normals = chunk.normal_base, uvs = chunk.uv_base;
+			size_t next_event = 0, at = 0;
+			const event* faces = nullptr;
+			std::vector<corner> corners;
+
+			std::string_view text = chunk.text, line;
+			while(next_line(text, line)) {
+				auto keyword = next_token(line);
+				if(keyword == "v") ++positions;
+				else if(keyword == "vn") ++normals;
+				else if(keyword == "vt") ++uvs;
+				else if(keyword == "f") {
+					corners.clear();
+					for(auto token = next_token(line); !token.empty(); token = next_token(line))
+						corners.push_back(parse_corner(token));
+					if(corners.size() < 3) continue;
+
+					if(!faces) {
+						faces = &chunk.events[next_event++];
+						at = faces->offset;
+					}
+					auto& group = groups[faces->group];
+					auto keys = out[faces->group].data();
+					auto emit = [&](const corner& c) -> bool {
+						auto& key = keys[at++];
+						auto p = resolve(c.position, positions);
+						if(p >= positions) return false;
+						key.position = p;
+
+						if(group.has_normals && c.normal) {
+							auto n = resolve(c.normal, normals);
+							if(n >= normals) return false;
+							key.normal = n;
+						}
+						if(group.has_uvs && c.uv) {
+							auto t = resolve(c.uv, uvs);
+							if(t >= uvs) return false;
+							key.uv = t;
+						}
+						return true;
+					};
+
+					// Fan triangulation
+					for(size_t i = 1; i + 1 < corners.size(); ++i)
+						if(!emit(corners[0]) || !emit(corners[i]) || !emit(corners[i + 1]))
+							return false;
+				} else if(keyword == "o" || keyword == "g" || keyword == "usemtl") {
+					faces = nullptr;
+					++next_event;
+				}
+			}
+			return true;
+		}
+
+		// Corners with the same key share a vertex, so the mesh comes out indexed without ever storing a vertex per corner
+		inline stylizer::dynamic_mesh make_mesh(std::span<const corner_key> corners, const group& group, const vertex_pools& pools) {
+			auto& scratch = thread_pool::scratch();
+			auto scope = scratch.make_scope();
+			constexpr uint32_t empty = std::numeric_limits<uint32_t>::max();
+			auto table = scratch.allocate<uint32_t>(std::bit_ceil(std::max<size_t>(corners.size() * 2, 2)));
+			std::fill(table.begin(), table.end(), empty);
+
+			std::vector<corner_key> vertices;
+			std::vector<uint32_t> indices(corners.size());
+			for(size_t i = 0; i < corners.size(); ++i) {
+				auto& key = corners[i];
+				auto hash = content_hash(std::as_bytes(std::span(&key, 1)));
+				for(size_t slot = hash & (table.size() - 1); ; slot = (slot + 1) & (table.size() - 1)) {
+					if(table[slot] == empty) {
+						table[slot] = indices[i] = vertices.size();
+						vertices.push_back(key);
+						break;
+					}
+					if(vertices[table[slot]] == key) {
+						indices[i] = table[slot];
+						break;
+					}
+				}
+			}
+
+			// NOTE: Colors are only stored if some vertex in the file has them, and corners without a normal or uv get zeros
+			stylizer::storage<stdmath::float4> positions, colors, normals;
+			stylizer::storage<stdmath::float2> uvs;
+			positions.resize(vertices.size());
+			if(!pools.colors.empty()) colors.resize(vertices.size());
+			if(group.has_normals) normals.resize(vertices.size());
+			if(group.has_uvs) uvs.resize(vertices.size());
+			for(size_t v = 0; v < vertices.size(); ++v) {
+				auto& key = vertices[v];
+				positions.data()[v] = pools.positions[key.position];
+				if(colors.size()) colors.data()[v] = pools.colors[key.position];
+				if(normals.size()) normals.data()[v] = key.normal == corner_key::none ? stdmath::float4(0, 0, 0, 0) : pools.normals[key.normal];
+				if(uvs.size()) uvs.data()[v] = key.uv == corner_key::none ? stdmath::float2(0, 0) : pools.uvs[key.uv];
+			}
+
+			stylizer::dynamic_mesh mesh;
+			mesh.add_vertex_attribute(stylizer::common_mesh_attributes::positions, std::move(positions));
+			if(colors.size()) mesh.add_vertex_attribute(stylizer::common_mesh_attributes::colors, std::move(colors));
+			if(normals.size()) mesh.add_vertex_attribute(stylizer::common_mesh_attributes::normals, std::move(normals));
+			if(uvs.size()) mesh.add_vertex_attribute(stylizer::common_mesh_attributes::uvs, std::move(uvs));
+			mesh.index_data = std::move(indices);
+			return mesh;
+		}
+	}
+
+	std::optional<obj_geometry> parse_obj_geometry(thread_pool& pool, std::string_view text, const std::map<std::string, int>& materials, size_t max_chunks, size_t min_chunk_size /* = 4 * 1024 * 1024 */) {
+		// NOTE: The text is read straight out of the (mapped) memory, only the vertex pools, the corners' keys, and the final meshes are allocated
+		auto chunks = obj::split(text, max_chunks, min_chunk_size);
+		if(chunks.empty()) return obj_geometry{};
+		pool.parallel_for(chunks.size(), [&](size_t i) {
+			obj::scan(chunks[i], materials);
+		});
+
+		bool has_colors;
+		auto groups = obj::merge(chunks, has_colors);
+		obj::vertex_pools pools;
+		pools.positions.resize(chunks.back().position_base + chunks.back().positions);
+		if(std::max({pools.positions.size(), chunks.back().normal_base + chunks.back().normals, chunks.back().uv_base + chunks.back().uvs}) >= obj::corner_key::none) {
+			stylizer::get_error_handler()(stylizer::error_severity::Error, "OBJ file has too many vertices!", 0);
+			return {};
+		}
+		if(has_colors) pools.colors.resize(pools.positions.size());
+		pools.normals.resize(chunks.back().normal_base + chunks.back().normals);
+		pools.uvs.resize(chunks.back().uv_base + chunks.back().uvs);
+
+		std::vector<std::vector<obj::corner_key>> corners(groups.size());
+		pool.parallel_for(chunks.size() + groups.size(), [&](size_t i) {
+			if(i < chunks.size()) return obj::parse_vertices(chunks[i], has_colors, pools);
+			corners[i - chunks.size()].resize(groups[i - chunks.size()].corners); // Overlaps with parsing the vertices
+		});
+
+		std::atomic<bool> valid = true;
+		pool.parallel_for(chunks.size(), [&](size_t i) {
+			if(!obj::parse_faces(chunks[i], groups, corners))
+				valid = false;
+		});
+		if(!valid) {
+			stylizer::get_error_handler()(stylizer::error_severity::Error, "OBJ face references a vertex which doesn't exist!", 0);
+			return {};
+		}
+
+		obj_geometry out;
+		out.meshes.resize(groups.size());
+		pool.parallel_for(groups.size(), [&](size_t i) {
+			out.meshes[i] = obj::make_mesh(corners[i], groups[i], pools);
+			corners[i] = {};
+		});
+		for(auto& group: groups) {
+			out.shapes.push_back(group.shape);
+			out.materials.push_back(group.material);
+		}
+		return out;
+	}
+
+	model load_tinyobj_model_with_material(stylizer::context& ctx, std::span<std::byte> memory, std::span<std::byte> mtl) {
+		std::map<std::string, int> material_ids;
+		std::vector<tinyobj::material_t> materials;
+		if(!mtl.empty()) {
+			std::istringstream stream(std::string((char*)mtl.data(), mtl.size())); // NOTE: MTL files are tiny, so copying is fine
+			std::string warning, error;
+			tinyobj::LoadMtl(&material_ids, &materials, &stream, &warning, &error);
+			if(!error.empty())
+				stylizer::get_error_handler()(stylizer::error_severity::Error, error, 0);
+			if(!warning.empty())
+				stylizer::get_error_handler()(stylizer::error_severity::Warning, warning, 0);
+		}
+
+		auto geometry = parse_obj_geometry(ctx.jobs(), {(const char*)memory.data(), memory.size()}, material_ids, ctx.jobs().size() * 4);
+		if(!geometry) return {};
+		auto& meshes = geometry->meshes;
+
+		// Every texture is decoded concurrently and uploaded in one batch up front, rather than one at a time as the materials are created
+		// NOTE: Texture paths are relative to the OBJ (when we know where it came from) rather than the working directory
+		auto directory = current_load_path().parent_path();
+		std::vector<std::filesystem::path> texture_paths;
+		std::unordered_map<int, size_t> texture_indices; // Material to its texture_path
+		for(auto material: geometry->materials)
+			if(material >= 0 && material < int(materials.size()) && !materials[material].diffuse_texname.empty() && !texture_indices.contains(material)) {
+				texture_indices[material] = texture_paths.size();
+				std::filesystem::path texture = materials[material].diffuse_texname;
+				texture_paths.push_back(texture.is_relative() ? directory / texture : texture);
+			}
+		// NOTE: Shared so that every material (in every model) using the same texture shares a single upload
+		auto textures = stylizer::image::load_shared_textures(ctx, texture_paths);
+
+		stylizer::model out;
+		std::unordered_map<int, stylizer::flat_material*> material_map;
+		for(size_t i = 0; i < meshes.size(); ++i) {
+			auto mat = geometry->materials[i];
+			if(mat >= int(materials.size())) mat = -1;
+
+			if(!material_map.contains(mat)) {
+				stylizer::flat_material material;
+				if(mat >= 0) material.color = stdmath::float4(materials[mat].diffuse[0], materials[mat].diffuse[1], materials[mat].diffuse[2], 1);
+				else material.color = stdmath::float4(.5, .5, .5, 1);
+
+				std::filesystem::path texture_path;
+				if(auto texture = texture_indices.find(mat); texture != texture_indices.end() && textures[texture->second]) { // Textures which failed to load keep the diffuse color
+					texture_path = texture_paths[texture->second];
+					material.color = stylizer::maybe_owned<stylizer::texture>(textures[texture->second]);
+				}
+
+				auto& real = out.emplace_back(meshes[i].move_to_owned(), material.move_to_owned());
+				material_map[mat] = (stylizer::flat_material*)&*real.second;
+				if(!texture_path.empty()) out.texture_dependencies.push_back({texture_path, material_map[mat]});
+				continue;
+			}
+
+			out.emplace_back(meshes[i].move_to_owned(), material_map[mat]);
+		}
+
+		return out;
+	}
+
+	model load_tinyobj_model(stylizer::context& ctx, std::span<std::byte> memory, std::string_view extension /* = {} */) {
+		return load_tinyobj_model_with_material(ctx, memory, {});
+	}
+}}
@@ -0,0 +1,381 @@
+#include "dynamic_mesh.hpp"
+
+#include <stylizer/core/util/endian.hpp>
+#include <stylizer/core/util/thread_pool.hpp>
+
+#include <atomic>
+#include <charconv>
+
+namespace stylizer { inline namespace models {
+
+	namespace ply {
+		enum class type { Invalid, Int8, Uint8, Int16, Uint16, Int32, Uint32, Float32, Float64 };
+
+		inline type parse_type(std::string_view name) {
+			if(name == "char" || name == "int8") return type::Int8;
+			if(name == "uchar" || name == "uint8") return type::Uint8;
+			if(name == "short" || name == "int16") return type::Int16;
+			if(name == "ushort" || name == "uint16") return type::Uint16;
+			if(name == "int" || name == "int32") return type::Int32;
+			if(name == "uint" || name == "uint32") return type::Uint32;
+			if(name == "float" || name == "float32") return type::Float32;
+			if(name == "double" || name == "float64") return type::Float64;
+			return type::Invalid;
+		}
+
+		inline size_t type_size(type type) {
+			if(type == type::Int8 || type == type::Uint8) return 1;
+			if(type == type::Int16 || type == type::Uint16) return 2;
+			if(type == type::Float64) return 8;
+			return 4;
+		}
+
+		struct property {
+			std::string name;
+			enum type type;
+			enum type count_type = type::Invalid; // Only set for list properties
+			size_t offset = 0; // Within the element, only meaningful while every property before it is fixed size
+
+			bool is_list() const { return count_type != type::Invalid; }
+		};
+
+		struct element {
+			std::string name;
+			size_t count = 0;
+			std::vector<property> properties;
+			size_t size = 0; // Zero if the element holds lists (and thus varies in size)
+
+			const property* find(std::string_view name) const {
+				for(auto& property: properties)
+					if(property.name == name) return &property;
+				return nullptr;
+			}
+		};
+
+		struct header {
+			std::endian endian;
+			std::vector<element> elements;
+			size_t data_offset;
+		};
+
+		inline std::string_view next_word(std::string_view& line) {
+			auto start = line.find_first_not_of(" \t\r");
+			if(start == line.npos) return line = {};
+			auto end = line.find_first_of(" \t\r", start);
+			auto out = line.substr(start, end == line.npos ? line.npos : end - start);
+			line = end == line.npos ? std::string_view{} : line.substr(end);
+			return out;
+		}
+
+		inline std::optional<header> parse_header(std::string_view text, std::string& error) {
+			header out;
+			size_t at = 0;
+			bool first = true, has_format = false;
+			while(true) {
+				auto end = text.find('\n', at);
+				if(end == text.npos) {
+					error = "PLY header is missing end_header!";
+					return {};
+				}
+				auto line = text.substr(at, end - at);
+				at = end + 1;
+
+				auto keyword = next_word(line);
+				if(first) {
+					if(keyword != "ply") {
+						error = "Not a PLY file!";
+						return {};
+					}
+					first = false;
+				} else if(keyword == "format") {
+					auto format = next_word(line);
+					if(format == "binary_little_endian") out.endian = std::endian::little;
+					else if(format == "binary_big_endian") out.endian = std::endian::big;
+					else {
+						error = "Only binary PLY files are supported!";
+						return {};
+					}
+					has_format = true;
+				} else if(keyword == "element") {
+					auto& element = out.elements.emplace_back();
+					element.name = next_word(line);
+					auto count = next_word(line);
+					if(std::from_chars(count.data(), count.data() + count.size(), element.count).ec != std::errc{}) {
+						error = "PLY element has an invalid count!";
+						return {};
+					}
+				} else if(keyword == "property") {
+					if(out.elements.empty()) {
+						error = "PLY property is outside of an element!";
+						return {};
+					}
+					auto& element = out.elements.back();
+					property property;
+					auto type = next_word(line);
+					if(type == "list") {
+						property.count_type = parse_type(next_word(line));
+						type = next_word(line);
+						if(property.count_type == type::Invalid || property.count_type == type::Float32 || property.count_type == type::Float64) {
+							error = "PLY list has an invalid count type!";
+							return {};
+						}
+					}
+					property.type = parse_type(type);
+					property.name = next_word(line);
+					if(property.type == type::Invalid) {
+						error = "PLY property `" + property.name + "` has an invalid type!";
+						return {};
+					}
+					element.properties.emplace_back(std::move(property));
+				} else if(keyword == "end_header") break;
+				// Comments and obj_info lines are ignored
+			}
+			if(!has_format) {
+				error = "PLY header is missing its format!";
+				return {};
+			}
+
+			for(auto& element: out.elements) {
+				bool fixed = true;
+				for(auto& property: element.properties) {
+					property.offset = element.size;
+					if(property.is_list()) fixed = false;
+					else element.size += type_size(property.type);
+				}
+				if(!fixed) element.size = 0;
+			}
+			out.data_offset = at;
+			return out;
+		}
+
+		template<typename T>
+		inline T read(type type, const std::byte* at, std::endian endian) {
+			switch(type) {
+			case type::Int8: return T(load_endian<int8_t>(at, endian));
+			case type::Uint8: return T(load_endian<uint8_t>(at, endian));
+			case type::Int16: return T(load_endian<int16_t>(at, endian));
+			case type::Uint16: return T(load_endian<uint16_t>(at, endian));
+			case type::Int32: return T(load_endian<int32_t>(at, endian));
+			case type::Uint32: return T(load_endian<uint32_t>(at, endian));
+			case type::Float32: return T(load_endian<float>(at, endian));
+			default: return T(load_endian<double>(at, endian));
+			}
+		}
+
+		// Where each of an output's components comes from in the vertex record
+		template<size_t N>
+		struct mapping {
+			std::array<const property*, N> sources = {};
+			float scale = 1; // Integer colors are normalized
+
+			bool any() const { return std::any_of(sources.begin(), sources.end(), [](auto source) { return source; }); }
+
+			// NOTE: Components stored as consecutive native floats are copied in bulk
+			bool bulk(std::endian endian) const {
+				if(endian != std::endian::native || scale != 1) return false;
+				for(size_t i = 0; i < N; ++i)
+					if(!sources[i] || sources[i]->type != type::Float32 || sources[i]->offset != sources[0]->offset + i * sizeof(float))
+						return false;
+				return true;
+			}
+
+			void read(const std::byte* vertex, std::endian endian, float* out) const {
+				for(size_t i = 0; i < N; ++i)
+					if(sources[i]) out[i] = ply::read<float>(sources[i]->type, vertex + sources[i]->offset, endian) * scale;
+			}
+		};
+
+		template<size_t N>
+		inline mapping<N> find(const element& vertex, std::initializer_list<std::array<std::string_view, N>> candidates) {
+			mapping<N> out;
+			for(auto& names: candidates) {
+				for(size_t i = 0; i < N; ++i) {
+					auto property = vertex.find(names[i]);
+					out.sources[i] = property && !property->is_list() ? property : nullptr;
+				}
+				if(out.any()) return out;
+			}
+			return out;
+		}
+
+		// Calls func(first index, count) for each polygon of a face element, stops early (returning false) if the data runs out
+		template<typename Tfunc>
+		inline bool for_each_face(std::span<const std::byte> data, const element& faces, const property& indices, std::endian endian, size_t& consumed, const Tfunc& func) {
+			auto at = data.data(), end = data.data() + data.size();
+			for(size_t f = 0; f < faces.count; ++f)
+				for(auto& property: faces.properties) {
+					if(!property.is_list()) {
+						if(size_t(end - at) < type_size(property.type)) return false;
+						at += type_size(property.type);
+						continue;
+					}
+
+					if(size_t(end - at) < type_size(property.count_type)) return false;
+					auto count = read<size_t>(property.count_type, at, endian);
+					at += type_size(property.count_type);
+					if(size_t(end - at) / type_size(property.type) < count) return false;
+					if(&property == &indices) func(at, count);
+					at += count * type_size(property.type);
+				}
+			consumed = at - data.data();
+			return true;
+		}
+	}
+
+	model load_ply_model(std::span<std::byte> memory, thread_pool& pool /* = thread_pool::get_default() */) {
+		auto fail = [](std::string_view message) {
+			get_error_handler()(stylizer::error_severity::Error, message, 0);
+			return model{};
+		};
+
+		std::string error;
+		auto header = ply::parse_header({(const char*)memory.data(), memory.size()}, error);
+		if(!header) return fail(error);
+		auto endian = header->endian;
+
+		// Walk the elements in order, skipping any we don't care about
+		std::span<const std::byte> data = memory.subspan(header->data_offset);
+		const ply::element* vertex = nullptr, * faces = nullptr;
+		std::span<const std::byte> vertex_data, face_data;
+		for(auto& element: header->elements) {
+			size_t size = element.size * element.count;
+			if(element.size == 0) {
+				if(element.count == 0) size = 0;
+				else {
+					auto indices = std::find_if(element.properties.begin(), element.properties.end(), [](auto& p) { return p.is_list(); });
+					if(!ply::for_each_face(data, element, *indices, endian, size, [](auto...) {}))
+						return fail("PLY element `" + element.name + "` is truncated!");
+				}
+			} else if(element.count && data.size() / element.size < element.count) return fail("PLY element `" + element.name + "` is truncated!");
+
+			if(element.name == "vertex" && !vertex) {
+				vertex = &element;
+				vertex_data = data.first(size);
+			} else if(element.name == "face" && !faces) {
+				faces = &element;
+				face_data = data.first(size);
+			}
+			data = data.subspan(size);
+		}
+		if(!vertex || vertex->count == 0) return {};
+		if(vertex->size == 0) return fail("PLY vertices with list properties are not supported!");
+		size_t vertices = vertex->count;
+
+		auto positions = ply::find<3>(*vertex, {{"x", "y", "z"}});
+		auto normals = ply::find<3>(*vertex, {{"nx", "ny", "nz"}});
+		auto colors = ply::find<4>(*vertex, {{"red", "green", "blue", "alpha"}, {"r", "g", "b", "a"}, {"diffuse_red", "diffuse_green", "diffuse_blue", "diffuse_alpha"}});
+		auto uvs = ply::find<2>(*vertex, {{"u", "v"}, {"s", "t"}, {"texture_u", "texture_v"}, {"texture_s", "texture_t"}});
+		if(!positions.any()) return fail("PLY vertices have no positions!");
+		if(colors.any()) {
+			auto type = (*std::find_if(colors.sources.begin(), colors.sources.end(), [](auto source) { return source; }))->type;
+			if(type != ply::type::Float32 && type != ply::type::Float64)
+				colors.scale = 1.f / ((1ull << (ply::type_size(type) * 8)) - 1);
+		}
+
+		stylizer::storage<stdmath::float4> position_storage, normal_storage, color_storage;
+		stylizer::storage<stdmath::float2> uv_storage;
+		position_storage.resize(vertices);
+		color_storage.resize(vertices);
+		if(normals.any()) normal_storage.resize(vertices);
+		if(uvs.any()) uv_storage.resize(vertices);
+
+		// Every vertex record is the same size, so the vertices are decoded in parallel
+		size_t batches = std::min(std::max<size_t>(vertices / 65536, 1), std::max<size_t>(pool.size(), 1) * 4);
+		pool.parallel_for(batches, [&](size_t batch) {
+			size_t begin = vertices * batch / batches, end = vertices * (batch + 1) / batches;
+			auto decode = [&](auto& mapping, auto& storage, float fill_w) {
+				constexpr size_t components = std::tuple_size_v<decltype(mapping.sources)>;
+				auto out = (float*)storage.data();
+				size_t stride = storage.byte_span().size() / vertices / sizeof(float);
+				bool bulk = mapping.bulk(endian);
+				for(size_t i = begin; i < end; ++i) {
+					auto record = vertex_data.data() + i * vertex->size;
+					auto to = out + i * stride;
+					if(stride == 4) to[3] = fill_w;
+					if(bulk) std::memcpy(to, record + mapping.sources[0]->offset, components * sizeof(float));
+					else mapping.read(record, endian, to);
+				}
+			};
+
+			decode(positions, position_storage, 0);
+			if(normals.any()) decode(normals, normal_storage, 0);
+			if(uvs.any()) decode(uvs, uv_storage, 0);
+			if(colors.any()) decode(colors, color_storage, 1); // Missing alpha stays opaque
+			else for(size_t i = begin; i < end; ++i) color_storage[i] = {1, 1, 1, 1};
+		});
+
+		stylizer::dynamic_mesh mesh;
+		const ply::property* index_property = nullptr;
+		if(faces)
+			for(auto& property: faces->properties)
+				if(property.is_list() && (property.name == "vertex_indices" || property.name == "vertex_index"))
+					index_property = &property;
+
+		if(!faces || faces->count == 0 || !index_property)
+			mesh.type = mesh::Type::Point; // Point cloud
+		else {
+			std::vector<uint32_t> indices;
+			std::atomic<bool> valid = true, mixed = false;
+			auto index_size = ply::type_size(index_property->type), count_size = ply::type_size(index_property->count_type);
+			size_t triangle_record = count_size + 3 * index_size;
+
+			// NOTE: Scanners almost always emit nothing but triangles, in which case every face record is the same size and they can be decoded in parallel
+			bool uniform = faces->properties.size() == 1 && face_data.size() == faces->count * triangle_record;
+			if(uniform) {
+				indices.resize(faces->count * 3);
+				size_t batches = std::min(std::max<size_t>(faces->count / 65536, 1), std::max<size_t>(pool.size(), 1) * 4);
+				pool.parallel_for(batches, [&](size_t batch) {
+					size_t begin = faces->count * batch / batches, end = faces->count * (batch + 1) / batches;
+					for(size_t f = begin; f < end && valid && !mixed; ++f) {
+						auto record = face_data.data() + f * triangle_record;
+						if(ply::read<size_t>(index_property->count_type, record, endian) != 3) {
+							mixed = true; // Not all triangles after all, decode sequentially instead
+							break;
+						}
+						for(size_t c = 0; c < 3; ++c) {
+							auto index = ply::read<uint32_t>(index_property->type, record + count_size + c * index_size, endian);
+							if(index >= vertices) valid = false;
+							indices[f * 3 + c] = index;
+						}
+					}
+				});
+				if(mixed) indices.clear();
+				else if(!valid) return fail("PLY face references a vertex which doesn't exist!");
+			}
+
+			if(!uniform || mixed) {
+				valid = true;
+				indices.reserve(faces->count * 3);
+				size_t consumed;
+				ply::for_each_face(face_data, *faces, *index_property, endian, consumed, [&](const std::byte* at, size_t count) {
+					auto corner = [&](size_t i) {
+						auto index = ply::read<uint32_t>(index_property->type, at + i * index_size, endian);
+						if(index >= vertices) valid = false;
+						return index;
+					};
+					// Fan triangulation
+					for(size_t i = 1; i + 1 < count; ++i)
+						indices.insert(indices.end(), {corner(0), corner(i), corner(i + 1)});
+				});
+				if(!valid) return fail("PLY face references a vertex which doesn't exist!");
+			}
+			mesh.index_data = std::move(indices); // NOTE: Moved rather than going through set_index_data, these can be hundreds of megabytes
+		}
+
+		mesh.add_vertex_attribute(stylizer::common_mesh_attributes::positions, std::move(position_storage));
+		mesh.add_vertex_attribute(stylizer::common_mesh_attributes::colors, std::move(color_storage));
+		if(normals.any()) mesh.add_vertex_attribute(stylizer::common_mesh_attributes::normals, std::move(normal_storage));
+		if(uvs.any()) mesh.add_vertex_attribute(stylizer::common_mesh_attributes::uvs, std::move(uv_storage));
+		mesh.cached_vertex_count = vertices;
+
+		stylizer::flat_material material;
+		material.color = stdmath::float4(.5, .5, .5, 1);
+		model out;
+		out.emplace_back(mesh.move_to_owned(), material.move_to_owned());
+		return out;
+	}
+
+	maybe_owned<model> load_ply_model_generic(stylizer::context& ctx, std::span<std::byte> memory, std::string_view extension) {
+		return load_ply_model(memory, ctx.jobs()).move_to_owned();
+	}
+}}
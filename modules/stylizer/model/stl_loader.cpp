@@ -0,0 +1,128 @@
+#include "dynamic_mesh.hpp"
+
+#include <stylizer/core/util/endian.hpp>
+#include <stylizer/core/util/hash.hpp>
+
+#include <cmath>
+
+namespace stylizer { inline namespace models {
+
+	namespace stl {
+		constexpr size_t header_size = 84; // 80 byte comment followed by the triangle count
+		constexpr size_t triangle_size = 50; // Facet normal, three corners and a (usually unused) attribute word
+		constexpr uint32_t empty = std::numeric_limits<uint32_t>::max();
+
+		// Welds corners with bitwise identical positions as they are streamed in, so the triangle soup never has to be materialized
+		struct welder {
+			stylizer::storage<stdmath::float4> positions;
+			std::vector<stdmath::float4> normals;
+			std::vector<uint32_t> table; // Open addressing, holds indices into positions
+			size_t mask = 0;
+
+			welder(size_t expected_vertices) {
+				positions.reserve(expected_vertices);
+				normals.reserve(expected_vertices);
+				grow(std::bit_ceil(std::max<size_t>(expected_vertices * 2, 16)));
+			}
+
+			static uint64_t hash(const stdmath::float4& position) {
+				return content_hash({(const std::byte*)&position, sizeof(float) * 3});
+			}
+
+			void grow(size_t capacity) {
+				table.assign(capacity, empty);
+				mask = capacity - 1;
+				for(uint32_t i = 0; i < positions.size(); ++i) {
+					size_t slot = hash(positions[i]) & mask;
+					while(table[slot] != empty) slot = (slot + 1) & mask;
+					table[slot] = i;
+				}
+			}
+
+			uint32_t insert(const stdmath::float4& position) {
+				size_t slot = hash(position) & mask;
+				for(; table[slot] != empty; slot = (slot + 1) & mask)
+					if(std::memcmp(&positions[table[slot]], &position, sizeof(float) * 3) == 0)
+						return table[slot];
+
+				uint32_t index = positions.size();
+				positions.emplace_back(position);
+				normals.push_back({0, 0, 0, 0});
+				table[slot] = index;
+				if(positions.size() * 2 > table.size()) grow(table.size() * 2); // Keep the load factor at or below one half
+				return index;
+			}
+		};
+	}
+
+	model load_stl_model(std::span<std::byte> memory) {
+		auto fail = [](std::string_view message) {
+			get_error_handler()(stylizer::error_severity::Error, message, 0);
+			return model{};
+		};
+
+		if(memory.size() < stl::header_size) return fail("STL file is too small!");
+		size_t triangles = load_little_endian<uint32_t>(memory.data() + 80);
+		if(memory.size() != stl::header_size + triangles * stl::triangle_size)
+			return fail(std::string_view((const char*)memory.data(), 5) == "solid" ? "Only binary STL files are supported!" : "STL file is truncated!");
+		if(triangles == 0) return {};
+
+		// NOTE: Closed meshes have roughly half as many vertices as triangles
+		stl::welder welder(triangles / 2 + 3);
+		std::vector<uint32_t> indices(triangles * 3);
+		auto at = memory.data() + stl::header_size;
+		for(size_t t = 0; t < triangles; ++t, at += stl::triangle_size) {
+			stdmath::float4 corners[3];
+			for(size_t c = 0; c < 3; ++c) {
+				auto corner = at + 12 + c * 12; // Skip the facet normal (frequently zero), normals are recomputed below
+				// NOTE: Adding zero turns negative zeros positive so that they weld with their positive twins
+				corners[c] = {
+					load_little_endian<float>(corner) + 0.f,
+					load_little_endian<float>(corner + 4) + 0.f,
+					load_little_endian<float>(corner + 8) + 0.f,
+					0
+				};
+				indices[t * 3 + c] = welder.insert(corners[c]);
+			}
+
+			// Area weighted face normal, accumulated into every corner
+			float e1[3] = {corners[1][0] - corners[0][0], corners[1][1] - corners[0][1], corners[1][2] - corners[0][2]};
+			float e2[3] = {corners[2][0] - corners[0][0], corners[2][1] - corners[0][1], corners[2][2] - corners[0][2]};
+			float normal[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+			for(size_t c = 0; c < 3; ++c) {
+				auto& accumulated = welder.normals[indices[t * 3 + c]];
+				for(size_t axis = 0; axis < 3; ++axis)
+					accumulated[axis] += normal[axis];
+			}
+		}
+		welder.table = {};
+
+		stylizer::storage<stdmath::float4> normals, colors;
+		normals.resize(welder.positions.size());
+		colors.resize(welder.positions.size());
+		for(size_t i = 0; i < welder.positions.size(); ++i) {
+			auto& n = welder.normals[i];
+			float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			if(length > 0) normals[i] = {n[0] / length, n[1] / length, n[2] / length, 0};
+			colors[i] = {1, 1, 1, 1};
+		}
+		welder.normals = {};
+
+		stylizer::dynamic_mesh mesh;
+		mesh.add_vertex_attribute(stylizer::common_mesh_attributes::positions, std::move(welder.positions));
+		mesh.add_vertex_attribute(stylizer::common_mesh_attributes::colors, std::move(colors));
+		mesh.add_vertex_attribute(stylizer::common_mesh_attributes::normals, std::move(normals));
+		mesh.cached_vertex_count = mesh.attribute_data[0].size();
+		mesh.index_data = std::move(indices); // NOTE: Moved rather than going through set_index_data, these can be hundreds of megabytes
+
+		stylizer::flat_material material;
+		material.color = stdmath::float4(.5, .5, .5, 1);
+		model out;
+		out.emplace_back(mesh.move_to_owned(), material.move_to_owned());
+		return out;
+	}
+
+	maybe_owned<model> load_stl_model_generic(stylizer::context& ctx, std::span<std::byte> memory, std::string_view extension) {
+		return load_stl_model(memory).move_to_owned();
+	}
+}}
@@ -0,0 +1,155 @@
+#include <stylizer/core/tests/check.hpp>
+
+#include <stylizer/model/cooked_mesh.hpp>
+#include <stylizer/model/dynamic_mesh.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+using namespace stylizer;
+
+static bool same_bytes(std::span<const std::byte> a, std::span<const std::byte> b) {
+	return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+}
+
+template<typename T>
+static std::span<const std::byte> bytes_of(std::span<T> span) { return std::as_bytes(span); }
+
+// Loads from a private copy, the way packed (unmapped) assets are loaded
+static model load(std::span<const std::byte> data) {
+	auto copy = std::make_shared<std::vector<std::byte>>(data.begin(), data.end());
+	return cooked_mesh::load(file_cache::handle{copy, *copy});
+}
+
+static mapped_mesh& mapped(model& model, size_t i) { return (mapped_mesh&)*model[i].first; }
+
+int main() {
+	int errors = 0;
+	auto connection = get_error_handler().connect([&](auto, auto, auto) { ++errors; });
+
+	stdmath::float4 positions[] = {{0, 0, 0, 0}, {2, 1, 0, 0}, {-1, 3, 5, 0}, {1, 1, 1, 0}};
+	stdmath::float2 uvs[] = {{0, 0}, {1, 0}, {0, 1}, {1, 1}};
+	int32_t ids[] = {7, 8, 9, 10};
+	std::vector<uint32_t> extra = {3, 2, 0}; // Only referenced by a meshlet
+
+	model original;
+	{
+		dynamic_mesh textured;
+		textured.add_vertex_attribute_storage(common_mesh_attributes::positions, storage<stdmath::float4>(std::span<const stdmath::float4>(positions)));
+		textured.add_vertex_attribute_storage(common_mesh_attributes::uvs, storage<stdmath::float2>(std::span<const stdmath::float2>(uvs)));
+		textured.add_vertex_attribute_storage("ids", storage<int32_t>(std::span<const int32_t>(ids)));
+		textured.index_data = {0, 1, 2, 2, 1, 3};
+
+		dynamic_mesh split;
+		split.add_vertex_attribute_storage(common_mesh_attributes::positions, storage<stdmath::float4>(std::span<const stdmath::float4>(positions)));
+		split.index_data = {0, 1, 2, 2, 1, 3};
+		split.meshlets = {{std::span(split.index_data).first(3)}, {extra}};
+
+		dynamic_mesh shared; // Uses the textured mesh's material
+		shared.add_vertex_attribute_storage(common_mesh_attributes::positions, storage<stdmath::float4>(std::span<const stdmath::float4>(positions).first(3)));
+		shared.type = mesh::Type::Point;
+
+		flat_material red, green;
+		red.color = stdmath::float4(1, 0, 0, 1);
+		green.color = stdmath::float4(0, 1, 0, 1);
+		auto& first = original.emplace_back(textured.move_to_owned(), red.move_to_owned());
+		auto red_material = (flat_material*)&*first.second;
+		original.emplace_back(split.move_to_owned(), green.move_to_owned());
+		original.emplace_back(shared.move_to_owned(), red_material);
+		original.texture_dependencies.push_back({"/cooked/textures/red.png", red_material});
+	}
+	auto cooked = cooked_mesh::serialize(original, "/cooked");
+
+	{ // The records hold the bounds, the extra indices, and the texture relative to the output directory
+		cooked_mesh::header header;
+		std::memcpy(&header, cooked.data(), sizeof(header));
+		STYLIZER_CHECK(header.magic == cooked_mesh::magic && header.version == cooked_mesh::version && header.mesh_count == 3);
+		cooked_mesh::mesh_record records[3];
+		std::memcpy(records, cooked.data() + header.meshes_offset, sizeof(records));
+		std::string_view strings((const char*)cooked.data() + header.strings_offset, header.strings_size);
+
+		STYLIZER_CHECK(strings.substr(records[0].texture_offset, records[0].texture_size) == "textures/red.png");
+		STYLIZER_CHECK(records[1].texture_size == 0 && strings.substr(records[2].texture_offset, records[2].texture_size) == "textures/red.png");
+		STYLIZER_CHECK(records[0].bounds_min[0] == -1 && records[0].bounds_min[1] == 0 && records[0].bounds_min[2] == 0);
+		STYLIZER_CHECK(records[0].bounds_max[0] == 2 && records[0].bounds_max[1] == 3 && records[0].bounds_max[2] == 5);
+		STYLIZER_CHECK(records[0].meshlet_count == 0 && records[0].extra_index_count == 0); // The implicit meshlet isn't stored
+		STYLIZER_CHECK(records[1].meshlet_count == 2 && records[1].index_count == 6 && records[1].extra_index_count == 3);
+		for(auto& record: records)
+			STYLIZER_CHECK(record.index_offset % cooked_mesh::alignment == 0);
+	}
+
+	{ // Everything survives a round trip
+		current_load_path_scope scope("/loaded/model.smesh");
+		auto loaded = load(cooked);
+		STYLIZER_CHECK(loaded.size() == 3 && errors == 0);
+		if(loaded.size() != 3) return tests::result();
+
+		auto& textured = mapped(loaded, 0);
+		STYLIZER_CHECK(textured.vertex_count() == 4 && textured.verify());
+		STYLIZER_CHECK(textured.attributes.size() == 3);
+		STYLIZER_CHECK(textured.lookup_attribute(common_mesh_attributes::uvs) == 1u && textured.lookup_attribute("ids") == 2u);
+		STYLIZER_CHECK(same_bytes(textured.attribute_bytes(0), bytes_of(std::span(positions))));
+		STYLIZER_CHECK(same_bytes(textured.attribute_bytes(1), bytes_of(std::span(uvs))));
+		STYLIZER_CHECK(same_bytes(textured.attribute_bytes(2), bytes_of(std::span(ids))));
+		STYLIZER_CHECK(textured.attributes[2].format == 4); // storage<int32_t>
+		STYLIZER_CHECK((std::vector<uint32_t>(textured.index_view.begin(), textured.index_view.end()) == std::vector<uint32_t>{0, 1, 2, 2, 1, 3}));
+		STYLIZER_CHECK(!textured.has_explicit_meshlets());
+		STYLIZER_CHECK(textured.bounds_min[0] == -1 && textured.bounds_max[1] == 3 && textured.bounds_max[2] == 5);
+
+		auto& split = mapped(loaded, 1);
+		STYLIZER_CHECK(split.has_explicit_meshlets() && split.meshlets.size() == 2);
+		if(split.meshlets.size() == 2) {
+			STYLIZER_CHECK(split.meshlets[0].indicies.data() == split.index_view.data() && split.meshlets[0].indicies.size() == 3);
+			STYLIZER_CHECK(std::equal(split.meshlets[1].indicies.begin(), split.meshlets[1].indicies.end(), extra.begin(), extra.end()));
+		}
+
+		auto& shared = mapped(loaded, 2);
+		STYLIZER_CHECK(shared.type == mesh::Type::Point && shared.vertex_count() == 3 && !shared.indicies_view());
+
+		// Textures are resolved against the directory the cooked file was loaded from
+		STYLIZER_CHECK(&*loaded[0].second == &*loaded[2].second && &*loaded[0].second != &*loaded[1].second);
+		STYLIZER_CHECK(loaded.texture_dependencies.size() == 1);
+		if(loaded.texture_dependencies.size() == 1) {
+			STYLIZER_CHECK(loaded.texture_dependencies[0].file.generic_string() == "/loaded/textures/red.png");
+			STYLIZER_CHECK(loaded.texture_dependencies[0].material == (flat_material*)&*loaded[0].second);
+		}
+		auto green = std::get_if<stdmath::float4>(&((flat_material&)*loaded[1].second).color);
+		STYLIZER_CHECK(green && (*green)[1] == 1 && (*green)[0] == 0);
+
+		// Cooking what was loaded reproduces the file byte for byte
+		STYLIZER_CHECK(same_bytes(cooked_mesh::serialize(loaded, "/loaded"), cooked));
+	}
+
+	{ // Truncated or corrupt files are rejected rather than read out of bounds
+		auto rejected = [&](std::span<const std::byte> data) {
+			errors = 0;
+			return load(data).empty() && errors == 1;
+		};
+		auto corrupt = [&](size_t offset, auto value) {
+			auto copy = cooked;
+			std::memcpy(copy.data() + offset, &value, sizeof(value));
+			return copy;
+		};
+		cooked_mesh::header header;
+		std::memcpy(&header, cooked.data(), sizeof(header));
+		cooked_mesh::mesh_record record;
+		std::memcpy(&record, cooked.data() + header.meshes_offset, sizeof(record));
+		cooked_mesh::attribute_record positions;
+		std::memcpy(&positions, cooked.data() + record.attributes_offset, sizeof(positions));
+
+		STYLIZER_CHECK(rejected(std::span(cooked).first(sizeof(header) - 1)));
+		STYLIZER_CHECK(rejected(std::span(cooked).first(header.meshes_offset + sizeof(record))));
+		STYLIZER_CHECK(rejected(corrupt(offsetof(cooked_mesh::header, magic), uint32_t(0))));
+		STYLIZER_CHECK(rejected(corrupt(offsetof(cooked_mesh::header, version), cooked_mesh::version + 1)));
+		STYLIZER_CHECK(rejected(corrupt(offsetof(cooked_mesh::header, mesh_count), uint64_t(1) << 40)));
+		STYLIZER_CHECK(rejected(corrupt(offsetof(cooked_mesh::header, strings_size), uint64_t(cooked.size()))));
+		STYLIZER_CHECK(rejected(corrupt(record.attributes_offset + offsetof(cooked_mesh::attribute_record, offset), uint64_t(cooked.size()))));
+		STYLIZER_CHECK(rejected(corrupt(record.attributes_offset + offsetof(cooked_mesh::attribute_record, format), uint64_t(100))));
+		STYLIZER_CHECK(rejected(corrupt(record.attributes_offset + offsetof(cooked_mesh::attribute_record, offset), positions.offset + 2))); // Misaligned floats
+		STYLIZER_CHECK(rejected(corrupt(header.meshes_offset + offsetof(cooked_mesh::mesh_record, index_count), uint64_t(1) << 40)));
+		STYLIZER_CHECK(rejected(corrupt(header.meshes_offset + offsetof(cooked_mesh::mesh_record, texture_size), uint64_t(1) << 40)));
+	}
+
+	return tests::result();
+}
@@ -0,0 +1,121 @@
+#include <stylizer/core/tests/check.hpp>
+
+#include <stylizer/model/dynamic_mesh.hpp>
+
+#include <cstring>
+#include <vector>
+
+using namespace stylizer;
+
+// A quad made of two triangles, every corner stored as its own vertex
+static dynamic_mesh make_quad() {
+	stdmath::float4 corners[] = {{0, 0, 0, 0}, {1, 0, 0, 0}, {1, 1, 0, 0}, {0, 0, 0, 0}, {1, 1, 0, 0}, {0, 1, 0, 0}};
+	dynamic_mesh out;
+	out.add_vertex_attribute_storage(common_mesh_attributes::positions, storage<stdmath::float4>(std::span<const stdmath::float4>(corners)));
+	return out;
+}
+
+static dynamic_mesh make_mesh(std::span<const stdmath::float4> positions, std::vector<uint32_t> indices = {}) {
+	dynamic_mesh out;
+	out.add_vertex_attribute_storage(common_mesh_attributes::positions, storage<stdmath::float4>(positions));
+	out.index_data = std::move(indices);
+	return out;
+}
+
+static bool same(const stdmath::float4& a, const stdmath::float4& b) { return std::memcmp(&a, &b, sizeof(a)) == 0; }
+
+int main() {
+	int errors = 0;
+	auto connection = get_error_handler().connect([&](auto, auto, auto) { ++errors; });
+	thread_pool pool(4);
+	const stdmath::float4 a = {0, 0, 0, 0}, b = {1, 0, 0, 0}, c = {0, 1, 0, 0}, d = {1, 1, 0, 0};
+
+	{ // Identical corners are merged and the survivors indexed in the order they first appear
+		auto mesh = make_quad();
+		mesh.weld(pool);
+		auto& positions = mesh.attribute_storage<stdmath::float4>(0);
+		STYLIZER_CHECK(positions.size() == 4);
+		STYLIZER_CHECK((mesh.index_data == std::vector<uint32_t>{0, 1, 2, 0, 2, 3}));
+		STYLIZER_CHECK(same(positions[0], a) && same(positions[1], b) && same(positions[2], d) && same(positions[3], c));
+		STYLIZER_CHECK(mesh.cached_vertex_count == 4u && mesh.vertex_count() == 4 && mesh.verify());
+	}
+
+	{ // Existing index data is remapped onto the survivors
+		stdmath::float4 positions[] = {a, b, a, c, b, d};
+		auto mesh = make_mesh(positions, {0, 1, 3, 2, 4, 5});
+		mesh.weld(pool);
+		STYLIZER_CHECK((mesh.index_data == std::vector<uint32_t>{0, 1, 2, 0, 1, 3}));
+		STYLIZER_CHECK(mesh.attribute_storage<stdmath::float4>(0).size() == 4);
+		STYLIZER_CHECK(mesh.cached_vertex_count == 4u && mesh.verify());
+	}
+
+	{ // Vertices the index data never referenced are dropped (when they end up past its largest index)
+		stdmath::float4 positions[] = {a, b, c, a};
+		auto mesh = make_mesh(positions, {0, 1, 3});
+		mesh.weld(pool);
+		STYLIZER_CHECK((mesh.index_data == std::vector<uint32_t>{0, 1, 0}));
+		STYLIZER_CHECK(mesh.attribute_storage<stdmath::float4>(0).size() == 2);
+		STYLIZER_CHECK(mesh.cached_vertex_count == 2u && mesh.vertex_count() == 2 && mesh.verify());
+	}
+
+	{ // Vertices only merge when every attribute matches
+		auto mesh = make_quad();
+		stdmath::float2 uvs[] = {{0, 0}, {1, 0}, {1, 1}, {.5, .5}, {1, 1}, {0, 1}};
+		mesh.add_vertex_attribute_storage(common_mesh_attributes::uvs, storage<stdmath::float2>(std::span<const stdmath::float2>(uvs)));
+		mesh.weld(pool);
+		STYLIZER_CHECK(mesh.attribute_storage<stdmath::float4>(0).size() == 5 && mesh.attribute_storage<stdmath::float2>(1).size() == 5);
+		STYLIZER_CHECK((mesh.index_data == std::vector<uint32_t>{0, 1, 2, 3, 2, 4}));
+		STYLIZER_CHECK(mesh.verify());
+	}
+
+	{ // Index data referencing vertices which don't exist is reported and the mesh left alone
+		stdmath::float4 positions[] = {a, b, a};
+		auto mesh = make_mesh(positions, {0, 1, 7});
+		errors = 0;
+		mesh.weld(pool);
+		STYLIZER_CHECK(errors == 1);
+		STYLIZER_CHECK((mesh.index_data == std::vector<uint32_t>{0, 1, 7}) && !mesh.cached_vertex_count);
+		STYLIZER_CHECK(mesh.attribute_storage<stdmath::float4>(0).size() == 3);
+	}
+
+	{ // Explicit meshlets viewing the index data are remapped along with it, ones viewing other memory stop the weld
+		stdmath::float4 positions[] = {a, b, a, c, b, d};
+		auto mesh = make_mesh(positions, {0, 1, 3, 2, 4, 5});
+		mesh.meshlets = {mesh::meshlet{std::span(mesh.index_data).first(3)}, mesh::meshlet{std::span(mesh.index_data).subspan(3)}};
+		mesh.weld(pool);
+		STYLIZER_CHECK(mesh.has_explicit_meshlets() && mesh.meshlets.size() == 2);
+		if(mesh.meshlets.size() == 2) {
+			auto second = mesh.meshlets[1].indicies;
+			STYLIZER_CHECK(second.data() == mesh.index_data.data() + 3 && (std::vector<uint32_t>(second.begin(), second.end()) == std::vector<uint32_t>{0, 1, 3}));
+		}
+
+		std::vector<uint32_t> extra = {2, 1, 0};
+		auto unwelded = make_mesh(positions, {0, 1, 3, 2, 4, 5});
+		unwelded.meshlets = {mesh::meshlet{std::span(unwelded.index_data)}, mesh::meshlet{extra}};
+		errors = 0;
+		unwelded.weld(pool);
+		STYLIZER_CHECK(errors == 1 && unwelded.meshlets.size() == 2 && !unwelded.cached_vertex_count);
+		STYLIZER_CHECK((unwelded.index_data == std::vector<uint32_t>{0, 1, 3, 2, 4, 5}) && (extra == std::vector<uint32_t>{2, 1, 0}));
+	}
+
+	{ // Welded (and thus indexed) meshes draw every instance, through the implicit meshlet covering their index data
+		auto mesh = make_quad();
+		mesh.weld(pool);
+		STYLIZER_CHECK(mesh.meshlets_view() && !mesh.has_explicit_meshlets());
+		auto call = model::draw_call_for(mesh, 5);
+		STYLIZER_CHECK(call.indexed && call.count == 6 && call.instance_count == 5);
+
+		// Only meshlets the mesh was actually split into count as explicit
+		mesh.meshlets = {mesh::meshlet{std::span(mesh.index_data).first(3)}, mesh::meshlet{std::span(mesh.index_data).subspan(3)}};
+		STYLIZER_CHECK(mesh.has_explicit_meshlets());
+	}
+
+	{ // As do meshes without indices
+		auto mesh = make_quad();
+		STYLIZER_CHECK(!mesh.meshlets_view() && !mesh.has_explicit_meshlets());
+		auto call = model::draw_call_for(mesh, 3);
+		STYLIZER_CHECK(!call.indexed && call.count == 6 && call.instance_count == 3);
+	}
+
+	return tests::result();
+}
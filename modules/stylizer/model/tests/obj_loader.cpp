@@ -0,0 +1,122 @@
+#include <stylizer/core/tests/check.hpp>
+
+#include <stylizer/model/dynamic_mesh.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace stylizer;
+
+// Exercises shapes, materials switching between faces, reused groups, negative indices, quads, and a last line without a newline
+constexpr std::string_view text =
+	"# A comment\n"
+	"mtllib test.mtl\n"
+	"v 0 0 0\n"
+	"v 1 0 0\n"
+	"v 1 1 0\n"
+	"v 0 1 0\n"
+	"vt 0 0\n"
+	"vt 1 0\n"
+	"vt 1 1\n"
+	"vn 0 0 1\n"
+	"o first\n"
+	"usemtl red\n"
+	"f 1/1/1 2/2/1 3/3/1\n"
+	"f -4/-3/-1 -2/-1/-1 -1/-1/-1\n"
+	"usemtl blue\n"
+	"f 1 2 4\n"
+	"usemtl red\n"
+	"f 1/1/1 3/3/1 4/2/1 2/1/1 # A quad\n"
+	"o second\n"
+	"v 2 0 0\n"
+	"v 2 1 0\n"
+	"usemtl blue\n"
+	"f -1 -2 2\n"
+	"g third\n"
+	"f 1 5 6\n"
+	"usemtl missing\n"
+	"f 2 3 4";
+
+static bool same(dynamic_mesh& a, dynamic_mesh& b) {
+	if(a.index_data != b.index_data || a.attribute_data.size() != b.attribute_data.size()) return false;
+	for(size_t i = 0; i < a.attribute_data.size(); ++i) {
+		auto x = a.attribute_data[i].byte_span(), y = b.attribute_data[i].byte_span();
+		if(x.size() != y.size() || !std::equal(x.begin(), x.end(), y.begin())) return false;
+	}
+	return true;
+}
+
+static bool position_is(dynamic_mesh& mesh, size_t corner, stdmath::float4 expected) {
+	return std::memcmp(&mesh.attribute_storage<stdmath::float4>(0)[mesh.index_data[corner]], &expected, sizeof(expected)) == 0;
+}
+
+int main() {
+	int errors = 0;
+	auto connection = get_error_handler().connect([&](auto, auto, auto) { ++errors; });
+	thread_pool pool(4);
+	const std::map<std::string, int> materials = {{"red", 0}, {"blue", 1}};
+
+	// NOTE: A minimum chunk size of one byte lets a tiny file be split into (almost) a chunk per line
+	auto single = parse_obj_geometry(pool, text, materials, 1);
+	STYLIZER_CHECK(single.has_value());
+	if(!single) return tests::result();
+
+	{ // Groups are ordered by first appearance, a material reused within a shape continues its group
+		STYLIZER_CHECK((single->shapes == std::vector<size_t>{0, 0, 1, 2, 2}));
+		STYLIZER_CHECK((single->materials == std::vector<int>{0, 1, 1, 1, -1}));
+		STYLIZER_CHECK(single->meshes.size() == 5);
+	}
+
+	{ // Faces are triangulated, corners sharing their indices share a vertex, and negative indices resolve against the vertices defined so far
+		auto& red = single->meshes[0];
+		STYLIZER_CHECK((red.index_data == std::vector<uint32_t>{0, 1, 2, 0, 2, 3, 0, 2, 4, 0, 4, 5}));
+		STYLIZER_CHECK(red.vertex_count() == 6);
+		STYLIZER_CHECK(red.attribute_data.size() == 3); // Positions, normals, and uvs (no vertex has a color)
+		STYLIZER_CHECK(position_is(red, 4, {1, 1, 0, 0}) && position_is(red, 5, {0, 1, 0, 0}));
+
+		auto& second = single->meshes[2];
+		STYLIZER_CHECK(second.attribute_data.size() == 1); // No normals or uvs
+		STYLIZER_CHECK(position_is(second, 0, {2, 1, 0, 0}) && position_is(second, 1, {2, 0, 0, 0}) && position_is(second, 2, {1, 0, 0, 0}));
+
+		STYLIZER_CHECK(position_is(single->meshes[3], 1, {2, 0, 0, 0}));
+		STYLIZER_CHECK(position_is(single->meshes[4], 2, {0, 1, 0, 0}));
+		for(auto& mesh: single->meshes)
+			STYLIZER_CHECK(mesh.verify());
+	}
+
+	{ // However the file is chunked the output is identical
+		for(size_t chunks = 2; chunks <= text.size(); chunks *= 2) {
+			auto split = parse_obj_geometry(pool, text, materials, chunks, 1);
+			STYLIZER_CHECK(split.has_value());
+			if(!split) continue;
+			STYLIZER_CHECK(split->shapes == single->shapes && split->materials == single->materials);
+			STYLIZER_CHECK(split->meshes.size() == single->meshes.size());
+			for(size_t i = 0; i < std::min(split->meshes.size(), single->meshes.size()); ++i)
+				STYLIZER_CHECK(same(split->meshes[i], single->meshes[i]));
+		}
+	}
+
+	{ // Colors are only stored when a vertex has them, the others are white
+		auto colored = parse_obj_geometry(pool, "v 0 0 0\nv 1 0 0 1 0 0\nv 0 1 0\nf 1 2 3\n", materials, 1);
+		STYLIZER_CHECK(colored && colored->meshes.size() == 1);
+		if(colored && colored->meshes.size() == 1) {
+			auto& mesh = colored->meshes[0];
+			auto colors = mesh.lookup_attribute(common_mesh_attributes::colors);
+			STYLIZER_CHECK(colors && mesh.attribute_data.size() == 2);
+			if(colors) {
+				auto values = mesh.attribute_storage<stdmath::float4>(*colors).data();
+				auto white = values[mesh.index_data[0]], red = values[mesh.index_data[1]];
+				STYLIZER_CHECK(white[0] == 1 && white[1] == 1 && white[2] == 1 && red[0] == 1 && red[1] == 0 && red[2] == 0);
+			}
+		}
+	}
+
+	{ // Faces referencing vertices which don't exist (yet) are reported
+		errors = 0;
+		STYLIZER_CHECK(!parse_obj_geometry(pool, "v 0 0 0\nv 1 0 0\nf 1 2 3\nv 0 1 0\n", materials, 4, 1));
+		STYLIZER_CHECK(!parse_obj_geometry(pool, "v 0 0 0\nv 1 0 0\nf 1 2 -3\n", materials, 1));
+		STYLIZER_CHECK(errors == 2);
+	}
+
+	return tests::result();
+}
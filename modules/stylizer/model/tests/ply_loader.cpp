@@ -0,0 +1,143 @@
+#include <stylizer/core/tests/check.hpp>
+
+#include <stylizer/core/util/endian.hpp>
+#include <stylizer/model/dynamic_mesh.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace stylizer;
+
+// Builds a binary PLY in memory, values are written with the endianness its header declares
+struct ply_file {
+	std::endian endian;
+	std::vector<std::byte> bytes;
+
+	ply_file(std::endian endian, std::string_view elements) : endian(endian) {
+		std::string header = std::string("ply\nformat ") + (endian == std::endian::little ? "binary_little_endian" : "binary_big_endian") + " 1.0\ncomment test fixture\n" + std::string(elements) + "end_header\n";
+		auto begin = (const std::byte*)header.data();
+		bytes.assign(begin, begin + header.size());
+	}
+
+	template<typename T>
+	ply_file& operator<<(T value) {
+		if(endian != std::endian::native) value = byteswap(value);
+		auto begin = (const std::byte*)&value;
+		bytes.insert(bytes.end(), begin, begin + sizeof(T));
+		return *this;
+	}
+};
+
+constexpr std::string_view colored_vertices =
+	"element vertex 4\n"
+	"property float x\n"
+	"property float y\n"
+	"property float z\n"
+	"property uchar red\n"
+	"property uchar green\n"
+	"property uchar blue\n";
+
+// A unit square whose corners are red, green, blue, and white
+static ply_file& write_colored_vertices(ply_file& file) {
+	file << 0.f << 0.f << 0.f << uint8_t(255) << uint8_t(0) << uint8_t(0);
+	file << 1.f << 0.f << 0.f << uint8_t(0) << uint8_t(255) << uint8_t(0);
+	file << 1.f << 1.f << 0.f << uint8_t(0) << uint8_t(0) << uint8_t(255);
+	file << 0.f << 1.f << 0.f << uint8_t(255) << uint8_t(255) << uint8_t(255);
+	return file;
+}
+
+static dynamic_mesh& only_mesh(model& model) { return (dynamic_mesh&)*model[0].first; }
+
+static bool same_bytes(std::span<std::byte> a, std::span<std::byte> b) {
+	return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+}
+
+static bool near(const stdmath::float4& a, const stdmath::float4& b) {
+	for(size_t i = 0; i < 4; ++i)
+		if(std::abs(a[i] - b[i]) > 1e-6f) return false;
+	return true;
+}
+
+int main() {
+	int errors = 0;
+	auto connection = get_error_handler().connect([&](auto, auto, auto) { ++errors; });
+	thread_pool pool(4);
+
+	{ // All triangles (the uniform path) decode identically from either endianness
+		model loaded[2];
+		for(auto endian: {std::endian::little, std::endian::big}) {
+			ply_file file(endian, std::string(colored_vertices) + "element face 2\nproperty list uchar int vertex_indices\n");
+			write_colored_vertices(file) << uint8_t(3) << int32_t(0) << int32_t(1) << int32_t(2) << uint8_t(3) << int32_t(0) << int32_t(2) << int32_t(3);
+			auto& out = loaded[endian == std::endian::big] = load_ply_model(file.bytes, pool);
+			STYLIZER_CHECK(out.size() == 1);
+			if(out.size() != 1) continue;
+
+			auto& mesh = only_mesh(out);
+			STYLIZER_CHECK(mesh.type == dynamic_mesh::Type::Triangle);
+			STYLIZER_CHECK((mesh.index_data == std::vector<uint32_t>{0, 1, 2, 0, 2, 3}));
+			STYLIZER_CHECK(mesh.attribute_data.size() == 2); // Positions and colors
+			auto& positions = mesh.attribute_storage<stdmath::float4>(0);
+			auto& colors = mesh.attribute_storage<stdmath::float4>(1);
+			STYLIZER_CHECK(near(positions[2], {1, 1, 0, 0}) && near(positions[3], {0, 1, 0, 0}));
+			STYLIZER_CHECK(near(colors[0], {1, 0, 0, 1}) && near(colors[2], {0, 0, 1, 1}) && near(colors[3], {1, 1, 1, 1}));
+			STYLIZER_CHECK(mesh.vertex_count() == 4 && mesh.verify());
+		}
+		if(loaded[0].size() == 1 && loaded[1].size() == 1)
+			for(size_t i = 0; i < 2; ++i)
+				STYLIZER_CHECK(same_bytes(only_mesh(loaded[0]).attribute_data[i].byte_span(), only_mesh(loaded[1]).attribute_data[i].byte_span()));
+	}
+
+	{ // Faces with other properties are decoded sequentially, with any polygons fan triangulated
+		for(auto endian: {std::endian::little, std::endian::big}) {
+			ply_file file(endian, std::string(colored_vertices) + "element face 2\nproperty list uchar uint vertex_indices\nproperty uchar flags\n");
+			write_colored_vertices(file) << uint8_t(4) << uint32_t(0) << uint32_t(1) << uint32_t(2) << uint32_t(3) << uint8_t(7);
+			file << uint8_t(3) << uint32_t(0) << uint32_t(2) << uint32_t(1) << uint8_t(0);
+			auto out = load_ply_model(file.bytes, pool);
+			STYLIZER_CHECK(out.size() == 1);
+			if(out.size() == 1) {
+				STYLIZER_CHECK((only_mesh(out).index_data == std::vector<uint32_t>{0, 1, 2, 0, 2, 3, 0, 2, 1}));
+				STYLIZER_CHECK(only_mesh(out).verify());
+			}
+		}
+	}
+
+	{ // Polygons which happen to total the size of that many triangles fall back to the sequential path
+		// NOTE: A quad (17 bytes) and a degenerate two sided face (9 bytes) are as large as two triangles (13 bytes each)
+		ply_file file(std::endian::little, std::string(colored_vertices) + "element face 2\nproperty list uchar int vertex_indices\n");
+		write_colored_vertices(file) << uint8_t(4) << int32_t(0) << int32_t(1) << int32_t(2) << int32_t(3) << uint8_t(2) << int32_t(0) << int32_t(1);
+		auto out = load_ply_model(file.bytes, pool);
+		STYLIZER_CHECK(out.size() == 1);
+		if(out.size() == 1)
+			STYLIZER_CHECK((only_mesh(out).index_data == std::vector<uint32_t>{0, 1, 2, 0, 2, 3}));
+	}
+
+	{ // Files without faces are point clouds, and doubles are narrowed
+		ply_file file(std::endian::big, "element vertex 3\nproperty double x\nproperty double y\nproperty double z\n");
+		file << 1.0 << 2.0 << 3.0 << -1.0 << -2.0 << -3.0 << .5 << .25 << .125;
+		auto out = load_ply_model(file.bytes, pool);
+		STYLIZER_CHECK(out.size() == 1);
+		if(out.size() == 1) {
+			auto& mesh = only_mesh(out);
+			STYLIZER_CHECK(mesh.type == dynamic_mesh::Type::Point);
+			STYLIZER_CHECK(mesh.index_data.empty() && mesh.vertex_count() == 3 && mesh.verify());
+			auto& positions = mesh.attribute_storage<stdmath::float4>(0);
+			STYLIZER_CHECK(near(positions[1], {-1, -2, -3, 0}) && near(positions[2], {.5, .25, .125, 0}));
+			STYLIZER_CHECK(near(mesh.attribute_storage<stdmath::float4>(1)[0], {1, 1, 1, 1})); // Colorless vertices are white
+		}
+	}
+
+	{ // Out of range indices and truncated data are reported
+		ply_file file(std::endian::little, std::string(colored_vertices) + "element face 1\nproperty list uchar int vertex_indices\n");
+		write_colored_vertices(file) << uint8_t(3) << int32_t(0) << int32_t(1) << int32_t(4);
+		errors = 0;
+		STYLIZER_CHECK(load_ply_model(file.bytes, pool).empty());
+		file.bytes.pop_back();
+		STYLIZER_CHECK(load_ply_model(file.bytes, pool).empty());
+		std::string text = "ply\nformat ascii 1.0\nend_header\n";
+		STYLIZER_CHECK(load_ply_model({(std::byte*)text.data(), text.size()}, pool).empty());
+		STYLIZER_CHECK(errors == 3);
+	}
+
+	return tests::result();
+}
@@ -0,0 +1,103 @@
+#include <stylizer/core/tests/check.hpp>
+
+#include <stylizer/core/util/endian.hpp>
+#include <stylizer/model/dynamic_mesh.hpp>
+
+#include <array>
+#include <cmath>
+#include <cstring>
+
+using namespace stylizer;
+
+// Builds a binary STL in memory, every value is little endian
+struct stl_file {
+	std::vector<std::byte> bytes = std::vector<std::byte>(84);
+
+	template<typename T>
+	void write(T value) {
+		if constexpr(std::endian::native != std::endian::little) value = byteswap(value);
+		auto begin = (const std::byte*)&value;
+		bytes.insert(bytes.end(), begin, begin + sizeof(T));
+	}
+
+	// NOTE: The facet normal is left zero, the loader recomputes normals anyway
+	stl_file& triangle(std::array<stdmath::float4, 3> corners) {
+		for(size_t i = 0; i < 3; ++i) write(0.f);
+		for(auto& corner: corners)
+			for(size_t i = 0; i < 3; ++i) write(corner[i]);
+		write(uint16_t(0));
+
+		uint32_t count = (bytes.size() - 84) / 50;
+		if constexpr(std::endian::native != std::endian::little) count = byteswap(count);
+		std::memcpy(bytes.data() + 80, &count, sizeof(count));
+		return *this;
+	}
+};
+
+static dynamic_mesh& only_mesh(model& model) { return (dynamic_mesh&)*model[0].first; }
+
+static bool bitwise_equal(const stdmath::float4& a, const stdmath::float4& b) { return std::memcmp(&a, &b, sizeof(a)) == 0; }
+
+int main() {
+	int errors = 0;
+	auto connection = get_error_handler().connect([&](auto, auto, auto) { ++errors; });
+
+	{ // Shared corners are welded, negative zeros included
+		stl_file file;
+		file.triangle({{{0, 0, 0, 0}, {1, 0, 0, 0}, {0, 1, 0, 0}}});
+		file.triangle({{{1, -0.f, 0, 0}, {1, 1, 0, 0}, {-0.f, 1, -0.f, 0}}});
+		auto out = load_stl_model(file.bytes);
+		STYLIZER_CHECK(out.size() == 1);
+		if(out.size() == 1) {
+			auto& mesh = only_mesh(out);
+			STYLIZER_CHECK((mesh.index_data == std::vector<uint32_t>{0, 1, 2, 1, 3, 2}));
+			STYLIZER_CHECK(mesh.vertex_count() == 4 && mesh.verify());
+
+			auto& positions = mesh.attribute_storage<stdmath::float4>(0);
+			STYLIZER_CHECK(positions.size() == 4);
+			STYLIZER_CHECK(bitwise_equal(positions[1], {1, 0, 0, 0}) && bitwise_equal(positions[2], {0, 1, 0, 0})); // Stored as positive zeros
+
+			auto& normals = mesh.attribute_storage<stdmath::float4>(*mesh.lookup_attribute(common_mesh_attributes::normals));
+			for(size_t i = 0; i < 4; ++i)
+				STYLIZER_CHECK(std::abs(normals[i][0]) < 1e-6f && std::abs(normals[i][1]) < 1e-6f && std::abs(normals[i][2] - 1) < 1e-6f);
+		}
+	}
+
+	{ // The weld table grows past its initial guess without losing or merging any vertices
+		stl_file file;
+		for(size_t copy = 0; copy < 2; ++copy)
+			for(size_t t = 0; t < 100; ++t) {
+				float x = t;
+				file.triangle({{{x, 0, 0, 0}, {x, 1, 0, 0}, {x, 0, 1, 0}}});
+			}
+		auto out = load_stl_model(file.bytes);
+		STYLIZER_CHECK(out.size() == 1);
+		if(out.size() == 1) {
+			auto& mesh = only_mesh(out);
+			STYLIZER_CHECK(mesh.attribute_storage<stdmath::float4>(0).size() == 300);
+			bool sequential = true, repeated = true;
+			for(size_t i = 0; i < 300; ++i) {
+				sequential &= mesh.index_data[i] == i;
+				repeated &= mesh.index_data[300 + i] == i;
+			}
+			STYLIZER_CHECK(sequential && repeated);
+			STYLIZER_CHECK(mesh.verify());
+		}
+	}
+
+	{ // Empty files load nothing, while ASCII, truncated, and undersized files are reported
+		stl_file file;
+		errors = 0;
+		STYLIZER_CHECK(load_stl_model(file.bytes).empty() && errors == 0);
+
+		file.triangle({{{0, 0, 0, 0}, {1, 0, 0, 0}, {0, 1, 0, 0}}});
+		file.bytes.pop_back();
+		STYLIZER_CHECK(load_stl_model(file.bytes).empty());
+		std::memcpy(file.bytes.data(), "solid", 5);
+		STYLIZER_CHECK(load_stl_model(file.bytes).empty());
+		STYLIZER_CHECK(load_stl_model(std::span(file.bytes).first(40)).empty());
+		STYLIZER_CHECK(errors == 3);
+	}
+
+	return tests::result();
+}
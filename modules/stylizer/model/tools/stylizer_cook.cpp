@@ -0,0 +1,307 @@
+#include <stylizer/core/api.hpp>
+#include <stylizer/core/util/hash.hpp>
+#include <stylizer/core/util/thread_pool.hpp>
+#include <stylizer/image/compressed_image.hpp>
+#include <stylizer/image/cooked_image.hpp>
+#include <stylizer/image/mipmap.hpp>
+#include <stylizer/model/cooked_mesh.hpp>
+#include <stylizer/model/dynamic_mesh.hpp>
+
+#include <atomic>
+#include <charconv>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+	// Bump whenever the cooked output changes so that previous cooks are redone
+	constexpr uint64_t cook_version = 2;
+
+	struct options {
+		bool mipmaps = true;
+		bool force = false;
+		std::optional<stylizer::block_format::family> compression; // Images are block compressed into .ktx2 files instead of cooked into .simg
+		std::filesystem::path input_directory, output_directory;
+	};
+
+	// The formats the CPU encoder supports
+	constexpr std::pair<std::string_view, stylizer::block_format::family> compression_formats[] = {
+		{"bc1", stylizer::block_format::family::BC1},
+		{"bc3", stylizer::block_format::family::BC3},
+		{"bc4", stylizer::block_format::family::BC4},
+		{"bc5", stylizer::block_format::family::BC5},
+		{"bc7", stylizer::block_format::family::BC7},
+	};
+	// NOTE: Formats the graphics API can't sample are still written, but are decoded back to RGBA8 on the CPU at runtime
+	bool can_sample(stylizer::block_format::family family) {
+		return stylizer::texture_format_of(stylizer::block_format{family}) != stylizer::texture::format::Undefined;
+	}
+
+	std::optional<stylizer::block_format::family> parse_compression(std::string_view name) {
+		for(auto& [format_name, family]: compression_formats)
+			if(name == format_name) return family;
+		return {};
+	}
+
+	// Eg " [--compress=bc1|bc7]"
+	std::string compression_usage() {
+		std::string formats;
+		for(auto& [name, family]: compression_formats)
+			formats += (formats.empty() ? "" : "|") + std::string(name);
+		return " [--compress=" + formats + "]";
+	}
+
+	std::string_view cooked_image_extension(const options& options) {
+		return options.compression ? ".ktx2" : ".simg";
+	}
+
+	// Maps every output (relative to the output directory) to the hash of the inputs and options it was cooked from
+	struct manifest {
+		constexpr static std::string_view file_name = ".stylizer_cook";
+
+		std::unordered_map<std::string, uint64_t> entries;
+		std::mutex mutex;
+
+		void load(const std::filesystem::path& directory) {
+			std::ifstream in(directory / file_name);
+			for(std::string line; std::getline(in, line); ) {
+				auto space = line.find(' ');
+				if(space == line.npos) continue;
+				uint64_t hash;
+				if(std::from_chars(line.data(), line.data() + space, hash, 16).ec != std::errc{}) continue;
+				entries[line.substr(space + 1)] = hash;
+			}
+		}
+
+		bool save(const std::filesystem::path& directory) {
+			std::ofstream out(directory / file_name, std::ios::trunc);
+			for(auto& [file, hash]: entries) {
+				char buffer[17];
+				auto end = std::to_chars(buffer, buffer + sizeof(buffer), hash, 16).ptr;
+				out << std::string_view(buffer, end) << ' ' << file << '\n';
+			}
+			return bool(out);
+		}
+
+		bool up_to_date(const std::filesystem::path& output, const std::string& file, uint64_t hash) {
+			std::scoped_lock lock(mutex);
+			auto found = entries.find(file);
+			return found != entries.end() && found->second == hash && std::filesystem::exists(output);
+		}
+		void record(const std::string& file, uint64_t hash) {
+			std::scoped_lock lock(mutex);
+			entries[file] = hash;
+		}
+	};
+
+	// NOTE: Block compressed containers are already ready for the GPU, so they are copied as is
+	bool is_image(const std::filesystem::path& file) {
+		auto extension = file.extension().string();
+		return extension != ".simg" && extension != ".ktx2" && extension != ".dds" && stylizer::image::get_loader_set().contains(extension);
+	}
+
+	// Finds the first material library an OBJ references
+	std::optional<std::filesystem::path> find_material_library(std::span<const std::byte> obj) {
+		std::string_view text((const char*)obj.data(), obj.size());
+		for(size_t at = 0; at < text.size(); ) {
+			auto end = text.find('\n', at);
+			auto line = text.substr(at, end == text.npos ? text.npos : end - at);
+			at = end == text.npos ? text.size() : end + 1;
+
+			if(!line.starts_with("mtllib")) continue;
+			line.remove_prefix(6);
+			while(!line.empty() && std::isspace((unsigned char)line.front())) line.remove_prefix(1);
+			while(!line.empty() && std::isspace((unsigned char)line.back())) line.remove_suffix(1);
+			if(!line.empty()) return std::filesystem::path(line);
+		}
+		return {};
+	}
+
+	// Loads the OBJ (along with its material library) and writes it as a welded, vertex order optimized .smesh
+	bool cook_model(stylizer::context& ctx, const std::filesystem::path& input, const std::filesystem::path& output, const std::string& name, const options& options, manifest& manifest) {
+		auto obj = stylizer::load_file_handle(input);
+		auto hash = stylizer::hash_combine(stylizer::content_hash(obj.span()), cook_version);
+
+		stylizer::file_cache::handle mtl;
+		if(auto library = find_material_library(obj.span()); library && std::filesystem::exists(input.parent_path() / *library)) {
+			mtl = stylizer::load_file_handle(input.parent_path() / *library);
+			hash = stylizer::hash_combine(hash, stylizer::content_hash(mtl.span()));
+		}
+		if(!options.force && manifest.up_to_date(output, name, hash)) return false;
+
+		// NOTE: Loaded through the registry (like at runtime), unless there is a material library which only the OBJ loader itself can be handed
+		stylizer::current_load_path_scope scope(input); // Textures are found relative to the model, not the working directory
+		auto model = mtl
+			? stylizer::load_tinyobj_model_with_material(ctx, obj.span(), mtl.span()).move_to_owned()
+			: stylizer::model::get_loader_set()(ctx, obj.span(), input.extension().string());
+
+		for(auto& [mesh, material]: *model)
+			if(auto dynamic = dynamic_cast<stylizer::dynamic_mesh*>(&*mesh))
+				dynamic->optimize_vertex_order();
+		// Textures are cooked too, so point the materials at their cooked versions in the output directory
+		auto input_directory = std::filesystem::absolute(options.input_directory).lexically_normal();
+		for(auto& dependency: model->texture_dependencies) {
+			auto relative = std::filesystem::absolute(dependency.file).lexically_normal().lexically_relative(input_directory);
+			if(relative.empty() || *relative.begin() == "..") continue; // Outside of the asset directory, so nothing gets cooked for it
+			dependency.file = options.output_directory / relative;
+			if(is_image(relative))
+				dependency.file.replace_extension(cooked_image_extension(options));
+		}
+
+		std::filesystem::create_directories(output.parent_path());
+		bool written = stylizer::cooked_mesh::write(output, *model);
+
+		for(auto& [mesh, material]: *model) {
+			mesh.release();
+			material.release();
+		}
+		model.release();
+
+		if(written) manifest.record(name, hash);
+		return written;
+	}
+
+	// Decodes the image and writes it (along with its mip chain) as a .simg, or block compressed as a .ktx2
+	bool cook_image(stylizer::context& ctx, const std::filesystem::path& input, const std::filesystem::path& output, const std::string& name, const options& options, manifest& manifest) {
+		auto file = stylizer::load_file_handle(input);
+		auto hash = stylizer::hash_combine(stylizer::hash_combine(stylizer::content_hash(file.span()), cook_version), options.mipmaps);
+		if(options.compression) hash = stylizer::hash_combine(hash, uint64_t(*options.compression) + 1);
+		if(!options.force && manifest.up_to_date(output, name, hash)) return false;
+
+		auto image = stylizer::image::get_loader_set()(ctx, file.span(), input.extension().string());
+		if(options.compression) {
+			auto compressed = stylizer::compressed_image::compress(*image, *options.compression, options.mipmaps);
+			image.release();
+			if(!compressed) return false;
+
+			std::filesystem::create_directories(output.parent_path());
+			bool written = compressed->write_ktx2(output);
+			if(written) manifest.record(name, hash);
+			return written;
+		}
+
+		std::vector<stylizer::maybe_owned<stylizer::image>> mipmaps;
+		if(options.mipmaps) mipmaps = stylizer::generate_mipmaps(*image);
+
+		std::vector<stylizer::image*> levels = {&*image};
+		for(auto& level: mipmaps)
+			levels.push_back(&*level);
+
+		std::filesystem::create_directories(output.parent_path());
+		bool written = stylizer::cooked_image::write(output, levels);
+
+		for(auto& level: mipmaps)
+			level.release();
+		image.release();
+
+		if(written) manifest.record(name, hash);
+		return written;
+	}
+
+	// Anything which isn't cooked is copied as is (material libraries are baked into the meshes and thus skipped)
+	bool copy_file(const std::filesystem::path& input, const std::filesystem::path& output, const std::string& name, const options& options, manifest& manifest) {
+		auto file = stylizer::load_file_handle(input);
+		auto hash = stylizer::hash_combine(stylizer::content_hash(file.span()), cook_version);
+		if(!options.force && manifest.up_to_date(output, name, hash)) return false;
+
+		std::filesystem::create_directories(output.parent_path());
+		std::ofstream out(output, std::ios::binary | std::ios::trunc);
+		out.write((const char*)file.span().data(), file.span().size());
+		if(out) manifest.record(name, hash);
+		return bool(out);
+	}
+}
+
+int main(int argc, char** argv) {
+	auto usage = [&] {
+		std::cerr << "Usage: " << argv[0] << " <asset directory> <output directory> [--no-mipmaps] [--force]" << compression_usage() << std::endl;
+		return 1;
+	};
+	if(argc < 3) return usage();
+
+	options options;
+	for(int i = 3; i < argc; ++i) {
+		std::string_view flag = argv[i];
+		if(flag == "--no-mipmaps") options.mipmaps = false;
+		else if(flag == "--force") options.force = true;
+		else if(flag.starts_with("--compress=")) {
+			options.compression = parse_compression(flag.substr(11));
+			if(!options.compression) {
+				std::cerr << "Invalid compression format: " << flag.substr(11) << std::endl;
+				return usage();
+			}
+			if(!can_sample(*options.compression))
+				std::cerr << "Warning: The graphics API can't sample " << flag.substr(11) << ", the runtime will decode it back to RGBA8 on the CPU" << std::endl;
+		} else {
+			std::cerr << "Invalid argument: " << flag << std::endl;
+			return usage();
+		}
+	}
+
+	std::filesystem::path input = argv[1], output = argv[2];
+	options.input_directory = input;
+	options.output_directory = output;
+	// NOTE: Materials upload their textures while loading, so the cooker needs a (headless) device
+	auto ctx = stylizer::context::create_default_with_error_handler();
+
+	struct job {
+		std::filesystem::path input, output;
+		std::string name;
+		enum { Model, Image, Copy } type;
+	};
+	std::vector<job> models, others;
+	try {
+		for(auto& entry: std::filesystem::recursive_directory_iterator(input)) {
+			if(!entry.is_regular_file()) continue;
+			auto relative = entry.path().lexically_relative(input);
+			auto extension = relative.extension().string();
+			if(extension == ".mtl") continue;
+
+			job job{entry.path(), output / relative, {}, job::Copy};
+			if(stylizer::model::get_loader_set().contains(extension) && extension != ".smesh") {
+				job.type = job::Model;
+				job.output.replace_extension(".smesh");
+			} else if(is_image(relative)) {
+				job.type = job::Image;
+				job.output.replace_extension(cooked_image_extension(options));
+			}
+			job.name = job.output.lexically_relative(output).generic_string();
+			(job.type == job::Model ? models : others).push_back(std::move(job));
+		}
+	} catch(const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	manifest manifest;
+	manifest.load(output);
+	std::atomic<size_t> cooked = 0, failed = 0;
+	std::mutex log;
+	auto run = [&](const job& job) {
+		try {
+			bool done = job.type == job::Model ? cook_model(ctx, job.input, job.output, job.name, options, manifest)
+				: job.type == job::Image ? cook_image(ctx, job.input, job.output, job.name, options, manifest)
+				: copy_file(job.input, job.output, job.name, options, manifest);
+			if(done) {
+				++cooked;
+				std::scoped_lock lock(log);
+				std::cout << job.name << std::endl;
+			}
+		} catch(const std::exception& e) {
+			++failed;
+			std::scoped_lock lock(log);
+			std::cerr << job.input.string() << ": " << e.what() << std::endl;
+		}
+	};
+
+	// Images (and copies) only touch the CPU so they are processed in parallel, models upload their textures and
+	// are thus processed one at a time (their parsing is already spread across the pool)
+	stylizer::thread_pool::get_default().parallel_for(others.size(), [&](size_t i) { run(others[i]); });
+	for(auto& job: models) run(job);
+
+	std::filesystem::create_directories(output);
+	manifest.save(output);
+	std::cout << cooked << " cooked, " << (models.size() + others.size() - cooked - failed) << " up to date, " << failed << " failed" << std::endl;
+	return failed ? 1 : 0;
+}
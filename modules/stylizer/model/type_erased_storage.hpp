@@ -37,6 +37,9 @@ namespace stylizer {
 		storage(storage&) = default;
 		storage& operator=(const storage&) = default;
 		storage& operator=(storage&) = default;
+		// NOTE: Spelled out since the copies above would otherwise suppress them, noexcept so that vectors (and variants) of storage move rather than copy
+		storage(storage&&) noexcept = default;
+		storage& operator=(storage&&) noexcept = default;
 		using super::capacity;
 		using super::size;
 		using super::byte_span;
@@ -50,6 +53,10 @@ namespace stylizer {
 		T& push_back(T& value) { return emplace_back(value); }
 		T& push_back(T&& value) { return emplace_back(std::move(value)); }
 
+		void reserve(size_t count) { super::reserve(count * sizeof(T)); }
+		// NOTE: New elements are zero filled rather than constructed
+		void resize(size_t count) { super::resize(count * sizeof(T)); }
+
 		T& operator[](size_t index) { return (T&)super::operator[](index); }
 		const T& operator[](size_t index) const { return (const T&)super::operator[](index); }
 